@@ -26,14 +26,41 @@ LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
 
 ifeq ($(TARGET_USES_C2D_COMPOSITION),true)
     LOCAL_CFLAGS += -DCOPYBIT_Z180=1 -DC2D_SUPPORT_DISPLAY=1
-    LOCAL_SRC_FILES := copybit_c2d.cpp software_converter.cpp
+    LOCAL_SRC_FILES := copybit_c2d.cpp software_converter.cpp conv_kernels.cpp \
+                       software_c2d.cpp
     include $(BUILD_SHARED_LIBRARY)
 else
     ifneq ($(call is-chipset-in-board-platform,msm7630),true)
         ifeq ($(call is-board-platform-in-list,$(MSM7K_BOARD_PLATFORMS)),true)
             LOCAL_CFLAGS += -DCOPYBIT_MSM7K=1
-            LOCAL_SRC_FILES := software_converter.cpp copybit.cpp
+            LOCAL_SRC_FILES := software_converter.cpp conv_kernels.cpp copybit.cpp
             include $(BUILD_SHARED_LIBRARY)
         endif
     endif
 endif
+
+# Host check of the converter kernels against the scalar ones
+include $(CLEAR_VARS)
+LOCAL_MODULE                  := copybit_conv_kernels_test
+LOCAL_MODULE_TAGS             := optional
+LOCAL_SRC_FILES               := conv_kernels.cpp tests/conv_kernels_test.cpp
+LOCAL_CFLAGS                  := -Wno-missing-field-initializers -Werror
+include $(BUILD_HOST_EXECUTABLE)
+
+# CPU C2D backend, built for the host to exercise blits off target
+include $(CLEAR_VARS)
+LOCAL_MODULE                  := libcopybit_swc2d
+LOCAL_MODULE_TAGS             := optional
+LOCAL_SRC_FILES               := software_c2d.cpp
+LOCAL_STATIC_LIBRARIES        := liblog
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# Host check of the software C2D blits against reference pixels
+include $(CLEAR_VARS)
+LOCAL_MODULE                  := copybit_swc2d_test
+LOCAL_MODULE_TAGS             := optional
+LOCAL_SRC_FILES               := tests/software_c2d_test.cpp
+LOCAL_STATIC_LIBRARIES        := libcopybit_swc2d liblog
+LOCAL_LDLIBS                  := -lpthread
+LOCAL_CFLAGS                  := -Wno-missing-field-initializers -Werror
+include $(BUILD_HOST_EXECUTABLE)
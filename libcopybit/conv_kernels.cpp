@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include "conv_kernels.h"
+
+#if defined(__ARM_HAVE_NEON) || defined(__aarch64__)
+#define CONV_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef __SSE2__
+#define CONV_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 is not part of any x86 baseline we build for, so its kernels are
+// compiled for it per function and only used when cpuid reports it.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define CONV_HAVE_AVX2 1
+#include <immintrin.h>
+#define CONV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Scalar */
+
+static void interleave_c(unsigned char *dst, const unsigned char *first,
+                         const unsigned char *second, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        dst[i*2]   = first[i];
+        dst[i*2+1] = second[i];
+    }
+}
+
+static void swap_pairs_c(unsigned char *dst, const unsigned char *src,
+                         unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        unsigned char first = src[i*2];
+        dst[i*2]   = src[i*2+1];
+        dst[i*2+1] = first;
+    }
+}
+
+/*
+ * Plane copies go through memcpy in every backend. The libc one is
+ * already vectorized for the CPU and hand written NEON, SSE2 or AVX2
+ * row loops measure no faster (see tests/conv_kernels_test.cpp), so
+ * all a backend can do better is the number of calls: contiguous
+ * planes go out in a single memcpy.
+ */
+static void copy_plane_c(unsigned char *dst, const unsigned char *src,
+                         unsigned int width, unsigned int height,
+                         unsigned int dst_stride, unsigned int src_stride)
+{
+    if (dst_stride == width && src_stride == width) {
+        memcpy(dst, src, width * height);
+        return;
+    }
+    for (unsigned int i = 0; i < height; i++) {
+        memcpy(dst, src, width);
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+static const convKernels sScalarKernels = {
+    "scalar", interleave_c, swap_pairs_c, copy_plane_c
+};
+
+/* NEON */
+
+#ifdef CONV_HAVE_NEON
+static void interleave_neon(unsigned char *dst, const unsigned char *first,
+                            const unsigned char *second, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t pair;
+        pair.val[0] = vld1q_u8(first + i);
+        pair.val[1] = vld1q_u8(second + i);
+        vst2q_u8(dst + i*2, pair);
+    }
+    if (i < count)
+        interleave_c(dst + i*2, first + i, second + i, count - i);
+}
+
+static void swap_pairs_neon(unsigned char *dst, const unsigned char *src,
+                            unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8)
+        vst1q_u8(dst + i*2, vrev16q_u8(vld1q_u8(src + i*2)));
+    if (i < count)
+        swap_pairs_c(dst + i*2, src + i*2, count - i);
+}
+
+static const convKernels sNeonKernels = {
+    "neon", interleave_neon, swap_pairs_neon, copy_plane_c
+};
+#endif
+
+/* SSE2 */
+
+#ifdef CONV_HAVE_SSE2
+static void interleave_sse2(unsigned char *dst, const unsigned char *first,
+                            const unsigned char *second, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(first + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(second + i));
+        _mm_storeu_si128((__m128i *)(dst + i*2), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + i*2 + 16), _mm_unpackhi_epi8(a, b));
+    }
+    if (i < count)
+        interleave_c(dst + i*2, first + i, second + i, count - i);
+}
+
+static void swap_pairs_sse2(unsigned char *dst, const unsigned char *src,
+                            unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i*2));
+        a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+        _mm_storeu_si128((__m128i *)(dst + i*2), a);
+    }
+    if (i < count)
+        swap_pairs_c(dst + i*2, src + i*2, count - i);
+}
+
+static const convKernels sSse2Kernels = {
+    "sse2", interleave_sse2, swap_pairs_sse2, copy_plane_c
+};
+#endif
+
+/* AVX2 */
+
+#ifdef CONV_HAVE_AVX2
+CONV_TARGET_AVX2
+static void interleave_avx2(unsigned char *dst, const unsigned char *first,
+                            const unsigned char *second, unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(first + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(second + i));
+        // unpack works within 128 bit lanes, put the halves back in order
+        __m256i lo = _mm256_unpacklo_epi8(a, b);
+        __m256i hi = _mm256_unpackhi_epi8(a, b);
+        _mm256_storeu_si256((__m256i *)(dst + i*2),
+                            _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + i*2 + 32),
+                            _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    if (i < count)
+        interleave_c(dst + i*2, first + i, second + i, count - i);
+}
+
+CONV_TARGET_AVX2
+static void swap_pairs_avx2(unsigned char *dst, const unsigned char *src,
+                            unsigned int count)
+{
+    unsigned int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + i*2));
+        a = _mm256_or_si256(_mm256_slli_epi16(a, 8), _mm256_srli_epi16(a, 8));
+        _mm256_storeu_si256((__m256i *)(dst + i*2), a);
+    }
+    if (i < count)
+        swap_pairs_c(dst + i*2, src + i*2, count - i);
+}
+
+static const convKernels sAvx2Kernels = {
+    "avx2", interleave_avx2, swap_pairs_avx2, copy_plane_c
+};
+
+static bool cpu_has_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+int conv_supported_kernels(const convKernels **list, int max)
+{
+    int count = 0;
+#ifdef CONV_HAVE_AVX2
+    if (count < max && cpu_has_avx2())
+        list[count++] = &sAvx2Kernels;
+#endif
+#ifdef CONV_HAVE_SSE2
+    if (count < max)
+        list[count++] = &sSse2Kernels;
+#endif
+#ifdef CONV_HAVE_NEON
+    if (count < max)
+        list[count++] = &sNeonKernels;
+#endif
+    if (count < max)
+        list[count++] = &sScalarKernels;
+    return count;
+}
+
+const convKernels* conv_find_kernels(const char *name)
+{
+    const convKernels *list[4];
+    int count = conv_supported_kernels(list, 4);
+    for (int i = 0; i < count; i++) {
+        if (!strcmp(list[i]->name, name))
+            return list[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CONV_KERNELS_H
+#define CONV_KERNELS_H
+
+/*
+ * Pixel kernels used by the software converters. Each backend fills in
+ * a convKernels table; software_converter picks the first one the CPU
+ * supports at runtime. The file has no Android dependencies so the
+ * kernels can be checked against the scalar ones on the host.
+ *
+ * interleave: dst[2i] = first[i], dst[2i+1] = second[i] for count pairs
+ * swapPairs:  dst[2i] = src[2i+1], dst[2i+1] = src[2i] for count pairs,
+ *             turns NV12 chroma into NV21 and back. dst may equal src.
+ * copyPlane:  copy rows width bytes wide from a plane with src_stride
+ *             into a plane with dst_stride
+ */
+struct convKernels {
+    const char *name;
+    void (*interleave)(unsigned char *dst, const unsigned char *first,
+                       const unsigned char *second, unsigned int count);
+    void (*swapPairs)(unsigned char *dst, const unsigned char *src,
+                      unsigned int count);
+    void (*copyPlane)(unsigned char *dst, const unsigned char *src,
+                      unsigned int width, unsigned int height,
+                      unsigned int dst_stride, unsigned int src_stride);
+};
+
+/*
+ * Fills list with the backends usable on this CPU, best first, and
+ * returns how many there are. The scalar backend is always last.
+ */
+int conv_supported_kernels(const convKernels **list, int max);
+
+/* Backend called name if this CPU can run it, NULL otherwise */
+const convKernels* conv_find_kernels(const char *name);
+
+#endif // CONV_KERNELS_H
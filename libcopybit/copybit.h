@@ -214,6 +214,40 @@ struct copybit_device_t {
                    struct copybit_rect_t const *dst_rect,
                    struct copybit_rect_t const *src_rect,
                    struct copybit_region_t const *region);
+
+    /**
+     * Start gathering the blits of a frame. Blits to the framebuffer
+     * issued until end_frame are queued into one draw list instead of
+     * being waited on one at a time. Optional, may be NULL.
+     *
+     * @param dev from open
+     *
+     * @return 0 if successful
+     */
+    int (*begin_frame)(struct copybit_device_t *dev);
+
+    /**
+     * Submit the blits gathered since begin_frame with a single flush
+     * and return without waiting for them. Optional, may be NULL.
+     *
+     * @param dev from open
+     * @param timestamp receives the token to pass to wait_frame
+     *
+     * @return 0 if successful
+     */
+    int (*end_frame)(struct copybit_device_t *dev, void **timestamp);
+
+    /**
+     * Wait for the blits submitted by end_frame to complete and release
+     * the resources they held. The source buffers of the frame must stay
+     * valid until this returns. Optional, may be NULL.
+     *
+     * @param dev from open
+     * @param timestamp returned by end_frame
+     *
+     * @return 0 if successful
+     */
+    int (*wait_frame)(struct copybit_device_t *dev, void *timestamp);
 };
 
 
@@ -43,8 +43,11 @@
 
 #include "c2d2.h"
 #include "software_converter.h"
+#include "software_c2d.h"
 
 #include <dlfcn.h>
+#include <pthread.h>
+#include <cutils/properties.h>
 
 using gralloc::IMemAlloc;
 using gralloc::IonController;
@@ -93,6 +96,11 @@ C2D_STATUS (*LINK_c2dUnMapAddr) ( void * gpuaddr);
 
 #define NUM_SURFACES 3
 
+/* Limits for blits gathered between begin_frame and end_frame */
+#define MAX_FRAME_LAYERS    4
+#define MAX_FRAME_OBJECTS   48
+#define MAX_FRAME_MAPPINGS  (2 * NUM_SURFACES * MAX_FRAME_LAYERS)
+
 enum {
     RGB_SURFACE,
     YUV_SURFACE_2_PLANES,
@@ -112,6 +120,72 @@ enum eC2DFlags {
 static gralloc::IAllocController* sAlloc = 0;
 /******************************************************************************/
 
+/*
+ * GPU mappings of gralloc buffers are kept alive across blits in a small
+ * LRU cache keyed on (fd, offset, size), so that swapchain buffers are not
+ * mapped and unmapped into the GPU MMU on every frame. Entries are dropped
+ * when libmemalloc reports that the fd is going away, when the cache
+ * exceeds its byte budget (debug.copybit.mapcache.mb, 0 disables caching)
+ * and when the last copybit device is closed.
+ */
+#define MAX_GPU_MAPPINGS            32
+#define DEFAULT_MAPPING_BUDGET_MB   64
+
+struct gpu_mapping_t {
+    int fd;
+    int offset;
+    int size;
+    uint32 gpuaddr;
+    int refs;           // blits currently using the mapping
+    bool stale;         // buffer released while in use
+    unsigned int lastUsed;
+};
+
+struct gpu_mapping_cache_t {
+    pthread_mutex_t lock;
+    gpu_mapping_t entries[MAX_GPU_MAPPINGS];
+    int count;
+    size_t bytes;
+    size_t budget;
+    unsigned int clock;
+    int users;
+    unsigned int hits;
+    unsigned int misses;
+};
+
+static gpu_mapping_cache_t sMapCache = { PTHREAD_MUTEX_INITIALIZER };
+
+/*
+ * Temporary buffers used for the alignment and format conversions are
+ * taken from a per device pool instead of being allocated for each size
+ * change. Requests are rounded up to a size class (whole pages, in steps
+ * of a quarter of the next power of two) so that buffers of nearby sizes
+ * are shared. Idle buffers are kept until the pool exceeds its cap
+ * (debug.copybit.tmppool.mb, 0 disables pooling); the least recently
+ * used idle buffers are freed first.
+ */
+#define MAX_TEMP_BUFFERS            8
+#define DEFAULT_TEMP_POOL_MB        16
+#define DEBUG_TEMP_POOL             0
+
+struct temp_buffer_t {
+    alloc_data data;        // data.size is the size class
+    bool inUse;
+    unsigned int lastUsed;
+};
+
+struct temp_buffer_pool_t {
+    temp_buffer_t buffers[MAX_TEMP_BUFFERS];
+    int count;
+    size_t bytes;
+    size_t cap;
+    unsigned int clock;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+};
+/******************************************************************************/
+
 /** State information for each device instance */
 struct copybit_context_t {
     struct copybit_device_t device;
@@ -120,12 +194,26 @@ struct copybit_context_t {
     unsigned int trg_transform;      /* target transform */
     C2D_OBJECT blitState;
     void *libc2d2;
-    alloc_data temp_src_buffer;
-    alloc_data temp_dst_buffer;
+    temp_buffer_pool_t tempPool;
     int fb_width;
     int fb_height;
     bool isPremultipliedAlpha;
     bool mBlitToFB;
+
+    /* Deferred submission state, see begin_frame_copybit */
+    bool frameOpen;
+    bool frameDrawn;                 /* c2dDraw issued, not yet waited on */
+    uint32 frameTarget;              /* target surface of queued objects */
+    uint32 frameTransform;           /* target transform of queued objects */
+    native_handle_t *frameDst;       /* buffer the queued objects draw to */
+    C2D_OBJECT frameObjects[MAX_FRAME_OBJECTS];
+    uint32 frameCount;
+    /* per layer src surfaces, so queued objects keep their own source */
+    unsigned int frameSrc[NUM_SURFACES][MAX_FRAME_LAYERS];
+    int frameLayers[NUM_SURFACES];
+    /* gpu addresses to release once the queued blits complete */
+    uint32 frameMappings[MAX_FRAME_MAPPINGS];
+    int frameNumMappings;
 };
 
 struct blitlist{
@@ -253,14 +341,11 @@ int c2diGetBpp(int32 colorformat)
     return c2dBpp;
 }
 
-static uint32 c2d_get_gpuaddr( struct private_handle_t *handle)
+static uint32 c2d_map_gpuaddr(struct private_handle_t *handle)
 {
     uint32 memtype, *gpuaddr;
     C2D_STATUS rc;
 
-    if(!handle)
-        return 0;
-
     if (handle->flags & (private_handle_t::PRIV_FLAGS_USES_PMEM |
                          private_handle_t::PRIV_FLAGS_USES_PMEM_ADSP))
         memtype = KGSL_USER_MEM_TYPE_PMEM;
@@ -280,6 +365,162 @@ static uint32 c2d_get_gpuaddr( struct private_handle_t *handle)
     return 0;
 }
 
+/* Unmap and remove a cache entry. Called with the cache lock held. */
+static void map_cache_remove_locked(int index)
+{
+    gpu_mapping_t& entry = sMapCache.entries[index];
+    LINK_c2dUnMapAddr((void*) entry.gpuaddr);
+    sMapCache.bytes -= entry.size;
+    sMapCache.entries[index] = sMapCache.entries[--sMapCache.count];
+}
+
+/* Evict idle entries, oldest first, until size more bytes fit the budget */
+static void map_cache_make_room_locked(size_t size)
+{
+    while (sMapCache.count == MAX_GPU_MAPPINGS ||
+           (sMapCache.count && sMapCache.bytes + size > sMapCache.budget)) {
+        int victim = -1;
+        for (int i = 0; i < sMapCache.count; i++) {
+            if (sMapCache.entries[i].refs)
+                continue;
+            if (victim < 0 || sMapCache.entries[i].lastUsed <
+                sMapCache.entries[victim].lastUsed)
+                victim = i;
+        }
+        if (victim < 0)
+            break;
+        map_cache_remove_locked(victim);
+    }
+}
+
+/* Libmemalloc callback, the buffer behind fd is being freed */
+static void map_cache_release_fd(int fd)
+{
+    pthread_mutex_lock(&sMapCache.lock);
+    for (int i = sMapCache.count - 1; i >= 0; i--) {
+        gpu_mapping_t& entry = sMapCache.entries[i];
+        if (entry.fd != fd)
+            continue;
+        if (entry.refs)
+            entry.stale = true;
+        else
+            map_cache_remove_locked(i);
+    }
+    pthread_mutex_unlock(&sMapCache.lock);
+}
+
+/*
+ * The release callback runs with the gralloc callback registry locked and
+ * takes sMapCache.lock, so it must not be registered or unregistered under
+ * sMapCache.lock. Device open and close are serialized by sMapCacheSetupLock
+ * instead, which the callback never takes, so a close cannot unregister
+ * after a later open has registered.
+ */
+static pthread_mutex_t sMapCacheSetupLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void map_cache_init()
+{
+    char property[PROPERTY_VALUE_MAX];
+    pthread_mutex_lock(&sMapCacheSetupLock);
+    pthread_mutex_lock(&sMapCache.lock);
+    bool enable = false;
+    if (sMapCache.users++ == 0) {
+        int budgetMB = DEFAULT_MAPPING_BUDGET_MB;
+        if (property_get("debug.copybit.mapcache.mb", property, NULL) > 0)
+            budgetMB = atoi(property);
+        sMapCache.budget = (budgetMB > 0) ? (size_t)budgetMB << 20 : 0;
+        sMapCache.hits = sMapCache.misses = 0;
+        enable = sMapCache.budget != 0;
+    }
+    pthread_mutex_unlock(&sMapCache.lock);
+    if (enable)
+        gralloc::registerBufferReleaseCallback(map_cache_release_fd);
+    pthread_mutex_unlock(&sMapCacheSetupLock);
+}
+
+/* Drop every mapping once the last device goes away */
+static void map_cache_deinit()
+{
+    pthread_mutex_lock(&sMapCacheSetupLock);
+    pthread_mutex_lock(&sMapCache.lock);
+    bool disable = (--sMapCache.users == 0);
+    pthread_mutex_unlock(&sMapCache.lock);
+    if (disable) {
+        // No callback is running or will run once this returns
+        gralloc::unregisterBufferReleaseCallback(map_cache_release_fd);
+        pthread_mutex_lock(&sMapCache.lock);
+        ALOGD("%s: gpu mapping cache hits=%u misses=%u", __FUNCTION__,
+              sMapCache.hits, sMapCache.misses);
+        while (sMapCache.count)
+            map_cache_remove_locked(sMapCache.count - 1);
+        pthread_mutex_unlock(&sMapCache.lock);
+    }
+    pthread_mutex_unlock(&sMapCacheSetupLock);
+}
+
+/* Get a GPU address for the handle, mapping it if it is not cached yet.
+ * Every successful call must be paired with c2d_put_gpuaddr().
+ */
+static uint32 c2d_get_gpuaddr( struct private_handle_t *handle)
+{
+    uint32 gpuaddr = 0;
+
+    if(!handle)
+        return 0;
+
+    pthread_mutex_lock(&sMapCache.lock);
+    for (int i = 0; i < sMapCache.count; i++) {
+        gpu_mapping_t& entry = sMapCache.entries[i];
+        if (entry.fd == handle->fd && entry.offset == handle->offset &&
+            entry.size == handle->size && !entry.stale) {
+            entry.refs++;
+            entry.lastUsed = ++sMapCache.clock;
+            sMapCache.hits++;
+            pthread_mutex_unlock(&sMapCache.lock);
+            return entry.gpuaddr;
+        }
+    }
+    sMapCache.misses++;
+
+    gpuaddr = c2d_map_gpuaddr(handle);
+    if (gpuaddr && sMapCache.budget && (size_t)handle->size <= sMapCache.budget) {
+        map_cache_make_room_locked(handle->size);
+        if (sMapCache.count < MAX_GPU_MAPPINGS) {
+            gpu_mapping_t& entry = sMapCache.entries[sMapCache.count++];
+            entry.fd = handle->fd;
+            entry.offset = handle->offset;
+            entry.size = handle->size;
+            entry.gpuaddr = gpuaddr;
+            entry.refs = 1;
+            entry.stale = false;
+            entry.lastUsed = ++sMapCache.clock;
+            sMapCache.bytes += handle->size;
+        }
+    }
+    pthread_mutex_unlock(&sMapCache.lock);
+    return gpuaddr;
+}
+
+/* Release a GPU address obtained from c2d_get_gpuaddr(). Cached mappings
+ * stay alive; anything the cache did not take is unmapped right away.
+ */
+static void c2d_put_gpuaddr(uint32 gpuaddr)
+{
+    pthread_mutex_lock(&sMapCache.lock);
+    for (int i = 0; i < sMapCache.count; i++) {
+        gpu_mapping_t& entry = sMapCache.entries[i];
+        if (entry.gpuaddr != gpuaddr)
+            continue;
+        if (--entry.refs == 0 &&
+            (entry.stale || sMapCache.bytes > sMapCache.budget))
+            map_cache_remove_locked(i);
+        pthread_mutex_unlock(&sMapCache.lock);
+        return;
+    }
+    pthread_mutex_unlock(&sMapCache.lock);
+    LINK_c2dUnMapAddr((void*) gpuaddr);
+}
+
 static int is_supported_rgb_format(int format)
 {
     switch(format) {
@@ -362,7 +603,7 @@ static int calculate_yuv_offset_and_stride(const bufferInfo& info,
         case HAL_PIXEL_FORMAT_YCbCr_420_SP:
         case HAL_PIXEL_FORMAT_NV12_ENCODEABLE:
         case HAL_PIXEL_FORMAT_YCrCb_420_SP: {
-            aligned_width = ALIGN(width, 32);
+            aligned_width = ALIGN(width, C2D_YUV_WIDTH_ALIGN);
             yuvInfo.yStride = aligned_width;
             yuvInfo.plane1_stride = aligned_width;
             if (HAL_PIXEL_FORMAT_NV12_ENCODEABLE == format) {
@@ -484,7 +725,7 @@ static int set_image( uint32 surfaceId, const struct copybit_image_t *rhs,
 
 error:
     if(*mapped == 1) {
-        LINK_c2dUnMapAddr( (void*) handle->gpuaddr);
+        c2d_put_gpuaddr(handle->gpuaddr);
         handle->gpuaddr = 0;
         *mapped = 0;
     }
@@ -576,7 +817,7 @@ static int set_src_image( uint32 *surfaceId, const struct copybit_image_t *rhs,
 
 error:
     if(*mapped == 1) {
-        LINK_c2dUnMapAddr( (void*) handle->gpuaddr);
+        c2d_put_gpuaddr(handle->gpuaddr);
         handle->gpuaddr = 0;
         *mapped = 0;
     }
@@ -589,8 +830,8 @@ void unset_image( uint32 surfaceId, const struct copybit_image_t *rhs,
     struct private_handle_t* handle = (struct private_handle_t*)rhs->handle;
 
     if (mmapped && handle->gpuaddr) {
-        // Unmap this gpuaddr
-        LINK_c2dUnMapAddr( (void*) handle->gpuaddr);
+        // Release this gpuaddr, the mapping may stay cached
+        c2d_put_gpuaddr(handle->gpuaddr);
         handle->gpuaddr = 0;
     }
 }
@@ -640,7 +881,7 @@ static int blit_to_target( uint32 surfaceId, const struct copybit_image_t *rhs)
 
 done:
     if (memoryMapped) {
-        LINK_c2dUnMapAddr( (void*) handle->gpuaddr);
+        c2d_put_gpuaddr(handle->gpuaddr);
         handle->gpuaddr = 0;
     }
     return status;
@@ -716,6 +957,68 @@ static int msm_copybit(struct copybit_context_t *dev, blitlist *list, uint32 tar
     return COPYBIT_SUCCESS;
 }
 
+/** hand the objects queued for this frame to C2D, without waiting */
+static int draw_frame_list(struct copybit_context_t *ctx)
+{
+    int status = COPYBIT_SUCCESS;
+
+    if (!ctx->frameCount)
+        return status;
+
+    for (uint32 i = 0; i < ctx->frameCount - 1; i++) {
+        ctx->frameObjects[i].next = &(ctx->frameObjects[i+1]);
+    }
+    ctx->frameObjects[ctx->frameCount - 1].next = NULL;
+
+    if (LINK_c2dDraw(ctx->frameTarget, ctx->frameTransform, 0x0, 0, 0,
+                     ctx->frameObjects, ctx->frameCount)) {
+        ALOGE("%s: LINK_c2dDraw ERROR", __FUNCTION__);
+        status = COPYBIT_FAILURE;
+    }
+    ctx->frameCount = 0;
+    ctx->frameDrawn = true;
+    return status;
+}
+
+/** release what the completed frame blits were holding on to */
+static void release_frame_resources(struct copybit_context_t *ctx)
+{
+    for (int i = 0; i < ctx->frameNumMappings; i++) {
+        c2d_put_gpuaddr(ctx->frameMappings[i]);
+    }
+    ctx->frameNumMappings = 0;
+    for (int i = 0; i < NUM_SURFACES; i++) {
+        ctx->frameLayers[i] = 0;
+    }
+    ctx->frameDst = NULL;
+    ctx->frameDrawn = false;
+}
+
+/** complete everything queued so far before returning */
+static int finish_frame_blits(struct copybit_context_t *ctx)
+{
+    int status = draw_frame_list(ctx);
+    if (ctx->frameDrawn && LINK_c2dFinish(ctx->frameTarget)) {
+        ALOGE("%s: LINK_c2dFinish ERROR", __FUNCTION__);
+        status = COPYBIT_FAILURE;
+    }
+    release_frame_resources(ctx);
+    return status;
+}
+
+/** like unset_image, but keeps the mapping until the frame completes */
+static void defer_unset_image(struct copybit_context_t *ctx,
+                              const struct copybit_image_t *rhs,
+                              uint32 mmapped)
+{
+    struct private_handle_t* handle = (struct private_handle_t*)rhs->handle;
+
+    if (mmapped && handle->gpuaddr) {
+        ctx->frameMappings[ctx->frameNumMappings++] = handle->gpuaddr;
+        handle->gpuaddr = 0;
+    }
+}
+
 /*****************************************************************************/
 
 /** Set a parameter to value */
@@ -857,7 +1160,9 @@ static int is_alpha(int cformat)
 /* Function to check if we need a temporary buffer for the blit.
  * This would happen if the requested destination stride and the
  * C2D stride do not match. We ignore RGB buffers, since their
- * stride is always aligned to 32.
+ * stride is always aligned to 32. gralloc allocates composer YUV
+ * buffers with a C2D_YUV_WIDTH_ALIGN stride, so only buffers
+ * allocated without GRALLOC_USAGE_HW_COMPOSER take the copy.
  */
 static bool need_temp_buffer(struct copybit_image_t const *img)
 {
@@ -869,7 +1174,7 @@ static bool need_temp_buffer(struct copybit_image_t const *img)
     // The width parameter in the handle contains the aligned_w. We check if we
     // need to convert based on this param. YUV formats have bpp=1, so checking
     // if the requested stride is aligned should suffice.
-    if (0 == (handle->width)%32) {
+    if (0 == (handle->width) % C2D_YUV_WIDTH_ALIGN) {
         return false;
     }
 
@@ -915,21 +1220,34 @@ static size_t get_size(const bufferInfo& info)
     return size;
 }
 
-/* Function to allocate memory for the temporary buffer. This memory is
- * allocated from Ashmem. It is the caller's responsibility to free this
- * memory.
+/* Round a temporary buffer size up to its pool size class */
+static size_t temp_size_class(size_t size)
+{
+    size_t pageSize = getpagesize();
+    size_t pages = (size + pageSize - 1) / pageSize;
+    if (pages > 4) {
+        size_t step = 1;
+        while ((step << 3) <= pages)
+            step <<= 1;
+        pages = (pages + step - 1) & ~(step - 1);
+    }
+    return pages * pageSize;
+}
+
+/* Function to allocate memory for a temporary buffer from the system heap.
+ * It is the caller's responsibility to free this memory.
  */
-static int get_temp_buffer(const bufferInfo& info, alloc_data& data)
+static int alloc_temp_buffer(size_t size, alloc_data& data)
 {
-    ALOGD("%s E", __FUNCTION__);
-    // Alloc memory from system heap
     data.base = 0;
     data.fd = -1;
     data.offset = 0;
-    data.size = get_size(info);
+    data.size = size;
     data.align = getpagesize();
     data.uncached = true;
-    int allocFlags = GRALLOC_USAGE_PRIVATE_SYSTEM_HEAP;
+    // Temp buffers are always fully written by a conversion or blit first
+    int allocFlags = GRALLOC_USAGE_PRIVATE_SYSTEM_HEAP |
+                     GRALLOC_USAGE_PRIVATE_NO_ZERO_FILL;
 
     if (sAlloc == 0) {
         sAlloc = gralloc::IAllocController::getInstance();
@@ -943,11 +1261,10 @@ static int get_temp_buffer(const bufferInfo& info, alloc_data& data)
     int err = sAlloc->allocate(data, allocFlags);
     if (0 != err) {
         ALOGE("%s: allocate failed", __FUNCTION__);
+        data.fd = -1;
         return COPYBIT_FAILURE;
     }
-
-    ALOGD("%s X", __FUNCTION__);
-    return err;
+    return COPYBIT_SUCCESS;
 }
 
 /* Function to free the temporary allocated memory.*/
@@ -956,7 +1273,105 @@ static void free_temp_buffer(alloc_data &data)
     if (-1 != data.fd) {
         IMemAlloc* memalloc = sAlloc->getAllocator(data.allocType);
         memalloc->free_buffer(data.base, data.size, 0, data.fd);
+        data.fd = -1;
+    }
+}
+
+static void temp_pool_remove(temp_buffer_pool_t *pool, int index)
+{
+    pool->bytes -= pool->buffers[index].data.size;
+    free_temp_buffer(pool->buffers[index].data);
+    pool->buffers[index] = pool->buffers[--pool->count];
+}
+
+/* Free idle buffers, least recently used first, until a buffer of the
+ * given size fits under the cap and a slot is available.
+ */
+static void temp_pool_make_room(temp_buffer_pool_t *pool, size_t size)
+{
+    while (pool->count &&
+           (pool->bytes + size > pool->cap || pool->count == MAX_TEMP_BUFFERS)) {
+        int lru = -1;
+        for (int i = 0; i < pool->count; i++) {
+            if (!pool->buffers[i].inUse && (lru < 0 ||
+                pool->buffers[i].lastUsed < pool->buffers[lru].lastUsed))
+                lru = i;
+        }
+        if (lru < 0)
+            break;
+        temp_pool_remove(pool, lru);
+        pool->evictions++;
+    }
+}
+
+static void temp_pool_init(temp_buffer_pool_t *pool)
+{
+    char property[PROPERTY_VALUE_MAX];
+    int capMB = DEFAULT_TEMP_POOL_MB;
+    memset(pool, 0, sizeof(*pool));
+    if (property_get("debug.copybit.tmppool.mb", property, NULL) > 0)
+        capMB = atoi(property);
+    pool->cap = (capMB > 0) ? (size_t)capMB << 20 : 0;
+}
+
+static void temp_pool_deinit(temp_buffer_pool_t *pool)
+{
+    ALOGD("%s: temp buffer pool hits=%u misses=%u evictions=%u",
+          __FUNCTION__, pool->hits, pool->misses, pool->evictions);
+    while (pool->count)
+        temp_pool_remove(pool, pool->count - 1);
+}
+
+/* Get a temporary buffer large enough for info from the pool, allocating
+ * one if no idle buffer of the right size class is available. The buffer
+ * must be returned with put_temp_buffer().
+ */
+static int get_temp_buffer(temp_buffer_pool_t *pool, const bufferInfo& info,
+                           alloc_data& data)
+{
+    size_t size = temp_size_class(get_size(info));
+
+    for (int i = 0; i < pool->count; i++) {
+        temp_buffer_t *buf = &pool->buffers[i];
+        if (!buf->inUse && buf->data.size == size) {
+            buf->inUse = true;
+            buf->lastUsed = ++pool->clock;
+            data = buf->data;
+            pool->hits++;
+            return COPYBIT_SUCCESS;
+        }
+    }
+
+    pool->misses++;
+    ALOGD_IF(DEBUG_TEMP_POOL, "%s: miss for %u bytes (%d pooled, %u bytes)",
+             __FUNCTION__, (unsigned int)size, pool->count,
+             (unsigned int)pool->bytes);
+    temp_pool_make_room(pool, size);
+    if (COPYBIT_SUCCESS != alloc_temp_buffer(size, data))
+        return COPYBIT_FAILURE;
+
+    // Buffers that do not fit are freed again by put_temp_buffer
+    if (pool->count < MAX_TEMP_BUFFERS && pool->bytes + size <= pool->cap) {
+        temp_buffer_t *buf = &pool->buffers[pool->count++];
+        buf->data = data;
+        buf->inUse = true;
+        buf->lastUsed = ++pool->clock;
+        pool->bytes += size;
+    }
+    return COPYBIT_SUCCESS;
+}
+
+/* Return a buffer obtained from get_temp_buffer() to the pool */
+static void put_temp_buffer(temp_buffer_pool_t *pool, alloc_data& data)
+{
+    for (int i = 0; i < pool->count; i++) {
+        if (pool->buffers[i].data.fd == data.fd) {
+            pool->buffers[i].inUse = false;
+            data.fd = -1;
+            return;
+        }
     }
+    free_temp_buffer(data);
 }
 
 /* Function to perform the software color conversion. Convert the
@@ -1020,6 +1435,7 @@ static int stretch_copybit_internal(
     int cformat;
     c2d_ts_handle timestamp;
     uint32 src_surface_index = 0, dst_surface_index = 0;
+    uint32 src_surface;
 
     if (!ctx) {
         ALOGE("%s: null context error", __FUNCTION__);
@@ -1066,15 +1482,60 @@ static int stretch_copybit_internal(
         return COPYBIT_FAILURE;
     }
 
+    if(is_supported_rgb_format(src->format) == COPYBIT_SUCCESS) {
+        src_surface_index = RGB_SURFACE;
+    } else if (is_supported_yuv_format(src->format) == COPYBIT_SUCCESS) {
+        int num_planes = get_num_planes(src->format);
+        if (num_planes == 2) {
+            src_surface_index = YUV_SURFACE_2_PLANES;
+        } else if (num_planes == 3) {
+            src_surface_index = YUV_SURFACE_3_PLANES;
+        } else {
+            ALOGE("%s: src number of YUV planes is invalid src format = 0x%x",
+                  __FUNCTION__, src->format);
+            return -EINVAL;
+        }
+    } else {
+        ALOGE("%s: Invalid source surface format 0x%x", __FUNCTION__, src->format);
+        return -EINVAL;
+    }
+
+    // Check if we need a temp. copy for the destination. We'd need this the destination
+    // width is not aligned to 32. This case occurs for YUV formats. RGB formats are
+    // aligned to 32.
+    bool needTempDestination = need_temp_buffer(dst);
+    bool needTempSource = need_temp_buffer(src);
+
+    // Blits to the framebuffer inside begin_frame/end_frame are queued.
+    // Anything that needs the CPU to touch the result, or a buffer switch,
+    // first completes what has been queued so far.
+    bool deferred = ctx->frameOpen && ctx->mBlitToFB &&
+                    !needTempDestination && !needTempSource &&
+                    dst_surface_index == RGB_SURFACE &&
+                    src_surface_index != YUV_SURFACE_3_PLANES;
+    if (deferred) {
+        if ((ctx->frameDst && ctx->frameDst != dst->handle) ||
+            ctx->frameLayers[src_surface_index] == MAX_FRAME_LAYERS ||
+            ctx->frameNumMappings + 2 > MAX_FRAME_MAPPINGS) {
+            finish_frame_blits(ctx);
+        }
+        src_surface = ctx->frameSrc[src_surface_index]
+                                   [ctx->frameLayers[src_surface_index]];
+    } else {
+        if (ctx->frameCount || ctx->frameDrawn)
+            finish_frame_blits(ctx);
+        src_surface = ctx->src[src_surface_index];
+    }
+
+    alloc_data temp_dst_buffer, temp_src_buffer;
+    temp_dst_buffer.fd = -1;
+    temp_src_buffer.fd = -1;
+
     copybit_image_t dst_image;
     dst_image.w = dst->w;
     dst_image.h = dst->h;
     dst_image.format = dst->format;
     dst_image.handle = dst->handle;
-    // Check if we need a temp. copy for the destination. We'd need this the destination
-    // width is not aligned to 32. This case occurs for YUV formats. RGB formats are
-    // aligned to 32.
-    bool needTempDestination = need_temp_buffer(dst);
     bufferInfo dst_info;
     populate_buffer_info(dst, dst_info);
     private_handle_t* dst_hnd = new private_handle_t(-1, 0, 0, 0, dst_info.format,
@@ -1084,20 +1545,18 @@ static int stretch_copybit_internal(
         return COPYBIT_FAILURE;
     }
     if (needTempDestination) {
-        if (get_size(dst_info) != ctx->temp_dst_buffer.size) {
-            free_temp_buffer(ctx->temp_dst_buffer);
-            // Create a temp buffer and set that as the destination.
-            if (COPYBIT_FAILURE == get_temp_buffer(dst_info, ctx->temp_dst_buffer)) {
-                ALOGE("%s: get_temp_buffer(dst) failed", __FUNCTION__);
-                delete_handle(dst_hnd);
-                return COPYBIT_FAILURE;
-            }
+        // Create a temp buffer and set that as the destination.
+        if (COPYBIT_FAILURE == get_temp_buffer(&ctx->tempPool, dst_info,
+                                               temp_dst_buffer)) {
+            ALOGE("%s: get_temp_buffer(dst) failed", __FUNCTION__);
+            delete_handle(dst_hnd);
+            return COPYBIT_FAILURE;
         }
-        dst_hnd->fd = ctx->temp_dst_buffer.fd;
-        dst_hnd->size = ctx->temp_dst_buffer.size;
-        dst_hnd->flags = ctx->temp_dst_buffer.allocType;
-        dst_hnd->base = (int)(ctx->temp_dst_buffer.base);
-        dst_hnd->offset = ctx->temp_dst_buffer.offset;
+        dst_hnd->fd = temp_dst_buffer.fd;
+        dst_hnd->size = get_size(dst_info);
+        dst_hnd->flags = temp_dst_buffer.allocType;
+        dst_hnd->base = (int)(temp_dst_buffer.base);
+        dst_hnd->offset = temp_dst_buffer.offset;
         dst_hnd->gpuaddr = 0;
         dst_image.handle = dst_hnd;
     }
@@ -1111,61 +1570,43 @@ static int stretch_copybit_internal(
     if(status) {
         ALOGE("%s: dst: set_image error", __FUNCTION__);
         delete_handle(dst_hnd);
+        put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
         return COPYBIT_FAILURE;
     }
 
-    if(is_supported_rgb_format(src->format) == COPYBIT_SUCCESS) {
-        src_surface_index = RGB_SURFACE;
-    } else if (is_supported_yuv_format(src->format) == COPYBIT_SUCCESS) {
-        int num_planes = get_num_planes(src->format);
-        if (num_planes == 2) {
-            src_surface_index = YUV_SURFACE_2_PLANES;
-        } else if (num_planes == 3) {
-            src_surface_index = YUV_SURFACE_3_PLANES;
-        } else {
-            ALOGE("%s: src number of YUV planes is invalid src format = 0x%x",
-                  __FUNCTION__, src->format);
-            delete_handle(dst_hnd);
-            return -EINVAL;
-        }
-    } else {
-        ALOGE("%s: Invalid source surface format 0x%x", __FUNCTION__, src->format);
-        delete_handle(dst_hnd);
-        return -EINVAL;
-    }
-
     copybit_image_t src_image;
     src_image.w = src->w;
     src_image.h = src->h;
     src_image.format = src->format;
     src_image.handle = src->handle;
 
-    bool needTempSource = need_temp_buffer(src);
     bufferInfo src_info;
     populate_buffer_info(src, src_info);
     private_handle_t* src_hnd = new private_handle_t(-1, 0, 0, 0, src_info.format,
                                                      src_info.width, src_info.height);
     if (NULL == src_hnd) {
         ALOGE("%s: src_hnd is null", __FUNCTION__);
+        unset_image(ctx->dst[dst_surface_index], &dst_image, trg_mapped);
         delete_handle(dst_hnd);
+        put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
         return COPYBIT_FAILURE;
     }
     if (needTempSource) {
-        if (get_size(src_info) != ctx->temp_src_buffer.size) {
-            free_temp_buffer(ctx->temp_src_buffer);
-            // Create a temp buffer and set that as the destination.
-            if (COPYBIT_SUCCESS != get_temp_buffer(src_info, ctx->temp_src_buffer)) {
-                ALOGE("%s: get_temp_buffer(src) failed", __FUNCTION__);
-                delete_handle(dst_hnd);
-                delete_handle(src_hnd);
-                return COPYBIT_FAILURE;
-            }
+        // Create a temp buffer and set that as the source.
+        if (COPYBIT_SUCCESS != get_temp_buffer(&ctx->tempPool, src_info,
+                                               temp_src_buffer)) {
+            ALOGE("%s: get_temp_buffer(src) failed", __FUNCTION__);
+            unset_image(ctx->dst[dst_surface_index], &dst_image, trg_mapped);
+            delete_handle(dst_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
+            delete_handle(src_hnd);
+            return COPYBIT_FAILURE;
         }
-        src_hnd->fd = ctx->temp_src_buffer.fd;
-        src_hnd->size = ctx->temp_src_buffer.size;
-        src_hnd->flags = ctx->temp_src_buffer.allocType;
-        src_hnd->base = (int)(ctx->temp_src_buffer.base);
-        src_hnd->offset = ctx->temp_src_buffer.offset;
+        src_hnd->fd = temp_src_buffer.fd;
+        src_hnd->size = get_size(src_info);
+        src_hnd->flags = temp_src_buffer.allocType;
+        src_hnd->base = (int)(temp_src_buffer.base);
+        src_hnd->offset = temp_src_buffer.offset;
         src_hnd->gpuaddr = 0;
         src_image.handle = src_hnd;
 
@@ -1174,8 +1615,11 @@ static int stretch_copybit_internal(
                                 CONVERT_TO_C2D_FORMAT);
         if (status == COPYBIT_FAILURE) {
             ALOGE("%s:copy_image failed in temp source",__FUNCTION__);
+            unset_image(ctx->dst[dst_surface_index], &dst_image, trg_mapped);
             delete_handle(dst_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
             delete_handle(src_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_src_buffer);
             return status;
         }
 
@@ -1184,18 +1628,24 @@ static int stretch_copybit_internal(
         if (memalloc->clean_buffer((void *)(src_hnd->base), src_hnd->size,
                                    src_hnd->offset, src_hnd->fd)) {
             ALOGE("%s: clean_buffer failed", __FUNCTION__);
+            unset_image(ctx->dst[dst_surface_index], &dst_image, trg_mapped);
             delete_handle(dst_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
             delete_handle(src_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_src_buffer);
             return COPYBIT_FAILURE;
         }
     }
 
-    status = set_image( ctx->src[src_surface_index], &src_image,
+    status = set_image( src_surface, &src_image,
                         &cformat, &src_mapped, (eC2DFlags)flags);
     if(status) {
         ALOGE("%s: set_src_image error", __FUNCTION__);
+        unset_image(ctx->dst[dst_surface_index], &dst_image, trg_mapped);
         delete_handle(dst_hnd);
+        put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
         delete_handle(src_hnd);
+        put_temp_buffer(&ctx->tempPool, temp_src_buffer);
         return COPYBIT_FAILURE;
     }
 
@@ -1204,12 +1654,14 @@ static int stretch_copybit_internal(
             ctx->blitState.config_mask &= ~C2D_ALPHA_BLEND_NONE;
             if(!(ctx->blitState.global_alpha)) {
                 // src alpha is zero
-                unset_image( ctx->src[src_surface_index],
+                unset_image( src_surface,
                              &src_image, src_mapped);
                 unset_image( ctx->dst[dst_surface_index],
                              &dst_image, trg_mapped);
                 delete_handle(dst_hnd);
+                put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
                 delete_handle(src_hnd);
+                put_temp_buffer(&ctx->tempPool, temp_src_buffer);
                 return status;
             }
         } else {
@@ -1222,7 +1674,35 @@ static int stretch_copybit_internal(
         ctx->blitState.config_mask |= C2D_ALPHA_BLEND_NONE;
     }
 
-    ctx->blitState.surface_id = ctx->src[src_surface_index];
+    ctx->blitState.surface_id = src_surface;
+
+    if (deferred) {
+        // Objects in one c2dDraw share the target transform
+        if (ctx->frameCount && ctx->frameTransform != ctx->trg_transform)
+            status = draw_frame_list(ctx);
+        ctx->frameTarget = ctx->dst[dst_surface_index];
+        ctx->frameTransform = ctx->trg_transform;
+        ctx->frameDst = dst->handle;
+        ctx->frameLayers[src_surface_index]++;
+
+        while ((status == 0) && region->next(region, &clip)) {
+            if (ctx->frameCount == MAX_FRAME_OBJECTS)
+                status = draw_frame_list(ctx);
+            req = &(ctx->frameObjects[ctx->frameCount++]);
+            memcpy(req,&ctx->blitState,sizeof(C2D_OBJECT));
+            set_rects(ctx, req, dst_rect, src_rect, &clip);
+        }
+
+        // The mappings must outlive the queued objects
+        defer_unset_image(ctx, &src_image, src_mapped);
+        defer_unset_image(ctx, &dst_image, trg_mapped);
+        delete_handle(dst_hnd);
+        delete_handle(src_hnd);
+        ctx->isPremultipliedAlpha = false;
+        ctx->fb_width = 0;
+        ctx->fb_height = 0;
+        return status;
+    }
 
     while ((status == 0) && region->next(region, &clip)) {
         req = &(list.blitObjects[list.count]);
@@ -1243,7 +1723,7 @@ static int stretch_copybit_internal(
         ALOGE("%s: LINK_c2dFinish ERROR", __FUNCTION__);
     }
 
-    unset_image( ctx->src[src_surface_index], &src_image,
+    unset_image( src_surface, &src_image,
                  src_mapped);
     unset_image( ctx->dst[dst_surface_index], &dst_image,
                  trg_mapped);
@@ -1253,7 +1733,9 @@ static int stretch_copybit_internal(
         if (status == COPYBIT_FAILURE) {
             ALOGE("%s:copy_image failed in temp Dest",__FUNCTION__);
             delete_handle(dst_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
             delete_handle(src_hnd);
+            put_temp_buffer(&ctx->tempPool, temp_src_buffer);
             return status;
         }
         // Invalidate the cache.
@@ -1262,7 +1744,9 @@ static int stretch_copybit_internal(
                                dst_hnd->offset, dst_hnd->fd);
     }
     delete_handle(dst_hnd);
+    put_temp_buffer(&ctx->tempPool, temp_dst_buffer);
     delete_handle(src_hnd);
+    put_temp_buffer(&ctx->tempPool, temp_src_buffer);
     ctx->isPremultipliedAlpha = false;
     ctx->fb_width = 0;
     ctx->fb_height = 0;
@@ -1297,23 +1781,94 @@ static int blit_copybit(
 
 /*****************************************************************************/
 
+/** Start gathering the framebuffer blits of a frame */
+static int begin_frame_copybit(struct copybit_device_t *dev)
+{
+    struct copybit_context_t* ctx = (struct copybit_context_t*)dev;
+    if (!ctx) {
+        ALOGE("%s: null context error", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    // The previous frame was never waited on
+    if (ctx->frameCount || ctx->frameDrawn || ctx->frameNumMappings)
+        finish_frame_blits(ctx);
+    ctx->frameOpen = true;
+    return COPYBIT_SUCCESS;
+}
+
+/** Submit the gathered blits with one flush, without waiting */
+static int end_frame_copybit(struct copybit_device_t *dev, void **timestamp)
+{
+    struct copybit_context_t* ctx = (struct copybit_context_t*)dev;
+    if (!ctx || !timestamp) {
+        ALOGE("%s: invalid params ctx=%p timestamp=%p", __FUNCTION__,
+              ctx, timestamp);
+        return -EINVAL;
+    }
+
+    *timestamp = NULL;
+    ctx->frameOpen = false;
+    int status = draw_frame_list(ctx);
+    if (!ctx->frameDrawn) {
+        // Nothing reached the hardware
+        release_frame_resources(ctx);
+        return status;
+    }
+
+    c2d_ts_handle ts;
+    if (LINK_c2dFlush(ctx->frameTarget, &ts)) {
+        ALOGE("%s: LINK_c2dFlush ERROR", __FUNCTION__);
+        finish_frame_blits(ctx);
+        return COPYBIT_FAILURE;
+    }
+    *timestamp = (void *)ts;
+    return status;
+}
+
+/** Wait for the blits submitted by end_frame to complete */
+static int wait_frame_copybit(struct copybit_device_t *dev, void *timestamp)
+{
+    struct copybit_context_t* ctx = (struct copybit_context_t*)dev;
+    int status = COPYBIT_SUCCESS;
+    if (!ctx) {
+        ALOGE("%s: null context error", __FUNCTION__);
+        return -EINVAL;
+    }
+
+    if (timestamp && LINK_c2dWaitTimestamp((c2d_ts_handle)timestamp)) {
+        ALOGE("%s: LINK_c2dWaitTimestamp ERROR", __FUNCTION__);
+        status = finish_frame_blits(ctx);
+    }
+    release_frame_resources(ctx);
+    return status;
+}
+
+/*****************************************************************************/
+
 /** Close the copybit device */
 static int close_copybit(struct hw_device_t *dev)
 {
     struct copybit_context_t* ctx = (struct copybit_context_t*)dev;
     if (ctx) {
+        finish_frame_blits(ctx);
         for(int i = 0; i <NUM_SURFACES; i++) {
             LINK_c2dDestroySurface(ctx->dst[i]);
             LINK_c2dDestroySurface(ctx->src[i]);
+            for (int j = 0; j < MAX_FRAME_LAYERS; j++) {
+                if (-1 != ctx->frameSrc[i][j])
+                    LINK_c2dDestroySurface(ctx->frameSrc[i][j]);
+            }
         }
 
+        temp_pool_deinit(&ctx->tempPool);
+        map_cache_deinit();
+
         if (ctx->libc2d2) {
             ::dlclose(ctx->libc2d2);
             ALOGV("dlclose(libc2d2)");
         }
 
-        free_temp_buffer(ctx->temp_src_buffer);
-        free_temp_buffer(ctx->temp_dst_buffer);
         free(ctx);
     }
 
@@ -1329,6 +1884,7 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
     C2D_YUV_SURFACE_DEF yuvSurfaceDef = {0} ;
     struct copybit_context_t *ctx;
     char fbName[64];
+    char property[PROPERTY_VALUE_MAX];
 
     ctx = (struct copybit_context_t *)malloc(sizeof(struct copybit_context_t));
     if(!ctx) {
@@ -1342,36 +1898,56 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
     for (int i=0; i< NUM_SURFACES; i++) {
         ctx->dst[i] = -1;
         ctx->src[i] = -1;
+        for (int j = 0; j < MAX_FRAME_LAYERS; j++) {
+            ctx->frameSrc[i][j] = -1;
+        }
     }
 
-    ctx->libc2d2 = ::dlopen("libC2D2.so", RTLD_NOW);
-    if (!ctx->libc2d2) {
-        ALOGE("FATAL ERROR: could not dlopen libc2d2.so: %s", dlerror());
-        goto error;
-    }
-    *(void **)&LINK_c2dCreateSurface = ::dlsym(ctx->libc2d2,
-                                               "c2dCreateSurface");
-    *(void **)&LINK_c2dUpdateSurface = ::dlsym(ctx->libc2d2,
-                                               "c2dUpdateSurface");
-    *(void **)&LINK_c2dReadSurface = ::dlsym(ctx->libc2d2,
-                                             "c2dReadSurface");
-    *(void **)&LINK_c2dDraw = ::dlsym(ctx->libc2d2, "c2dDraw");
-    *(void **)&LINK_c2dFlush = ::dlsym(ctx->libc2d2, "c2dFlush");
-    *(void **)&LINK_c2dFinish = ::dlsym(ctx->libc2d2, "c2dFinish");
-    *(void **)&LINK_c2dWaitTimestamp = ::dlsym(ctx->libc2d2,
-                                               "c2dWaitTimestamp");
-    *(void **)&LINK_c2dDestroySurface = ::dlsym(ctx->libc2d2,
-                                                "c2dDestroySurface");
-    *(void **)&LINK_c2dMapAddr = ::dlsym(ctx->libc2d2,
-                                         "c2dMapAddr");
-    *(void **)&LINK_c2dUnMapAddr = ::dlsym(ctx->libc2d2,
-                                           "c2dUnMapAddr");
-
-    if (!LINK_c2dCreateSurface || !LINK_c2dUpdateSurface || !LINK_c2dReadSurface
-        || !LINK_c2dDraw || !LINK_c2dFlush || !LINK_c2dWaitTimestamp || !LINK_c2dFinish
-        || !LINK_c2dDestroySurface) {
-        ALOGE("%s: dlsym ERROR", __FUNCTION__);
-        goto error;
+    // debug.copybit.c2d=sw draws with the CPU implementation of C2D
+    // instead of the GPU library, e.g. to compare or profile the blits.
+    property_get("debug.copybit.c2d", property, "hw");
+    if (!strncmp(property, "sw", 2)) {
+        ALOGI("%s: using the software C2D backend", __FUNCTION__);
+        LINK_c2dCreateSurface = sw_c2dCreateSurface;
+        LINK_c2dUpdateSurface = sw_c2dUpdateSurface;
+        LINK_c2dReadSurface = sw_c2dReadSurface;
+        LINK_c2dDraw = sw_c2dDraw;
+        LINK_c2dFlush = sw_c2dFlush;
+        LINK_c2dFinish = sw_c2dFinish;
+        LINK_c2dWaitTimestamp = sw_c2dWaitTimestamp;
+        LINK_c2dDestroySurface = sw_c2dDestroySurface;
+        LINK_c2dMapAddr = sw_c2dMapAddr;
+        LINK_c2dUnMapAddr = sw_c2dUnMapAddr;
+    } else {
+        ctx->libc2d2 = ::dlopen("libC2D2.so", RTLD_NOW);
+        if (!ctx->libc2d2) {
+            ALOGE("FATAL ERROR: could not dlopen libc2d2.so: %s", dlerror());
+            goto error;
+        }
+        *(void **)&LINK_c2dCreateSurface = ::dlsym(ctx->libc2d2,
+                                                   "c2dCreateSurface");
+        *(void **)&LINK_c2dUpdateSurface = ::dlsym(ctx->libc2d2,
+                                                   "c2dUpdateSurface");
+        *(void **)&LINK_c2dReadSurface = ::dlsym(ctx->libc2d2,
+                                                 "c2dReadSurface");
+        *(void **)&LINK_c2dDraw = ::dlsym(ctx->libc2d2, "c2dDraw");
+        *(void **)&LINK_c2dFlush = ::dlsym(ctx->libc2d2, "c2dFlush");
+        *(void **)&LINK_c2dFinish = ::dlsym(ctx->libc2d2, "c2dFinish");
+        *(void **)&LINK_c2dWaitTimestamp = ::dlsym(ctx->libc2d2,
+                                                   "c2dWaitTimestamp");
+        *(void **)&LINK_c2dDestroySurface = ::dlsym(ctx->libc2d2,
+                                                    "c2dDestroySurface");
+        *(void **)&LINK_c2dMapAddr = ::dlsym(ctx->libc2d2,
+                                             "c2dMapAddr");
+        *(void **)&LINK_c2dUnMapAddr = ::dlsym(ctx->libc2d2,
+                                               "c2dUnMapAddr");
+
+        if (!LINK_c2dCreateSurface || !LINK_c2dUpdateSurface || !LINK_c2dReadSurface
+            || !LINK_c2dDraw || !LINK_c2dFlush || !LINK_c2dWaitTimestamp || !LINK_c2dFinish
+            || !LINK_c2dDestroySurface) {
+            ALOGE("%s: dlsym ERROR", __FUNCTION__);
+            goto error;
+        }
     }
 
     ctx->device.common.tag = HARDWARE_DEVICE_TAG;
@@ -1382,6 +1958,9 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
     ctx->device.get = get;
     ctx->device.blit = blit_copybit;
     ctx->device.stretch = stretch_copybit;
+    ctx->device.begin_frame = begin_frame_copybit;
+    ctx->device.end_frame = end_frame_copybit;
+    ctx->device.wait_frame = wait_frame_copybit;
     ctx->blitState.config_mask = C2D_NO_BILINEAR_BIT | C2D_NO_ANTIALIASING_BIT;
     ctx->trg_transform = C2D_TARGET_ROTATE_0;
 
@@ -1440,6 +2019,27 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
         goto error;
     }
 
+    /* Create the per layer source surfaces used for queued frame blits */
+    for (int i = 0; i < MAX_FRAME_LAYERS; i++) {
+        if (LINK_c2dCreateSurface(&(ctx->frameSrc[RGB_SURFACE][i]),
+                                  C2D_TARGET | C2D_SOURCE,
+                                  (C2D_SURFACE_TYPE)(C2D_SURFACE_RGB_HOST |
+                                                     C2D_SURFACE_WITH_PHYS | C2D_SURFACE_WITH_PHYS_DUMMY),
+                                  &surfDefinition)) {
+            ALOGE("%s: create ctx->frameSrc[RGB_SURFACE][%d] failed", __FUNCTION__, i);
+            ctx->frameSrc[RGB_SURFACE][i] = -1;
+            goto error;
+        }
+        if (LINK_c2dCreateSurface(&(ctx->frameSrc[YUV_SURFACE_2_PLANES][i]),
+                                  C2D_TARGET | C2D_SOURCE,
+                                  (C2D_SURFACE_TYPE)(C2D_SURFACE_YUV_HOST | C2D_SURFACE_WITH_PHYS | C2D_SURFACE_WITH_PHYS_DUMMY),
+                                  &yuvSurfaceDef)) {
+            ALOGE("%s: create ctx->frameSrc[YUV_SURFACE_2_PLANES][%d] failed", __FUNCTION__, i);
+            ctx->frameSrc[YUV_SURFACE_2_PLANES][i] = -1;
+            goto error;
+        }
+    }
+
     yuvSurfaceDef.format = C2D_COLOR_FORMAT_420_YV12;
     yuvSurfaceDef.plane2 = (void*)0xaaaaaaaa;
     yuvSurfaceDef.phys2 = (void*) 0xaaaaaaaa;
@@ -1463,18 +2063,14 @@ static int open_copybit(const struct hw_module_t* module, const char* name,
         goto error;
     }
 
-    ctx->temp_src_buffer.fd = -1;
-    ctx->temp_src_buffer.base = 0;
-    ctx->temp_src_buffer.size = 0;
-
-    ctx->temp_dst_buffer.fd = -1;
-    ctx->temp_dst_buffer.base = 0;
-    ctx->temp_dst_buffer.size = 0;
+    temp_pool_init(&ctx->tempPool);
 
     ctx->fb_width = 0;
     ctx->fb_height = 0;
     ctx->isPremultipliedAlpha = false;
 
+    map_cache_init();
+
     *device = &ctx->device.common;
     return status;
 
@@ -1488,6 +2084,12 @@ error:
             LINK_c2dDestroySurface(ctx->dst[i]);
             ctx->dst[i] = -1;
         }
+        for (int j = 0; j < MAX_FRAME_LAYERS; j++) {
+            if (-1 != (ctx->frameSrc[i][j])) {
+                LINK_c2dDestroySurface(ctx->frameSrc[i][j]);
+                ctx->frameSrc[i][j] = -1;
+            }
+        }
     }
     if (ctx->libc2d2)
         ::dlclose(ctx->libc2d2);
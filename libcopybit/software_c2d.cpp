@@ -0,0 +1,637 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "copybit_c2d_sw"
+
+#include <cutils/log.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "software_c2d.h"
+
+#define MAX_SW_SURFACES     32
+#define DEBUG_SW_C2D        0
+
+struct sw_surface_t {
+    bool used;
+    bool yuv;
+    C2D_RGB_SURFACE_DEF rgb;
+    C2D_YUV_SURFACE_DEF yuvDef;
+};
+
+/* Premultiplied ARGB, 8 bits per component */
+struct sw_pixel_t {
+    uint32_t a, r, g, b;
+};
+
+static pthread_mutex_t sSurfaceLock = PTHREAD_MUTEX_INITIALIZER;
+static sw_surface_t sSurfaces[MAX_SW_SURFACES];
+static uintptr_t sTimestamp = 0;
+
+static inline uint32_t clamp255(int v)
+{
+    return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+static inline uint32_t mul255(uint32_t a, uint32_t b)
+{
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+/* Surface ids are table indices plus one, 0 is never handed out */
+static sw_surface_t* get_surface(uint32 id)
+{
+    if (id == 0 || id > MAX_SW_SURFACES || !sSurfaces[id - 1].used)
+        return NULL;
+    return &sSurfaces[id - 1];
+}
+
+static uint32 base_format(uint32 format)
+{
+    return format & 0xFF;
+}
+
+static bool is_supported(const sw_surface_t *s)
+{
+    if (s->yuv) {
+        if (s->yuvDef.format & (C2D_FORMAT_MACROTILED | C2D_FORMAT_TILED_4x4))
+            return false;
+        switch (base_format(s->yuvDef.format)) {
+            case C2D_COLOR_FORMAT_420_NV12:
+            case C2D_COLOR_FORMAT_420_NV21:
+            case C2D_COLOR_FORMAT_420_YV12:
+            case C2D_COLOR_FORMAT_420_I420:
+                return true;
+            default:
+                return false;
+        }
+    }
+    switch (base_format(s->rgb.format)) {
+        case C2D_COLOR_FORMAT_565_RGB:
+        case C2D_COLOR_FORMAT_8888_ARGB:
+        case C2D_COLOR_FORMAT_5551_RGBA:
+        case C2D_COLOR_FORMAT_4444_RGBA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static int surface_width(const sw_surface_t *s)
+{
+    return s->yuv ? s->yuvDef.width : s->rgb.width;
+}
+
+static int surface_height(const sw_surface_t *s)
+{
+    return s->yuv ? s->yuvDef.height : s->rgb.height;
+}
+
+/* Width of the surface including the stride padding. copybit places
+ * rotated target rects relative to the aligned width. */
+static int surface_aligned_width(const sw_surface_t *s)
+{
+    if (s->yuv)
+        return s->yuvDef.stride0;
+    switch (base_format(s->rgb.format)) {
+        case C2D_COLOR_FORMAT_8888_ARGB: return s->rgb.stride / 4;
+        default:                         return s->rgb.stride / 2;
+    }
+}
+
+static void yuv_to_rgb(int y, int u, int v, sw_pixel_t *p)
+{
+    int c = 298 * (y - 16);
+    int d = u - 128;
+    int e = v - 128;
+    p->a = 255;
+    p->r = clamp255((c + 409 * e + 128) >> 8);
+    p->g = clamp255((c - 100 * d - 208 * e + 128) >> 8);
+    p->b = clamp255((c + 516 * d + 128) >> 8);
+}
+
+static void rgb_to_yuv(const sw_pixel_t *p, int *y, int *u, int *v)
+{
+    int r = p->r, g = p->g, b = p->b;
+    *y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    *u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    *v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+static void get_chroma_planes(const C2D_YUV_SURFACE_DEF *def,
+                              uint8_t **u, uint8_t **v, int *step)
+{
+    switch (base_format(def->format)) {
+        case C2D_COLOR_FORMAT_420_NV12:
+            *u = (uint8_t*)def->plane1;
+            *v = *u + 1;
+            *step = 2;
+            break;
+        case C2D_COLOR_FORMAT_420_NV21:
+            *v = (uint8_t*)def->plane1;
+            *u = *v + 1;
+            *step = 2;
+            break;
+        case C2D_COLOR_FORMAT_420_YV12:
+            *v = (uint8_t*)def->plane1;
+            *u = (uint8_t*)def->plane2;
+            *step = 1;
+            break;
+        default:
+            *u = (uint8_t*)def->plane1;
+            *v = (uint8_t*)def->plane2;
+            *step = 1;
+            break;
+    }
+}
+
+static void read_pixel(const sw_surface_t *s, int x, int y, sw_pixel_t *p)
+{
+    if (s->yuv) {
+        const C2D_YUV_SURFACE_DEF *def = &s->yuvDef;
+        uint8_t *u, *v;
+        int step;
+        get_chroma_planes(def, &u, &v, &step);
+        int luma = ((uint8_t*)def->plane0)[y * def->stride0 + x];
+        int off = (y / 2) * def->stride1 + (x / 2) * step;
+        yuv_to_rgb(luma, u[off], v[off], p);
+        return;
+    }
+
+    const C2D_RGB_SURFACE_DEF *def = &s->rgb;
+    uint8_t *row = (uint8_t*)def->buffer + y * def->stride;
+    uint32_t fmt = def->format;
+    switch (base_format(fmt)) {
+        case C2D_COLOR_FORMAT_565_RGB: {
+            uint16_t c = ((uint16_t*)row)[x];
+            p->a = 255;
+            p->r = ((c >> 11) & 0x1F) * 255 / 31;
+            p->g = ((c >> 5) & 0x3F) * 255 / 63;
+            p->b = (c & 0x1F) * 255 / 31;
+        } break;
+        case C2D_COLOR_FORMAT_5551_RGBA: {
+            uint16_t c = ((uint16_t*)row)[x];
+            p->r = ((c >> 11) & 0x1F) * 255 / 31;
+            p->g = ((c >> 6) & 0x1F) * 255 / 31;
+            p->b = ((c >> 1) & 0x1F) * 255 / 31;
+            p->a = (c & 0x1) ? 255 : 0;
+        } break;
+        case C2D_COLOR_FORMAT_4444_RGBA: {
+            uint16_t c = ((uint16_t*)row)[x];
+            p->r = ((c >> 12) & 0xF) * 17;
+            p->g = ((c >> 8) & 0xF) * 17;
+            p->b = ((c >> 4) & 0xF) * 17;
+            p->a = (c & 0xF) * 17;
+        } break;
+        default: {
+            // 0xAARRGGBB, or 0xAABBGGRR with C2D_FORMAT_SWAP_RB
+            uint32_t c = ((uint32_t*)row)[x];
+            p->a = c >> 24;
+            p->r = (c >> 16) & 0xFF;
+            p->g = (c >> 8) & 0xFF;
+            p->b = c & 0xFF;
+            if (fmt & C2D_FORMAT_SWAP_RB) {
+                uint32_t t = p->r;
+                p->r = p->b;
+                p->b = t;
+            }
+        } break;
+    }
+
+    if (fmt & C2D_FORMAT_DISABLE_ALPHA) {
+        p->a = 255;
+    } else if (!(fmt & C2D_FORMAT_PREMULTIPLIED)) {
+        p->r = mul255(p->r, p->a);
+        p->g = mul255(p->g, p->a);
+        p->b = mul255(p->b, p->a);
+    }
+}
+
+static void write_pixel(const sw_surface_t *s, int x, int y,
+                        const sw_pixel_t *in)
+{
+    if (s->yuv) {
+        const C2D_YUV_SURFACE_DEF *def = &s->yuvDef;
+        int luma, cb, cr;
+        rgb_to_yuv(in, &luma, &cb, &cr);
+        ((uint8_t*)def->plane0)[y * def->stride0 + x] = clamp255(luma);
+        // Chroma is taken from the top left pixel of each 2x2 block
+        if (!(x & 1) && !(y & 1)) {
+            uint8_t *u, *v;
+            int step;
+            get_chroma_planes(def, &u, &v, &step);
+            int off = (y / 2) * def->stride1 + (x / 2) * step;
+            u[off] = clamp255(cb);
+            v[off] = clamp255(cr);
+        }
+        return;
+    }
+
+    const C2D_RGB_SURFACE_DEF *def = &s->rgb;
+    uint8_t *row = (uint8_t*)def->buffer + y * def->stride;
+    uint32_t fmt = def->format;
+    sw_pixel_t p = *in;
+    if (fmt & C2D_FORMAT_DISABLE_ALPHA) {
+        p.a = 255;
+    } else if (!(fmt & C2D_FORMAT_PREMULTIPLIED) && p.a && p.a != 255) {
+        p.r = clamp255((p.r * 255 + p.a / 2) / p.a);
+        p.g = clamp255((p.g * 255 + p.a / 2) / p.a);
+        p.b = clamp255((p.b * 255 + p.a / 2) / p.a);
+    }
+
+    switch (base_format(fmt)) {
+        case C2D_COLOR_FORMAT_565_RGB:
+            ((uint16_t*)row)[x] = ((p.r * 31 + 127) / 255) << 11 |
+                                  ((p.g * 63 + 127) / 255) << 5 |
+                                  ((p.b * 31 + 127) / 255);
+            break;
+        case C2D_COLOR_FORMAT_5551_RGBA:
+            ((uint16_t*)row)[x] = ((p.r * 31 + 127) / 255) << 11 |
+                                  ((p.g * 31 + 127) / 255) << 6 |
+                                  ((p.b * 31 + 127) / 255) << 1 |
+                                  (p.a >= 128 ? 1 : 0);
+            break;
+        case C2D_COLOR_FORMAT_4444_RGBA:
+            ((uint16_t*)row)[x] = ((p.r + 8) / 17) << 12 |
+                                  ((p.g + 8) / 17) << 8 |
+                                  ((p.b + 8) / 17) << 4 |
+                                  ((p.a + 8) / 17);
+            break;
+        default:
+            if (fmt & C2D_FORMAT_SWAP_RB) {
+                uint32_t t = p.r;
+                p.r = p.b;
+                p.b = t;
+            }
+            ((uint32_t*)row)[x] = p.a << 24 | p.r << 16 | p.g << 8 | p.b;
+            break;
+    }
+}
+
+/* Map a pixel of the target surface to the rotated coordinate space the
+ * target rects are given in. */
+static void physical_to_virtual(uint32 rotation, int alignedWidth, int height,
+                                int px, int py, int *vx, int *vy)
+{
+    switch (rotation) {
+        case C2D_TARGET_ROTATE_90:
+            *vx = height - 1 - py;
+            *vy = px;
+            break;
+        case C2D_TARGET_ROTATE_180:
+            *vx = alignedWidth - 1 - px;
+            *vy = height - 1 - py;
+            break;
+        case C2D_TARGET_ROTATE_270:
+            *vx = py;
+            *vy = alignedWidth - 1 - px;
+            break;
+        default:
+            *vx = px;
+            *vy = py;
+            break;
+    }
+}
+
+static void virtual_to_physical(uint32 rotation, int alignedWidth, int height,
+                                int vx, int vy, int *px, int *py)
+{
+    switch (rotation) {
+        case C2D_TARGET_ROTATE_90:
+            *px = vy;
+            *py = height - 1 - vx;
+            break;
+        case C2D_TARGET_ROTATE_180:
+            *px = alignedWidth - 1 - vx;
+            *py = height - 1 - vy;
+            break;
+        case C2D_TARGET_ROTATE_270:
+            *px = alignedWidth - 1 - vy;
+            *py = vx;
+            break;
+        default:
+            *px = vx;
+            *py = vy;
+            break;
+    }
+}
+
+static inline void intersect(int *l, int *t, int *r, int *b, const C2D_RECT *c)
+{
+    if (*l < c->x) *l = c->x;
+    if (*t < c->y) *t = c->y;
+    if (*r > c->x + c->width) *r = c->x + c->width;
+    if (*b > c->y + c->height) *b = c->y + c->height;
+}
+
+static C2D_STATUS draw_object(const sw_surface_t *dst, uint32 target_config,
+                              const C2D_RECT *target_scissor,
+                              const C2D_OBJECT *obj)
+{
+    const sw_surface_t *src = get_surface(obj->surface_id);
+    if (!src || !is_supported(src)) {
+        ALOGE("%s: unsupported source surface %d", __FUNCTION__,
+              obj->surface_id);
+        return C2D_STATUS_NOT_SUPPORTED;
+    }
+    if (obj->config_mask & (C2D_MASK_SURFACE_BIT | C2D_COLOR_KEY_BIT |
+                            C2D_SOURCE_TILE_BIT | C2D_ROTATE_BIT |
+                            C2D_DRAW_LINE_BIT)) {
+        ALOGE("%s: unsupported config 0x%x", __FUNCTION__, obj->config_mask);
+        return C2D_STATUS_NOT_SUPPORTED;
+    }
+
+    // Source and target rects are 16.16 fixed point
+    int sx = 0, sy = 0;
+    int sw = surface_width(src), sh = surface_height(src);
+    if (obj->config_mask & C2D_SOURCE_RECT_BIT) {
+        sx = obj->source_rect.x >> 16;
+        sy = obj->source_rect.y >> 16;
+        sw = obj->source_rect.width >> 16;
+        sh = obj->source_rect.height >> 16;
+    }
+    int tx = 0, ty = 0, tw = sw, th = sh;
+    if (obj->config_mask & C2D_TARGET_RECT_BIT) {
+        tx = obj->target_rect.x >> 16;
+        ty = obj->target_rect.y >> 16;
+        tw = obj->target_rect.width >> 16;
+        th = obj->target_rect.height >> 16;
+    }
+    if (sw <= 0 || sh <= 0 || tw <= 0 || th <= 0)
+        return C2D_STATUS_OK;
+
+    uint32 rotation = target_config & C2D_TARGET_ROTATION_MASK;
+    int alignedWidth = surface_aligned_width(dst);
+    int height = surface_height(dst);
+
+    // Bounding box of the target rect on the target surface
+    int x0, y0, x1, y1;
+    virtual_to_physical(rotation, alignedWidth, height, tx, ty, &x0, &y0);
+    virtual_to_physical(rotation, alignedWidth, height, tx + tw - 1,
+                        ty + th - 1, &x1, &y1);
+    int l = (x0 < x1) ? x0 : x1;
+    int t = (y0 < y1) ? y0 : y1;
+    int r = ((x0 > x1) ? x0 : x1) + 1;
+    int b = ((y0 > y1) ? y0 : y1) + 1;
+
+    C2D_RECT bounds = { 0, 0, surface_width(dst), height };
+    intersect(&l, &t, &r, &b, &bounds);
+    if (obj->config_mask & C2D_SCISSOR_RECT_BIT)
+        intersect(&l, &t, &r, &b, &obj->scissor_rect);
+    if (target_scissor)
+        intersect(&l, &t, &r, &b, target_scissor);
+
+    uint32_t globalAlpha = (obj->config_mask & C2D_GLOBAL_ALPHA_BIT) ?
+                           (obj->global_alpha & 0xFF) : 255;
+    bool blend = !(obj->config_mask & C2D_ALPHA_BLEND_NONE);
+    bool noPixelAlpha = (obj->config_mask & C2D_NO_PIXEL_ALPHA_BIT);
+    // Source rects may reach past the surface, sample its edge there
+    int maxU = surface_width(src) - 1;
+    int maxV = surface_height(src) - 1;
+    if (maxU < 0 || maxV < 0)
+        return C2D_STATUS_OK;
+
+    for (int py = t; py < b; py++) {
+        for (int px = l; px < r; px++) {
+            int vx, vy;
+            physical_to_virtual(rotation, alignedWidth, height, px, py,
+                                &vx, &vy);
+            // Nearest sample at the pixel centre
+            int u = sx + (int)(((int64_t)(2 * (vx - tx) + 1) * sw) / (2 * tw));
+            int v = sy + (int)(((int64_t)(2 * (vy - ty) + 1) * sh) / (2 * th));
+            if (obj->config_mask & C2D_MIRROR_H_BIT)
+                u = 2 * sx + sw - 1 - u;
+            if (obj->config_mask & C2D_MIRROR_V_BIT)
+                v = 2 * sy + sh - 1 - v;
+            u = (u < 0) ? 0 : (u > maxU) ? maxU : u;
+            v = (v < 0) ? 0 : (v > maxV) ? maxV : v;
+
+            sw_pixel_t s;
+            read_pixel(src, u, v, &s);
+            if (noPixelAlpha)
+                s.a = 255;
+            if (!blend) {
+                write_pixel(dst, px, py, &s);
+                continue;
+            }
+            if (globalAlpha != 255) {
+                s.a = mul255(s.a, globalAlpha);
+                s.r = mul255(s.r, globalAlpha);
+                s.g = mul255(s.g, globalAlpha);
+                s.b = mul255(s.b, globalAlpha);
+            }
+            if (s.a != 255) {
+                // Porter-Duff source over destination
+                sw_pixel_t d;
+                read_pixel(dst, px, py, &d);
+                uint32_t inv = 255 - s.a;
+                s.a += mul255(d.a, inv);
+                s.r += mul255(d.r, inv);
+                s.g += mul255(d.g, inv);
+                s.b += mul255(d.b, inv);
+            }
+            write_pixel(dst, px, py, &s);
+        }
+    }
+    return C2D_STATUS_OK;
+}
+
+static C2D_STATUS set_definition(sw_surface_t *s, C2D_SURFACE_TYPE type,
+                                 void *definition)
+{
+    int base = type & (C2D_SURFACE_WITH_PHYS - 1);
+    if (base == C2D_SURFACE_RGB_HOST || base == C2D_SURFACE_RGB_EXT) {
+        s->yuv = false;
+        s->rgb = *(C2D_RGB_SURFACE_DEF*)definition;
+    } else if (base == C2D_SURFACE_YUV_HOST || base == C2D_SURFACE_YUV_EXT) {
+        s->yuv = true;
+        s->yuvDef = *(C2D_YUV_SURFACE_DEF*)definition;
+    } else {
+        ALOGE("%s: invalid surface type 0x%x", __FUNCTION__, type);
+        return C2D_STATUS_INVALID_PARAM;
+    }
+    return C2D_STATUS_OK;
+}
+
+C2D_STATUS sw_c2dCreateSurface(uint32 *surface_id, uint32 surface_bits,
+                               C2D_SURFACE_TYPE surface_type,
+                               void *surface_definition)
+{
+    if (!surface_id || !surface_definition)
+        return C2D_STATUS_INVALID_PARAM;
+
+    C2D_STATUS status = C2D_STATUS_OUT_OF_MEMORY;
+    pthread_mutex_lock(&sSurfaceLock);
+    for (int i = 0; i < MAX_SW_SURFACES; i++) {
+        if (!sSurfaces[i].used) {
+            status = set_definition(&sSurfaces[i], surface_type,
+                                    surface_definition);
+            if (status == C2D_STATUS_OK) {
+                sSurfaces[i].used = true;
+                *surface_id = i + 1;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sSurfaceLock);
+    return status;
+}
+
+C2D_STATUS sw_c2dUpdateSurface(uint32 surface_id, uint32 surface_bits,
+                               C2D_SURFACE_TYPE surface_type,
+                               void *surface_definition)
+{
+    if (!surface_definition)
+        return C2D_STATUS_INVALID_PARAM;
+
+    C2D_STATUS status = C2D_STATUS_INVALID_PARAM;
+    pthread_mutex_lock(&sSurfaceLock);
+    sw_surface_t *s = get_surface(surface_id);
+    if (s)
+        status = set_definition(s, surface_type, surface_definition);
+    pthread_mutex_unlock(&sSurfaceLock);
+    return status;
+}
+
+C2D_STATUS sw_c2dReadSurface(uint32 surface_id, C2D_SURFACE_TYPE surface_type,
+                             void *surface_definition, int32 x, int32 y)
+{
+    sw_surface_t out;
+    memset(&out, 0, sizeof(out));
+    if (!surface_definition ||
+        set_definition(&out, surface_type, surface_definition) != C2D_STATUS_OK)
+        return C2D_STATUS_INVALID_PARAM;
+
+    C2D_STATUS status = C2D_STATUS_OK;
+    pthread_mutex_lock(&sSurfaceLock);
+    sw_surface_t *s = get_surface(surface_id);
+    if (!s || !is_supported(s) || !is_supported(&out) ||
+        x < 0 || y < 0 ||
+        x + surface_width(&out) > surface_width(s) ||
+        y + surface_height(&out) > surface_height(s)) {
+        status = C2D_STATUS_INVALID_PARAM;
+    } else {
+        for (int j = 0; j < surface_height(&out); j++) {
+            for (int i = 0; i < surface_width(&out); i++) {
+                sw_pixel_t p;
+                read_pixel(s, x + i, y + j, &p);
+                write_pixel(&out, i, j, &p);
+            }
+        }
+    }
+    pthread_mutex_unlock(&sSurfaceLock);
+    return status;
+}
+
+C2D_STATUS sw_c2dDraw(uint32 target_id, uint32 target_config,
+                      C2D_RECT *target_scissor, uint32 target_mask_id,
+                      uint32 target_color_key, C2D_OBJECT *objects_list,
+                      uint32 num_objects)
+{
+    if (target_config & (C2D_TARGET_MIRROR_H | C2D_TARGET_MIRROR_V |
+                         C2D_TARGET_MASK_ALIGN | C2D_TARGET_MASK_SCALE |
+                         C2D_TARGET_MASK_TILE | C2D_TARGET_COLOR_KEY)) {
+        ALOGE("%s: unsupported target config 0x%x", __FUNCTION__,
+              target_config);
+        return C2D_STATUS_NOT_SUPPORTED;
+    }
+
+    C2D_STATUS status = C2D_STATUS_OK;
+    pthread_mutex_lock(&sSurfaceLock);
+    const sw_surface_t *dst = get_surface(target_id);
+    if (!dst || !is_supported(dst)) {
+        ALOGE("%s: unsupported target surface %d", __FUNCTION__, target_id);
+        status = C2D_STATUS_NOT_SUPPORTED;
+    }
+
+    // Objects are drawn in list order, each blending over the previous
+    const C2D_OBJECT *obj = objects_list;
+    for (uint32 i = 0; status == C2D_STATUS_OK && obj && i < num_objects; i++) {
+        status = draw_object(dst, target_config, target_scissor, obj);
+        obj = obj->next ? obj->next : obj + 1;
+    }
+    pthread_mutex_unlock(&sSurfaceLock);
+    ALOGD_IF(DEBUG_SW_C2D, "%s: target=%d objects=%d status=%d",
+             __FUNCTION__, target_id, num_objects, status);
+    return status;
+}
+
+/* Blits complete inside sw_c2dDraw, so there is never anything to wait on */
+C2D_STATUS sw_c2dFinish(uint32 target_id)
+{
+    return C2D_STATUS_OK;
+}
+
+C2D_STATUS sw_c2dFlush(uint32 target_id, c2d_ts_handle *timestamp)
+{
+    if (!timestamp)
+        return C2D_STATUS_INVALID_PARAM;
+    pthread_mutex_lock(&sSurfaceLock);
+    if (++sTimestamp == 0)
+        ++sTimestamp;
+    *timestamp = (c2d_ts_handle)sTimestamp;
+    pthread_mutex_unlock(&sSurfaceLock);
+    return C2D_STATUS_OK;
+}
+
+C2D_STATUS sw_c2dWaitTimestamp(c2d_ts_handle timestamp)
+{
+    return C2D_STATUS_OK;
+}
+
+C2D_STATUS sw_c2dDestroySurface(uint32 surface_id)
+{
+    C2D_STATUS status = C2D_STATUS_INVALID_PARAM;
+    pthread_mutex_lock(&sSurfaceLock);
+    sw_surface_t *s = get_surface(surface_id);
+    if (s) {
+        memset(s, 0, sizeof(*s));
+        status = C2D_STATUS_OK;
+    }
+    pthread_mutex_unlock(&sSurfaceLock);
+    return status;
+}
+
+/* The CPU reaches the buffers through their host pointers. The returned
+ * address only has to be a non zero token for the caller to hand back. */
+C2D_STATUS sw_c2dMapAddr(int mem_fd, void *hostptr, uint32 len, uint32 offset,
+                         uint32 flags, void **gpuaddr)
+{
+    if (!gpuaddr || !hostptr)
+        return C2D_STATUS_INVALID_PARAM;
+    *gpuaddr = hostptr;
+    return C2D_STATUS_OK;
+}
+
+C2D_STATUS sw_c2dUnMapAddr(void *gpuaddr)
+{
+    return C2D_STATUS_OK;
+}
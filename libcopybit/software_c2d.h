@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SOFTWARE_C2D_H
+#define SOFTWARE_C2D_H
+
+#include "c2d2.h"
+
+/*
+ * CPU implementation of the subset of the C2D 2.0 API used by copybit_c2d.
+ * The entry points have the same signatures as the ones looked up in
+ * libC2D2.so, so they can be plugged into the LINK_c2d* pointers.
+ *
+ * Surfaces are drawn through their host pointers (buffer, plane0..2); the
+ * physical addresses are ignored. Blits are executed synchronously by
+ * sw_c2dDraw, flush and finish only hand out and check timestamps.
+ *
+ * Supported: RGB 565/8888/5551/4444, NV12, NV21, YV12 and I420 sources
+ * and targets, nearest neighbour scaling, source mirroring, target
+ * rotation in steps of 90 degrees, scissoring, global alpha and source
+ * over blending. Masks, color keys, palettes and tiled formats are not.
+ */
+
+C2D_STATUS sw_c2dCreateSurface(uint32 *surface_id, uint32 surface_bits,
+                               C2D_SURFACE_TYPE surface_type,
+                               void *surface_definition);
+
+C2D_STATUS sw_c2dUpdateSurface(uint32 surface_id, uint32 surface_bits,
+                               C2D_SURFACE_TYPE surface_type,
+                               void *surface_definition);
+
+C2D_STATUS sw_c2dReadSurface(uint32 surface_id, C2D_SURFACE_TYPE surface_type,
+                             void *surface_definition, int32 x, int32 y);
+
+C2D_STATUS sw_c2dDraw(uint32 target_id, uint32 target_config,
+                      C2D_RECT *target_scissor, uint32 target_mask_id,
+                      uint32 target_color_key, C2D_OBJECT *objects_list,
+                      uint32 num_objects);
+
+C2D_STATUS sw_c2dFinish(uint32 target_id);
+
+C2D_STATUS sw_c2dFlush(uint32 target_id, c2d_ts_handle *timestamp);
+
+C2D_STATUS sw_c2dWaitTimestamp(c2d_ts_handle timestamp);
+
+C2D_STATUS sw_c2dDestroySurface(uint32 surface_id);
+
+C2D_STATUS sw_c2dMapAddr(int mem_fd, void *hostptr, uint32 len, uint32 offset,
+                         uint32 flags, void **gpuaddr);
+
+C2D_STATUS sw_c2dUnMapAddr(void *gpuaddr);
+
+#endif // SOFTWARE_C2D_H
@@ -29,9 +29,195 @@
 
 #define LOG_TAG "copybit"
 #include <cutils/log.h>
+#include <cutils/properties.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "software_converter.h"
+#include "conv_kernels.h"
+
+#define DEBUG_CONVERTER 0
+
+/*
+ * The pixel kernels live in conv_kernels.cpp. The best backend the CPU
+ * supports is picked once at first use; debug.copybit.swconv names a
+ * backend to use instead (scalar, neon, sse2 or avx2) if it is available.
+ */
+static const convKernels *sKernels = NULL;
+static pthread_once_t sKernelsOnce = PTHREAD_ONCE_INIT;
+
+/*
+ * Plane repacks of large frames are split into row bands and spread over
+ * a small pool of worker threads; the calling thread takes the first band.
+ * debug.copybit.swconv.threads sets the number of bands (1 disables the
+ * pool) and frames below debug.copybit.swconv.mtmin pixels stay
+ * single-threaded, as the wakeups cost more than they save there.
+ */
+#define MAX_CONV_THREADS         4
+#define DEFAULT_CONV_MT_MIN_PIXELS (640 * 480)
+#define MAX_CONV_PLANES          2
+
+struct convPlane {
+    unsigned char *dst;
+    const unsigned char *src;
+    unsigned int width;
+    unsigned int height;
+    unsigned int dst_stride;
+    unsigned int src_stride;
+};
+
+struct convJob {
+    convPlane planes[MAX_CONV_PLANES];
+    int numPlanes;
+    int numBands;
+};
+
+struct convWorkerPool {
+    pthread_mutex_t lock;
+    pthread_cond_t workCond;
+    pthread_cond_t doneCond;
+    // Serializes callers, the pool runs one job at a time
+    pthread_mutex_t dispatchLock;
+    pthread_t threads[MAX_CONV_THREADS - 1];
+    int numThreads;
+    unsigned int generation;
+    int pending;
+    convJob job;
+};
+
+static convWorkerPool sPool = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+};
+static int sNumBands = 1;
+static unsigned int sMtMinPixels = DEFAULT_CONV_MT_MIN_PIXELS;
+
+/* Copy this band's share of rows of every plane in the job */
+static void run_band(const convJob& job, int band)
+{
+    for (int p = 0; p < job.numPlanes; p++) {
+        const convPlane& plane = job.planes[p];
+        unsigned int first = plane.height * band / job.numBands;
+        unsigned int last = plane.height * (band + 1) / job.numBands;
+        if (first == last)
+            continue;
+        sKernels->copyPlane(plane.dst + first * plane.dst_stride,
+                            plane.src + first * plane.src_stride,
+                            plane.width, last - first,
+                            plane.dst_stride, plane.src_stride);
+    }
+}
+
+static void* conv_worker(void *arg)
+{
+    int band = (int)(intptr_t)arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&sPool.lock);
+    while (true) {
+        while (sPool.generation == seen)
+            pthread_cond_wait(&sPool.workCond, &sPool.lock);
+        seen = sPool.generation;
+        convJob job = sPool.job;
+        pthread_mutex_unlock(&sPool.lock);
+
+        if (band < job.numBands)
+            run_band(job, band);
+
+        pthread_mutex_lock(&sPool.lock);
+        if (--sPool.pending == 0)
+            pthread_cond_signal(&sPool.doneCond);
+    }
+    return NULL;
+}
+
+static void start_workers()
+{
+    for (int i = 0; i < sNumBands - 1; i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        // Helper i works on band i + 1
+        int err = pthread_create(&sPool.threads[i], &attr, conv_worker,
+                                 (void *)(intptr_t)(i + 1));
+        pthread_attr_destroy(&attr);
+        if (err) {
+            ALOGE("%s: pthread_create failed: %s", __FUNCTION__,
+                  strerror(err));
+            break;
+        }
+        sPool.numThreads++;
+    }
+    sNumBands = sPool.numThreads + 1;
+}
+
+static void select_kernels()
+{
+    char property[PROPERTY_VALUE_MAX];
+    const convKernels *best = NULL;
+    conv_supported_kernels(&best, 1);
+    sKernels = best;
+    if (property_get("debug.copybit.swconv", property, NULL) > 0) {
+        const convKernels *forced = conv_find_kernels(property);
+        if (forced)
+            sKernels = forced;
+        else
+            ALOGE("%s: %s kernels are not available", __FUNCTION__, property);
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    sNumBands = (cpus > 0) ? (int)cpus : 1;
+    if (property_get("debug.copybit.swconv.threads", property, NULL) > 0)
+        sNumBands = atoi(property);
+    if (sNumBands < 1)
+        sNumBands = 1;
+    if (sNumBands > MAX_CONV_THREADS)
+        sNumBands = MAX_CONV_THREADS;
+    if (property_get("debug.copybit.swconv.mtmin", property, NULL) > 0)
+        sMtMinPixels = atoi(property);
+    start_workers();
+
+    ALOGD_IF(DEBUG_CONVERTER, "%s: using %s kernels, %d bands above %u "
+             "pixels", __FUNCTION__, sKernels->name, sNumBands, sMtMinPixels);
+}
+
+static inline const convKernels* get_kernels()
+{
+    pthread_once(&sKernelsOnce, select_kernels);
+    return sKernels;
+}
+
+/* Run a plane copy job, banded across the worker pool if it is large enough */
+static void run_job(convJob& job, unsigned int pixels)
+{
+    get_kernels();
+    if (sNumBands < 2 || pixels < sMtMinPixels) {
+        job.numBands = 1;
+        run_band(job, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&sPool.dispatchLock);
+    job.numBands = sNumBands;
+    pthread_mutex_lock(&sPool.lock);
+    sPool.job = job;
+    sPool.pending = sPool.numThreads;
+    sPool.generation++;
+    pthread_cond_broadcast(&sPool.workCond);
+    pthread_mutex_unlock(&sPool.lock);
+
+    run_band(job, 0);
+
+    pthread_mutex_lock(&sPool.lock);
+    while (sPool.pending)
+        pthread_cond_wait(&sPool.doneCond, &sPool.lock);
+    pthread_mutex_unlock(&sPool.lock);
+    pthread_mutex_unlock(&sPool.dispatchLock);
+}
 
 /** Convert YV12 to YCrCb_420_SP */
 int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_handle)
@@ -43,6 +229,8 @@ int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_h
         return -1;
     }
 
+    const convKernels *kernels = get_kernels();
+
     // Please refer to the description of YV12 in hardware.h
     // for the formulae used to calculate buffer sizes and offsets
 
@@ -56,72 +244,52 @@ int convertYV12toYCrCb420SP(const copybit_image_t *src, private_handle_t *yv12_h
     unsigned int   c_width = ALIGN(stride/2, 16);
     unsigned int   c_size  = c_width * src->h/2;
     unsigned int   chromaPadding = c_width - width/2;
-    unsigned int   chromaSize = c_size * 2;
     unsigned char* newChroma = (unsigned char *)(yv12_handle->base + y_size);
     unsigned char* oldChroma = (unsigned char*)(hnd->base + y_size);
     memcpy((char *)yv12_handle->base,(char *)hnd->base,y_size);
 
-#ifdef __ARM_HAVE_NEON
-   /* interleave */
+    // The V plane is followed by the U plane, both c_width wide.
+    // Interleave them as VU pairs, dropping the chroma padding if any.
+    const unsigned char *vPlane = oldChroma;
+    const unsigned char *uPlane = oldChroma + c_size;
     if(!chromaPadding) {
-        unsigned char * t1 = newChroma;
-        unsigned char * t2 = oldChroma;
-        unsigned char * t3 = t2 + chromaSize/2;
-        for(unsigned int i=0; i < (chromaSize/2)>>3; i++) {
-            __asm__ __volatile__ (
-                                    "vld1.u8 d0, [%0]! \n"
-                                    "vld1.u8 d1, [%1]! \n"
-                                    "vst2.u8 {d0, d1}, [%2]! \n"
-                                    :"+r"(t2), "+r"(t3), "+r"(t1)
-                                    :
-                                    :"memory","d0","d1"
-                                 );
-
+        kernels->interleave(newChroma, vPlane, uPlane, c_size);
+    } else {
+        unsigned int pairs = width/2;
+        for(unsigned int row = 0; row < height/2; row++) {
+            kernels->interleave(newChroma, vPlane, uPlane, pairs);
+            newChroma += pairs * 2;
+            vPlane += c_width;
+            uPlane += c_width;
         }
     }
-#else  //__ARM_HAVE_NEON
-    if(!chromaPadding) {
-        for(unsigned int i = 0; i< chromaSize/2; i++) {
-            newChroma[i*2]   = oldChroma[i];
-            newChroma[i*2+1] = oldChroma[i+chromaSize/2];
-        }
 
-    }
-#endif
-    // If the image is not aligned to 16 pixels,
-    // convert using the C routine below
-    // r1 tracks the row of the source buffer
-    // r2 tracks the row of the destination buffer
-    // The width/2 checks are to avoid copying
-    // from the padding
-
-    if(chromaPadding) {
-        unsigned int r1 = 0, r2 = 0, i = 0, j = 0;
-        while(r1 < height/2) {
-            if(j == width) {
-                j = 0;
-                r2++;
-                continue;
-            }
-            if (j+1 == width) {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                r2++;
-                newChroma[r2*width] = oldChroma[r1*c_width+i+c_size];
-                j = 1;
-            } else {
-                newChroma[r2*width + j] = oldChroma[r1*c_width+i];
-                newChroma[r2*width + j + 1] = oldChroma[r1*c_width+i+c_size];
-                j+=2;
-            }
-            i++;
-            if (i == width/2 ) {
-                i = 0;
-                r1++;
-            }
-        }
+  return 0;
+}
+
+/** Convert YCbCr_420_SP to YCrCb_420_SP, or back */
+int convertYCbCr420SPtoYCrCb420SP(const copybit_image_t *src,
+                                  private_handle_t *dst_handle)
+{
+    private_handle_t* hnd = (private_handle_t*)src->handle;
+
+    if(hnd == NULL || dst_handle == NULL){
+        ALOGE("Invalid handle");
+        return -1;
     }
 
-  return 0;
+    const convKernels *kernels = get_kernels();
+
+    // w is the stride here as well. Swapping the chroma padding along
+    // with the pixels is harmless, so the plane goes in one pass.
+    unsigned int y_size = src->w * src->h;
+    unsigned int c_size = src->w * (src->h/2);
+    if (dst_handle->base != hnd->base)
+        memcpy((char *)dst_handle->base, (char *)hnd->base, y_size);
+    kernels->swapPairs((unsigned char *)(dst_handle->base + y_size),
+                       (const unsigned char *)(hnd->base + y_size),
+                       c_size/2);
+    return 0;
 }
 
 struct copyInfo{
@@ -145,28 +313,28 @@ static int copy_source_to_destination(const int src_base, const int dst_base,
          return COPYBIT_FAILURE;
     }
 
-    int width = info.width;
-    int height = info.height;
-    unsigned char *src = (unsigned char*)src_base;
-    unsigned char *dst = (unsigned char*)dst_base;
+    convJob job;
+    job.numPlanes = 2;
+    job.numBands = 1;
 
-    // Copy the luma
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
+    // Luma
+    job.planes[0].dst = (unsigned char*)dst_base;
+    job.planes[0].src = (const unsigned char*)src_base;
+    job.planes[0].width = info.width;
+    job.planes[0].height = info.height;
+    job.planes[0].dst_stride = info.dst_stride;
+    job.planes[0].src_stride = info.src_stride;
 
-    // Copy plane 1
-    src = (unsigned char*)(src_base + info.src_plane1_offset);
-    dst = (unsigned char*)(dst_base + info.dst_plane1_offset);
-    width = width/2;
-    height = height/2;
-    for (int i = 0; i < height; i++) {
-        memcpy(dst, src, info.src_stride);
-        src += info.src_stride;
-        dst += info.dst_stride;
-    }
+    // Plane 1. The interleaved chroma rows are as wide as the luma,
+    // rounded up to a whole CbCr pair for odd widths, so only copy that
+    // much and leave the stride padding alone.
+    job.planes[1] = job.planes[0];
+    job.planes[1].width = ALIGN(info.width, 2);
+    job.planes[1].dst = (unsigned char*)(dst_base + info.dst_plane1_offset);
+    job.planes[1].src = (const unsigned char*)(src_base + info.src_plane1_offset);
+    job.planes[1].height = info.height/2;
+
+    run_job(job, info.width * info.height);
     return 0;
 }
 
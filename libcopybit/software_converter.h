@@ -38,6 +38,18 @@
 
 int convertYV12toYCrCb420SP(const copybit_image_t *src,private_handle_t *yv12_handle);
 
+/*
+ * Swap the chroma of a semi-planar 420 image, NV12 to NV21 or NV21 to
+ * NV12. The destination may be the source buffer itself.
+ *
+ * @param: source image
+ * @param: destination buffer handle
+ *
+ * @return: return status
+ */
+int convertYCbCr420SPtoYCrCb420SP(const copybit_image_t *src,
+                                  private_handle_t *dst_handle);
+
 /*
  * Function to convert the c2d format into an equivalent Android format
  *
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test for the software converter kernels. Every backend the CPU
+ * supports is compared byte for byte against the scalar one over odd,
+ * even and padded widths, with guard bytes around each destination row
+ * to catch overruns. Then each backend is timed on a padded 1080p frame.
+ *
+ * Returns non zero if any backend disagrees with the scalar one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "conv_kernels.h"
+
+#define GUARD       32
+#define GUARD_BYTE  0xa5
+#define MAX_BACKENDS 4
+
+static const unsigned int sWidths[] = {
+    1, 2, 3, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 255,
+    257, 319, 320, 321, 720, 1279,
+};
+static const unsigned int sPads[] = { 0, 1, 16, 32, 61 };
+static const unsigned int sHeights[] = { 1, 2, 3, 9 };
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static void fill_random(unsigned char *buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (unsigned char)rand();
+}
+
+/* Destination with GUARD bytes on either side, all set to GUARD_BYTE */
+static unsigned char* alloc_guarded(size_t size)
+{
+    unsigned char *buf = (unsigned char *)malloc(size + 2 * GUARD);
+    memset(buf, GUARD_BYTE, size + 2 * GUARD);
+    return buf + GUARD;
+}
+
+static void free_guarded(unsigned char *buf)
+{
+    free(buf - GUARD);
+}
+
+static bool same(const char *what, const convKernels *k,
+                 const unsigned char *got, const unsigned char *want,
+                 size_t size, unsigned int width, unsigned int pad)
+{
+    // Compare the guards too, they must be untouched in both
+    if (!memcmp(got - GUARD, want - GUARD, size + 2 * GUARD))
+        return true;
+    printf("FAIL %s/%s width %u pad %u\n", k->name, what, width, pad);
+    return false;
+}
+
+static int check_interleave(const convKernels *k, const convKernels *ref)
+{
+    int failures = 0;
+    for (size_t w = 0; w < ARRAY_SIZE(sWidths); w++) {
+        for (size_t p = 0; p < ARRAY_SIZE(sPads); p++) {
+            // first and second start at unaligned offsets
+            unsigned int count = sWidths[w];
+            unsigned int off = sPads[p];
+            unsigned char *src = (unsigned char *)malloc(2 * (count + off));
+            fill_random(src, 2 * (count + off));
+            unsigned char *got = alloc_guarded(count * 2);
+            unsigned char *want = alloc_guarded(count * 2);
+            k->interleave(got, src + off, src + count + off, count);
+            ref->interleave(want, src + off, src + count + off, count);
+            if (!same("interleave", k, got, want, count * 2, count, off))
+                failures++;
+            free_guarded(got);
+            free_guarded(want);
+            free(src);
+        }
+    }
+    return failures;
+}
+
+static int check_swap_pairs(const convKernels *k, const convKernels *ref)
+{
+    int failures = 0;
+    for (size_t w = 0; w < ARRAY_SIZE(sWidths); w++) {
+        for (size_t p = 0; p < ARRAY_SIZE(sPads); p++) {
+            unsigned int count = sWidths[w];
+            unsigned int off = sPads[p];
+            size_t size = count * 2;
+            unsigned char *src = (unsigned char *)malloc(size + off);
+            fill_random(src, size + off);
+            unsigned char *got = alloc_guarded(size);
+            unsigned char *want = alloc_guarded(size);
+            k->swapPairs(got, src + off, count);
+            ref->swapPairs(want, src + off, count);
+            if (!same("swapPairs", k, got, want, size, count, off))
+                failures++;
+
+            // In place, as the NV12/NV21 converter may run it
+            memcpy(got, src + off, size);
+            k->swapPairs(got, got, count);
+            if (!same("swapPairs in place", k, got, want, size, count, off))
+                failures++;
+            free_guarded(got);
+            free_guarded(want);
+            free(src);
+        }
+    }
+    return failures;
+}
+
+static int check_copy_plane(const convKernels *k, const convKernels *ref)
+{
+    int failures = 0;
+    for (size_t w = 0; w < ARRAY_SIZE(sWidths); w++) {
+        for (size_t p = 0; p < ARRAY_SIZE(sPads); p++) {
+            for (size_t h = 0; h < ARRAY_SIZE(sHeights); h++) {
+                // Both directions of the C2D <-> Android repack: padded
+                // source into a tighter destination and the other way
+                unsigned int width = sWidths[w];
+                unsigned int height = sHeights[h];
+                unsigned int strides[2][2] = {
+                    { width + sPads[p], width },
+                    { width, width + sPads[p] },
+                };
+                for (int d = 0; d < 2; d++) {
+                    unsigned int src_stride = strides[d][0];
+                    unsigned int dst_stride = strides[d][1];
+                    size_t src_size = src_stride * height;
+                    size_t dst_size = dst_stride * height;
+                    unsigned char *src = (unsigned char *)malloc(src_size);
+                    fill_random(src, src_size);
+                    unsigned char *got = alloc_guarded(dst_size);
+                    unsigned char *want = alloc_guarded(dst_size);
+                    k->copyPlane(got, src, width, height,
+                                 dst_stride, src_stride);
+                    ref->copyPlane(want, src, width, height,
+                                   dst_stride, src_stride);
+                    if (!same("copyPlane", k, got, want, dst_size, width,
+                              sPads[p]))
+                        failures++;
+                    free_guarded(got);
+                    free_guarded(want);
+                    free(src);
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Time each kernel on a 1080p frame with the C2D stride padding */
+static void measure(const convKernels *k)
+{
+    const unsigned int width = 1920 - 8, height = 1080;
+    const unsigned int src_stride = 1920, dst_stride = 1920 - 8 + 16;
+    const int iterations = 50;
+    unsigned char *src = (unsigned char *)malloc(src_stride * height);
+    unsigned char *dst = (unsigned char *)malloc(dst_stride * height);
+    fill_random(src, src_stride * height);
+    // Only the first touch of dst would see page faults, warm it up
+    k->copyPlane(dst, src, width, height, dst_stride, src_stride);
+
+    double start = now_ms();
+    for (int i = 0; i < iterations; i++)
+        k->copyPlane(dst, src, width, height, dst_stride, src_stride);
+    double copy = (now_ms() - start) / iterations;
+
+    unsigned int pairs = width / 2 * height / 2;
+    start = now_ms();
+    for (int i = 0; i < iterations; i++)
+        k->interleave(dst, src, src + pairs, pairs);
+    double interleave = (now_ms() - start) / iterations;
+
+    start = now_ms();
+    for (int i = 0; i < iterations; i++)
+        k->swapPairs(dst, src, pairs);
+    double swap = (now_ms() - start) / iterations;
+
+    printf("%-8s copyPlane %6.3f ms  interleave %6.3f ms  swapPairs "
+           "%6.3f ms\n", k->name, copy, interleave, swap);
+    free(src);
+    free(dst);
+}
+
+int main()
+{
+    const convKernels *list[MAX_BACKENDS];
+    int count = conv_supported_kernels(list, MAX_BACKENDS);
+    const convKernels *ref = conv_find_kernels("scalar");
+    int failures = 0;
+
+    srand(1);
+    for (int i = 0; i < count; i++) {
+        int f = check_interleave(list[i], ref) +
+                check_swap_pairs(list[i], ref) +
+                check_copy_plane(list[i], ref);
+        printf("%-8s %s\n", list[i]->name, f ? "FAILED" : "ok");
+        failures += f;
+    }
+    for (int i = 0; i < count; i++)
+        measure(list[i]);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,621 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Host test for the software C2D backend. Each case goes through the same
+ * calls copybit_c2d makes for a blit: create the surfaces, update them,
+ * draw, flush, wait for the timestamp, finish and destroy. The target
+ * pixels are then checked against a reference computed here, for plain
+ * copies, nearest up and down scaling, mirroring, rotation, scissoring,
+ * blending and YUV sources. Finally a scaled and rotated video blit is
+ * timed.
+ *
+ * Returns non zero if any case fails.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "software_c2d.h"
+
+#define SENTINEL 0xdeadbeef
+#define FIXED(x) ((x) * 65536)
+
+static int sFailures;
+
+struct image {
+    uint32_t *pixels;
+    int width;
+    int height;
+    int stride;         // in pixels
+};
+
+static void alloc_image(image *img, int width, int height, int pad)
+{
+    img->width = width;
+    img->height = height;
+    img->stride = width + pad;
+    img->pixels = (uint32_t *)malloc(img->stride * height * 4);
+    for (int i = 0; i < img->stride * height; i++)
+        img->pixels[i] = SENTINEL;
+}
+
+/* Opaque pixels, different enough that a wrong sample shows */
+static void fill_opaque(image *img)
+{
+    for (int y = 0; y < img->height; y++)
+        for (int x = 0; x < img->width; x++)
+            img->pixels[y * img->stride + x] =
+                0xff000000 | (rand() & 0xffffff);
+}
+
+static uint32_t pixel(const image *img, int x, int y)
+{
+    return img->pixels[y * img->stride + x];
+}
+
+static void rgb_def(const image *img, C2D_RGB_SURFACE_DEF *def)
+{
+    memset(def, 0, sizeof(*def));
+    def->format = C2D_COLOR_FORMAT_8888_ARGB;
+    def->width = img->width;
+    def->height = img->height;
+    def->buffer = img->pixels;
+    def->stride = img->stride * 4;
+}
+
+static uint32 create_rgb(const image *img, uint32 bits)
+{
+    C2D_RGB_SURFACE_DEF def;
+    rgb_def(img, &def);
+    uint32 id = 0;
+    if (sw_c2dCreateSurface(&id, bits, C2D_SURFACE_RGB_HOST,
+                            &def) != C2D_STATUS_OK || !id) {
+        printf("FAIL create surface\n");
+        sFailures++;
+    }
+    return id;
+}
+
+static void init_object(C2D_OBJECT *obj, uint32 id)
+{
+    memset(obj, 0, sizeof(*obj));
+    obj->surface_id = id;
+}
+
+static void set_rect(C2D_RECT *r, int x, int y, int w, int h)
+{
+    r->x = FIXED(x);
+    r->y = FIXED(y);
+    r->width = FIXED(w);
+    r->height = FIXED(h);
+}
+
+/* Draw, flush, wait and finish, the way copybit completes a blit */
+static C2D_STATUS blit(uint32 target, uint32 config, C2D_OBJECT *obj,
+                       uint32 count)
+{
+    C2D_STATUS status = sw_c2dDraw(target, config, NULL, 0, 0, obj, count);
+    if (status != C2D_STATUS_OK)
+        return status;
+    c2d_ts_handle ts = 0;
+    if (sw_c2dFlush(target, &ts) != C2D_STATUS_OK || !ts ||
+        sw_c2dWaitTimestamp(ts) != C2D_STATUS_OK ||
+        sw_c2dFinish(target) != C2D_STATUS_OK)
+        return C2D_STATUS_INVALID_PARAM;
+    return C2D_STATUS_OK;
+}
+
+static void destroy(uint32 id)
+{
+    if (sw_c2dDestroySurface(id) != C2D_STATUS_OK) {
+        printf("FAIL destroy surface %d\n", id);
+        sFailures++;
+    }
+}
+
+/* Compare every pixel of got, the stride padding included, with want */
+static void check(const char *what, const image *got, const image *want)
+{
+    for (int y = 0; y < got->height; y++) {
+        for (int x = 0; x < got->stride; x++) {
+            uint32_t g = got->pixels[y * got->stride + x];
+            uint32_t w = want->pixels[y * want->stride + x];
+            if (g != w) {
+                printf("FAIL %s: (%d, %d) is %08x, want %08x\n", what, x, y,
+                       g, w);
+                sFailures++;
+                return;
+            }
+        }
+    }
+    printf("ok   %s\n", what);
+}
+
+static void check_status(const char *what, C2D_STATUS got, C2D_STATUS want)
+{
+    if (got != want) {
+        printf("FAIL %s: status %d, want %d\n", what, got, want);
+        sFailures++;
+    }
+}
+
+static int clampi(int v, int lo, int hi)
+{
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+/* Copy a source rect of src into a target rect of dst without blending,
+ * sampling the source at the centre of each target pixel. */
+static void draw_copy(const char *what, const image *src, int sx, int sy,
+                      int sw, int sh, int tx, int ty, int tw, int th,
+                      uint32 mirror)
+{
+    image dst, want;
+    alloc_image(&dst, 40, 30, 3);
+    alloc_image(&want, 40, 30, 3);
+    uint32 srcId = create_rgb(src, C2D_SOURCE);
+    uint32 dstId = create_rgb(&dst, C2D_TARGET);
+
+    C2D_OBJECT obj;
+    init_object(&obj, srcId);
+    obj.config_mask = C2D_SOURCE_RECT_BIT | C2D_TARGET_RECT_BIT |
+                      C2D_ALPHA_BLEND_NONE | mirror;
+    set_rect(&obj.source_rect, sx, sy, sw, sh);
+    set_rect(&obj.target_rect, tx, ty, tw, th);
+    check_status(what, blit(dstId, 0, &obj, 1), C2D_STATUS_OK);
+
+    for (int y = 0; y < th; y++) {
+        for (int x = 0; x < tw; x++) {
+            // Centre of the target pixel, scaled into the source rect
+            int u = sx + (2 * x + 1) * sw / (2 * tw);
+            int v = sy + (2 * y + 1) * sh / (2 * th);
+            if (mirror & C2D_MIRROR_H_BIT)
+                u = 2 * sx + sw - 1 - u;
+            if (mirror & C2D_MIRROR_V_BIT)
+                v = 2 * sy + sh - 1 - v;
+            u = clampi(u, 0, src->width - 1);
+            v = clampi(v, 0, src->height - 1);
+            want.pixels[(ty + y) * want.stride + tx + x] = pixel(src, u, v);
+        }
+    }
+    check(what, &dst, &want);
+
+    destroy(srcId);
+    destroy(dstId);
+    free(dst.pixels);
+    free(want.pixels);
+}
+
+static void test_copies()
+{
+    image src;
+    alloc_image(&src, 16, 12, 5);
+    fill_opaque(&src);
+
+    draw_copy("copy", &src, 0, 0, 16, 12, 0, 0, 16, 12, 0);
+    draw_copy("copy to an offset rect", &src, 4, 2, 8, 6, 7, 9, 8, 6, 0);
+    draw_copy("upscale 2x", &src, 0, 0, 16, 12, 3, 1, 32, 24, 0);
+    draw_copy("upscale 2x3", &src, 2, 2, 8, 8, 0, 0, 16, 24, 0);
+    draw_copy("downscale 2x", &src, 0, 0, 16, 12, 1, 1, 8, 6, 0);
+    draw_copy("downscale 4x", &src, 0, 0, 16, 12, 0, 0, 4, 3, 0);
+    draw_copy("mirror h", &src, 0, 0, 16, 12, 0, 0, 16, 12, C2D_MIRROR_H_BIT);
+    draw_copy("mirror v", &src, 0, 0, 16, 12, 0, 0, 16, 12, C2D_MIRROR_V_BIT);
+    draw_copy("mirror hv, upscale", &src, 0, 0, 16, 12, 0, 0, 32, 24,
+              C2D_MIRROR_H_BIT | C2D_MIRROR_V_BIT);
+    draw_copy("mirror hv, source rect", &src, 3, 2, 9, 7, 5, 4, 9, 7,
+              C2D_MIRROR_H_BIT | C2D_MIRROR_V_BIT);
+    // Source rects past the edges sample the edge pixels
+    draw_copy("source rect past the edges", &src, -2, 6, 20, 8, 0, 0, 20, 8,
+              0);
+    free(src.pixels);
+}
+
+/* Draw src into dst without blending, full surfaces, rotated */
+static void draw_rotated(const image *src, image *dst, uint32 rotation)
+{
+    uint32 srcId = create_rgb(src, C2D_SOURCE);
+    uint32 dstId = create_rgb(dst, C2D_TARGET);
+    C2D_OBJECT obj;
+    init_object(&obj, srcId);
+    obj.config_mask = C2D_ALPHA_BLEND_NONE;
+    check_status("rotate", blit(dstId, rotation, &obj, 1), C2D_STATUS_OK);
+    destroy(srcId);
+    destroy(dstId);
+}
+
+static void test_rotation()
+{
+    image src, rot90, back, twice, rot180, want;
+    alloc_image(&src, 13, 7, 0);
+    alloc_image(&rot90, 7, 13, 0);
+    alloc_image(&back, 13, 7, 0);
+    alloc_image(&twice, 13, 7, 0);
+    alloc_image(&rot180, 13, 7, 0);
+    alloc_image(&want, 13, 7, 0);
+    fill_opaque(&src);
+
+    // 180 turns both axes around
+    for (int y = 0; y < src.height; y++)
+        for (int x = 0; x < src.width; x++)
+            want.pixels[y * want.stride + x] =
+                pixel(&src, src.width - 1 - x, src.height - 1 - y);
+    draw_rotated(&src, &rot180, C2D_TARGET_ROTATE_180);
+    check("rotate 180", &rot180, &want);
+
+    // 90 twice is 180, and 270 undoes 90
+    draw_rotated(&src, &rot90, C2D_TARGET_ROTATE_90);
+    draw_rotated(&rot90, &twice, C2D_TARGET_ROTATE_90);
+    check("rotate 90 twice", &twice, &want);
+    draw_rotated(&rot90, &back, C2D_TARGET_ROTATE_270);
+    check("rotate 90 then 270", &back, &src);
+
+    free(src.pixels);
+    free(rot90.pixels);
+    free(back.pixels);
+    free(twice.pixels);
+    free(rot180.pixels);
+    free(want.pixels);
+}
+
+/* Only the pixels inside the scissor rect change, given either with the
+ * object or for the whole draw */
+static void test_scissor()
+{
+    image src, want;
+    alloc_image(&src, 20, 20, 0);
+    alloc_image(&want, 20, 20, 2);
+    fill_opaque(&src);
+    for (int y = 5; y < 11; y++)
+        for (int x = 3; x < 12; x++)
+            want.pixels[y * want.stride + x] = pixel(&src, x, y);
+
+    C2D_RECT scissor = { 3, 5, 9, 6 };
+    for (int perObject = 0; perObject < 2; perObject++) {
+        image dst;
+        alloc_image(&dst, 20, 20, 2);
+        uint32 srcId = create_rgb(&src, C2D_SOURCE);
+        uint32 dstId = create_rgb(&dst, C2D_TARGET);
+        C2D_OBJECT obj;
+        init_object(&obj, srcId);
+        obj.config_mask = C2D_ALPHA_BLEND_NONE;
+        const char *what = "target scissor";
+        if (perObject) {
+            obj.config_mask |= C2D_SCISSOR_RECT_BIT;
+            obj.scissor_rect = scissor;
+            what = "object scissor";
+            check_status(what, blit(dstId, 0, &obj, 1), C2D_STATUS_OK);
+        } else {
+            check_status(what, sw_c2dDraw(dstId, 0, &scissor, 0, 0, &obj, 1),
+                         C2D_STATUS_OK);
+        }
+        check(what, &dst, &want);
+        destroy(srcId);
+        destroy(dstId);
+        free(dst.pixels);
+    }
+    free(src.pixels);
+    free(want.pixels);
+}
+
+/* Source over destination in floating point, non premultiplied ARGB */
+static uint32_t blend_ref(uint32_t s, uint32_t d, int globalAlpha)
+{
+    double sa = (s >> 24) / 255.0 * globalAlpha / 255.0;
+    double da = (d >> 24) / 255.0;
+    double oa = sa + da * (1 - sa);
+    uint32_t out = (uint32_t)(oa * 255 + 0.5) << 24;
+    for (int shift = 0; shift < 24; shift += 8) {
+        double sc = ((s >> shift) & 0xff) * sa;
+        double dc = ((d >> shift) & 0xff) * da;
+        double oc = oa ? (sc + dc * (1 - sa)) / oa : 0;
+        out |= (uint32_t)(oc + 0.5) << shift;
+    }
+    return out;
+}
+
+static bool close_to(uint32_t a, uint32_t b, int tolerance)
+{
+    for (int shift = 0; shift < 32; shift += 8) {
+        int d = (int)((a >> shift) & 0xff) - (int)((b >> shift) & 0xff);
+        if (d < -tolerance || d > tolerance)
+            return false;
+    }
+    return true;
+}
+
+static void test_blend()
+{
+    static const uint32_t srcColors[] = {
+        0x80ff0000, 0x4000ff00, 0xff123456, 0x00ffffff, 0xc0808080,
+    };
+    static const uint32_t dstColors[] = {
+        0xff0000ff, 0xff204060, 0x80ffffff,
+    };
+    static const int globalAlphas[] = { 255, 128, 64 };
+    const int ns = sizeof(srcColors) / sizeof(srcColors[0]);
+    const int nd = sizeof(dstColors) / sizeof(dstColors[0]);
+
+    image src, dst;
+    alloc_image(&src, ns, 1, 0);
+    alloc_image(&dst, ns, nd, 0);
+    memcpy(src.pixels, srcColors, sizeof(srcColors));
+    uint32 srcId = create_rgb(&src, C2D_SOURCE);
+    uint32 dstId = create_rgb(&dst, C2D_TARGET);
+
+    for (int g = 0; g < 3; g++) {
+        for (int y = 0; y < nd; y++)
+            for (int x = 0; x < ns; x++)
+                dst.pixels[y * dst.stride + x] = dstColors[y];
+
+        // One object per row, drawn as one list
+        C2D_OBJECT objs[3];
+        for (int y = 0; y < nd; y++) {
+            init_object(&objs[y], srcId);
+            objs[y].config_mask = C2D_TARGET_RECT_BIT | C2D_GLOBAL_ALPHA_BIT;
+            objs[y].global_alpha = globalAlphas[g];
+            set_rect(&objs[y].target_rect, 0, y, ns, 1);
+            if (y + 1 < nd)
+                objs[y].next = &objs[y + 1];
+        }
+        check_status("blend", blit(dstId, 0, objs, nd), C2D_STATUS_OK);
+
+        int bad = 0;
+        for (int y = 0; y < nd; y++) {
+            for (int x = 0; x < ns; x++) {
+                uint32_t want = blend_ref(srcColors[x], dstColors[y],
+                                          globalAlphas[g]);
+                uint32_t got = pixel(&dst, x, y);
+                // Translucent results lose precision to the premultiply
+                if (!close_to(got, want, (want >> 24) == 0xff ? 1 : 3)) {
+                    printf("FAIL blend %08x over %08x, global alpha %d: "
+                           "%08x, want %08x\n", srcColors[x], dstColors[y],
+                           globalAlphas[g], got, want);
+                    bad++;
+                }
+            }
+        }
+        sFailures += bad;
+        if (!bad)
+            printf("ok   blend, global alpha %d\n", globalAlphas[g]);
+    }
+
+    destroy(srcId);
+    destroy(dstId);
+    free(src.pixels);
+    free(dst.pixels);
+}
+
+/* BT.601 limited range to opaque ARGB */
+static uint32_t yuv_ref(int y, int u, int v)
+{
+    double c = 1.164 * (y - 16);
+    int r = clampi((int)(c + 1.596 * (v - 128) + 0.5), 0, 255);
+    int g = clampi((int)(c - 0.391 * (u - 128) - 0.813 * (v - 128) + 0.5),
+                   0, 255);
+    int b = clampi((int)(c + 2.018 * (u - 128) + 0.5), 0, 255);
+    return 0xff000000 | r << 16 | g << 8 | b;
+}
+
+static void test_yuv()
+{
+    const int w = 16, h = 8, ystride = 32, cstride = 32;
+    uint8_t *luma = (uint8_t *)malloc(ystride * h);
+    uint8_t *nv12 = (uint8_t *)malloc(cstride * h / 2);
+    uint8_t *nv21 = (uint8_t *)malloc(cstride * h / 2);
+    uint8_t *vPlane = (uint8_t *)malloc(cstride / 2 * h / 2);
+    uint8_t *uPlane = (uint8_t *)malloc(cstride / 2 * h / 2);
+    for (int i = 0; i < ystride * h; i++)
+        luma[i] = 16 + rand() % 220;
+    for (int y = 0; y < h / 2; y++) {
+        for (int x = 0; x < w / 2; x++) {
+            uint8_t u = 16 + rand() % 225, v = 16 + rand() % 225;
+            nv12[y * cstride + 2 * x] = u;
+            nv12[y * cstride + 2 * x + 1] = v;
+            nv21[y * cstride + 2 * x] = v;
+            nv21[y * cstride + 2 * x + 1] = u;
+            uPlane[y * cstride / 2 + x] = u;
+            vPlane[y * cstride / 2 + x] = v;
+        }
+    }
+
+    image dst;
+    alloc_image(&dst, w, h, 0);
+    uint32 dstId = create_rgb(&dst, C2D_TARGET);
+
+    C2D_YUV_SURFACE_DEF def;
+    memset(&def, 0, sizeof(def));
+    def.format = C2D_COLOR_FORMAT_420_NV12;
+    def.width = w;
+    def.height = h;
+    def.plane0 = luma;
+    def.stride0 = ystride;
+    def.plane1 = nv12;
+    def.stride1 = cstride;
+    uint32 srcId = 0;
+    check_status("yuv create", sw_c2dCreateSurface(&srcId, C2D_SOURCE,
+                 C2D_SURFACE_YUV_HOST, &def), C2D_STATUS_OK);
+
+    // The same pixels as NV12, NV21 and YV12, switched with update
+    static const char *names[] = { "nv12 source", "nv21 source",
+                                   "yv12 source" };
+    for (int f = 0; f < 3; f++) {
+        if (f == 1) {
+            def.format = C2D_COLOR_FORMAT_420_NV21;
+            def.plane1 = nv21;
+        } else if (f == 2) {
+            def.format = C2D_COLOR_FORMAT_420_YV12;
+            def.plane1 = vPlane;
+            def.stride1 = cstride / 2;
+            def.plane2 = uPlane;
+            def.stride2 = cstride / 2;
+        }
+        check_status("yuv update", sw_c2dUpdateSurface(srcId, C2D_SOURCE,
+                     C2D_SURFACE_YUV_HOST, &def), C2D_STATUS_OK);
+
+        C2D_OBJECT obj;
+        init_object(&obj, srcId);
+        obj.config_mask = C2D_ALPHA_BLEND_NONE;
+        check_status(names[f], blit(dstId, 0, &obj, 1), C2D_STATUS_OK);
+
+        int bad = 0;
+        for (int y = 0; y < h && !bad; y++) {
+            for (int x = 0; x < w; x++) {
+                int c = (y / 2) * cstride / 2 + x / 2;
+                uint32_t want = yuv_ref(luma[y * ystride + x], uPlane[c],
+                                        vPlane[c]);
+                if (!close_to(pixel(&dst, x, y), want, 2)) {
+                    printf("FAIL %s: (%d, %d) is %08x, want %08x\n",
+                           names[f], x, y, pixel(&dst, x, y), want);
+                    bad++;
+                    break;
+                }
+            }
+        }
+        sFailures += bad;
+        if (!bad)
+            printf("ok   %s\n", names[f]);
+    }
+
+    destroy(srcId);
+    destroy(dstId);
+    free(dst.pixels);
+    free(luma);
+    free(nv12);
+    free(nv21);
+    free(vPlane);
+    free(uPlane);
+}
+
+static void test_errors()
+{
+    image src, dst;
+    alloc_image(&src, 4, 4, 0);
+    alloc_image(&dst, 4, 4, 0);
+    uint32 srcId = create_rgb(&src, C2D_SOURCE);
+    uint32 dstId = create_rgb(&dst, C2D_TARGET);
+
+    C2D_OBJECT obj;
+    init_object(&obj, srcId);
+    obj.config_mask = C2D_COLOR_KEY_BIT;
+    check_status("color key", sw_c2dDraw(dstId, 0, NULL, 0, 0, &obj, 1),
+                 C2D_STATUS_NOT_SUPPORTED);
+    obj.config_mask = 0;
+    check_status("target mirror", sw_c2dDraw(dstId, C2D_TARGET_MIRROR_H,
+                 NULL, 0, 0, &obj, 1), C2D_STATUS_NOT_SUPPORTED);
+
+    destroy(srcId);
+    check_status("destroyed source", sw_c2dDraw(dstId, 0, NULL, 0, 0, &obj, 1),
+                 C2D_STATUS_NOT_SUPPORTED);
+    check_status("destroy twice", sw_c2dDestroySurface(srcId),
+                 C2D_STATUS_INVALID_PARAM);
+    destroy(dstId);
+
+    // Every id comes back to the pool once destroyed
+    C2D_RGB_SURFACE_DEF def;
+    rgb_def(&src, &def);
+    uint32 ids[64];
+    int created = 0;
+    C2D_STATUS status;
+    while ((status = sw_c2dCreateSurface(&ids[created], C2D_SOURCE,
+            C2D_SURFACE_RGB_HOST, &def)) == C2D_STATUS_OK && created < 63)
+        created++;
+    check_status("surface pool", status, C2D_STATUS_OUT_OF_MEMORY);
+    for (int i = 0; i < created; i++)
+        destroy(ids[i]);
+    destroy(create_rgb(&src, C2D_SOURCE));
+    printf("ok   errors, %d surfaces before the pool ran out\n", created);
+
+    free(src.pixels);
+    free(dst.pixels);
+}
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* 720p NV12 video to a portrait 480x800 panel, scaled and rotated 90 */
+static void time_video_blit()
+{
+    const int w = 1280, h = 720, frames = 20;
+    uint8_t *yuv = (uint8_t *)malloc(w * h * 3 / 2);
+    for (int i = 0; i < w * h * 3 / 2; i++)
+        yuv[i] = rand();
+    image dst;
+    alloc_image(&dst, 480, 800, 0);
+    uint32 dstId = create_rgb(&dst, C2D_TARGET);
+
+    C2D_YUV_SURFACE_DEF def;
+    memset(&def, 0, sizeof(def));
+    def.format = C2D_COLOR_FORMAT_420_NV12;
+    def.width = w;
+    def.height = h;
+    def.plane0 = yuv;
+    def.stride0 = w;
+    def.plane1 = yuv + w * h;
+    def.stride1 = w;
+    uint32 srcId = 0;
+    sw_c2dCreateSurface(&srcId, C2D_SOURCE, C2D_SURFACE_YUV_HOST, &def);
+
+    C2D_OBJECT obj;
+    init_object(&obj, srcId);
+    obj.config_mask = C2D_TARGET_RECT_BIT | C2D_ALPHA_BLEND_NONE;
+    set_rect(&obj.target_rect, 0, 0, 800, 480);
+    double start = now_ms();
+    for (int i = 0; i < frames; i++)
+        check_status("video blit", blit(dstId, C2D_TARGET_ROTATE_90, &obj, 1),
+                     C2D_STATUS_OK);
+    double ms = (now_ms() - start) / frames;
+    printf("720p nv12 -> 480x800 rotated 90: %.2f ms per frame, "
+           "%.1f Mpixel/s\n", ms, 480 * 800 / ms / 1e3);
+
+    destroy(srcId);
+    destroy(dstId);
+    free(dst.pixels);
+    free(yuv);
+}
+
+int main()
+{
+    srand(1);
+    test_copies();
+    test_rotation();
+    test_scissor();
+    test_blend();
+    test_yuv();
+    test_errors();
+    time_video_blit();
+    printf("%d failures\n", sFailures);
+    return sFailures ? 1 : 0;
+}
@@ -37,3 +37,32 @@ LOCAL_SHARED_LIBRARIES := $(common_libs) libgenlock libqdutils
 LOCAL_CFLAGS           := $(common_flags) -DLOG_TAG=\"memalloc\"
 LOCAL_SRC_FILES        :=  ionalloc.cpp alloc_controller.cpp
 include $(BUILD_SHARED_LIBRARY)
+
+# Host stress test of IonAlloc on a fake ION driver, which takes over
+# open and ioctl through the linker
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+LOCAL_MODULE           := ionalloc_stress_test
+LOCAL_MODULE_TAGS      := optional
+LOCAL_C_INCLUDES       := $(common_includes) $(kernel_includes)
+LOCAL_STATIC_LIBRARIES := liblog libcutils
+LOCAL_CFLAGS           := -DLOG_TAG=\"memalloc\" -Wno-missing-field-initializers
+LOCAL_LDFLAGS          := -Wl,--wrap=open -Wl,--wrap=ioctl
+LOCAL_LDLIBS           := -lpthread
+LOCAL_SRC_FILES        := ionalloc.cpp alloc_controller.cpp \
+                          tests/fake_ion.cpp tests/ionalloc_stress_test.cpp
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host stress test of the fb_post to HWC handoff
+include $(CLEAR_VARS)
+LOCAL_MODULE           := fb_handoff_stress_test
+LOCAL_MODULE_TAGS      := optional
+LOCAL_C_INCLUDES       := $(common_includes) $(kernel_includes) \
+                          $(LOCAL_PATH)/../libhwcomposer
+LOCAL_STATIC_LIBRARIES := liblog libcutils
+LOCAL_CFLAGS           := -DLOG_TAG=\"hwcomposer\" -Wno-missing-field-initializers
+LOCAL_LDLIBS           := -lpthread -lrt
+LOCAL_SRC_FILES        := ../libhwcomposer/hwc_fbpost.cpp \
+                          tests/fb_handoff_stress_test.cpp
+include $(BUILD_HOST_EXECUTABLE)
+endif
@@ -29,6 +29,7 @@
 
 #include <cutils/log.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include "gralloc_priv.h"
 #include "alloc_controller.h"
 #include "memalloc.h"
@@ -93,6 +94,7 @@ int IonController::allocate(alloc_data& data, int usage)
     bool noncontig = false;
 
     data.uncached = useUncached(usage);
+    data.noZeroFill = (usage & GRALLOC_USAGE_PRIVATE_NO_ZERO_FILL);
     data.allocType = 0;
 
     if(usage & GRALLOC_USAGE_PRIVATE_UI_CONTIG_HEAP)
@@ -158,8 +160,63 @@ IMemAlloc* IonController::getAllocator(int flags)
     return memalloc;
 }
 
+//-------------- Buffer release callbacks-----------------------//
+#define MAX_RELEASE_CALLBACKS 4
+
+static pthread_mutex_t sReleaseLock = PTHREAD_MUTEX_INITIALIZER;
+static buffer_release_callback sReleaseCallbacks[MAX_RELEASE_CALLBACKS];
+
+int gralloc::registerBufferReleaseCallback(buffer_release_callback cb)
+{
+    int ret = -ENOMEM;
+    pthread_mutex_lock(&sReleaseLock);
+    for (int i = 0; i < MAX_RELEASE_CALLBACKS; i++) {
+        if (sReleaseCallbacks[i] == cb) {
+            ret = 0;
+            break;
+        }
+        if (sReleaseCallbacks[i] == NULL) {
+            sReleaseCallbacks[i] = cb;
+            ret = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sReleaseLock);
+    ALOGE_IF(ret, "%s: no free callback slots", __FUNCTION__);
+    return ret;
+}
+
+void gralloc::unregisterBufferReleaseCallback(buffer_release_callback cb)
+{
+    pthread_mutex_lock(&sReleaseLock);
+    for (int i = 0; i < MAX_RELEASE_CALLBACKS; i++) {
+        if (sReleaseCallbacks[i] == cb)
+            sReleaseCallbacks[i] = NULL;
+    }
+    pthread_mutex_unlock(&sReleaseLock);
+}
+
+void gralloc::notifyBufferRelease(int fd)
+{
+    if (fd < 0)
+        return;
+    pthread_mutex_lock(&sReleaseLock);
+    for (int i = 0; i < MAX_RELEASE_CALLBACKS; i++) {
+        if (sReleaseCallbacks[i])
+            sReleaseCallbacks[i](fd);
+    }
+    pthread_mutex_unlock(&sReleaseLock);
+}
+
 size_t getBufferSizeAndDimensions(int width, int height, int format,
                                   int& alignedw, int &alignedh)
+{
+    return getBufferSizeAndDimensions(width, height, format, 0,
+                                      alignedw, alignedh);
+}
+
+size_t getBufferSizeAndDimensions(int width, int height, int format, int usage,
+                                  int& alignedw, int &alignedh)
 {
     size_t size;
 
@@ -203,6 +260,11 @@ size_t getBufferSizeAndDimensions(int width, int height, int format,
             }
             alignedw = ALIGN(width, 16);
             alignedh = height;
+            // Composer buffers may be blitted by copybit, which needs
+            // a wider stride for the semi-planar formats
+            if ((usage & GRALLOC_USAGE_HW_COMPOSER) &&
+                (format != HAL_PIXEL_FORMAT_YV12))
+                alignedw = ALIGN(width, C2D_YUV_WIDTH_ALIGN);
             if (HAL_PIXEL_FORMAT_NV12_ENCODEABLE == format) {
                 // The encoder requires a 2K aligned chroma offset.
                 size = ALIGN(alignedw*alignedh, 2048) +
@@ -243,7 +305,8 @@ int alloc_buffer(private_handle_t **pHnd, int w, int h, int format, int usage)
     data.base = 0;
     data.fd = -1;
     data.offset = 0;
-    data.size = getBufferSizeAndDimensions(w, h, format, alignedw, alignedh);
+    data.size = getBufferSizeAndDimensions(w, h, format, usage,
+                                           alignedw, alignedh);
     data.align = getpagesize();
     data.uncached = useUncached(usage);
     int allocFlags = usage;
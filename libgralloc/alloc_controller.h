@@ -67,5 +67,24 @@ class IonController : public IAllocController {
     IonAlloc* mIonAlloc;
 
 };
+
+/* Modules that keep per-buffer state keyed on the buffer fd (such as GPU
+ * mappings) register a callback here. It is invoked with the fd just
+ * before the buffer is freed or unregistered in this process, while the
+ * fd is still valid.
+ *
+ * Callbacks run with the registry lock held, so once unregister returns
+ * the callback is not running and will not run again. For the same
+ * reason, do not register or unregister while holding a lock that the
+ * callback takes.
+ */
+typedef void (*buffer_release_callback)(int fd);
+
+int registerBufferReleaseCallback(buffer_release_callback cb);
+
+void unregisterBufferReleaseCallback(buffer_release_callback cb);
+
+void notifyBufferRelease(int fd);
+
 } //end namespace gralloc
 #endif // GRALLOC_ALLOCCONTROLLER_H
@@ -18,6 +18,13 @@
 #ifndef FB_PRIV_H
 #define FB_PRIV_H
 #include <linux/fb.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <cutils/atomic.h>
 
 #define NUM_FRAMEBUFFERS_MIN  2
 #define NUM_FRAMEBUFFERS_MAX  3
@@ -34,6 +41,101 @@ enum {
     PRIV_MAX_SWAP_INTERVAL = 1,
 };
 
+#define FB_POST_SLOTS 4
+
+//A frame handed to fb_post, as seen by the waiters in HWC
+struct fb_post_info {
+    uint32_t offset;
+    int64_t timestamp;
+};
+
+/* Handoff from fb_post to the HWC composition thread. fb_post fills slot
+ * postSeq + 1 and then publishes that number in postSeq, and again in
+ * panSeq once the pan is done. Waiters keep the last sequence they
+ * consumed, so posts that arrive back to back are neither lost nor seen
+ * twice. They only sleep, on a futex on the counter, when there is
+ * nothing new, and only then does fb_post pay for a wake up.
+ */
+struct fb_handoff_t {
+    volatile int32_t postSeq;
+    volatile int32_t panSeq;
+    volatile int32_t waiters;
+    fb_post_info posts[FB_POST_SLOTS];
+};
+
+static inline void fb_handoff_publish(fb_handoff_t* h, volatile int32_t* seq,
+                                      int32_t value)
+{
+    android_atomic_release_store(value, seq);
+    // Orders the store above against the load of waiters, pairs with the
+    // increment in fb_handoff_wait
+    android_memory_barrier();
+    if (h->waiters)
+        syscall(__NR_futex, seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Fills the next slot and publishes it in postSeq, returns its sequence.
+// Only one thread may post at a time.
+static inline int32_t fb_handoff_post(fb_handoff_t* h, uint32_t offset,
+                                      int64_t timestamp)
+{
+    int32_t seq = h->postSeq + 1;
+    fb_post_info* post = &h->posts[(uint32_t)seq % FB_POST_SLOTS];
+    post->offset = offset;
+    post->timestamp = timestamp;
+    fb_handoff_publish(h, &h->postSeq, seq);
+    return seq;
+}
+
+// Waits up to timeoutMs for *seq to reach target, returns false on timeout
+static inline bool fb_handoff_wait(fb_handoff_t* h, volatile int32_t* seq,
+                                   int32_t target, int timeoutMs)
+{
+    struct timespec end, now, left;
+    int32_t cur = android_atomic_acquire_load(seq);
+    if ((int32_t)(cur - target) >= 0)
+        return true;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += timeoutMs / 1000;
+    end.tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (end.tv_nsec >= 1000000000L) {
+        end.tv_sec++;
+        end.tv_nsec -= 1000000000L;
+    }
+
+    bool done = false;
+    android_atomic_inc(&h->waiters);
+    while (true) {
+        cur = android_atomic_acquire_load(seq);
+        if ((int32_t)(cur - target) >= 0) {
+            done = true;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = end.tv_sec - now.tv_sec;
+        left.tv_nsec = end.tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000L;
+        }
+        if (left.tv_sec < 0)
+            break;
+        // Returns right away if *seq moved on since it was read
+        syscall(__NR_futex, seq, FUTEX_WAIT, cur, &left, NULL, 0);
+    }
+    android_atomic_dec(&h->waiters);
+    return done;
+}
+
+//Flip queue depth changes, see framebuffer.cpp
+struct fb_flip_stats {
+    uint32_t grows;
+    uint32_t shrinks;
+    //Pans that came later than one and a half refresh periods
+    uint32_t misses;
+};
+
 struct private_module_t {
     gralloc_module_t base;
     struct private_handle_t* framebuffer;
@@ -50,13 +152,12 @@ struct private_module_t {
     float fps;
     uint32_t swapInterval;
     uint32_t currentOffset;
-    bool fbPostDone;
-    pthread_mutex_t fbPostLock;
-    //Condition to inform HWC that fb_post called
-    pthread_cond_t fbPostCond;
-    bool fbPanDone;
-    pthread_mutex_t fbPanLock;
-    pthread_cond_t fbPanCond;
+    //Informs HWC that fb_post was called and that its pan is done
+    fb_handoff_t handoff;
+    //Posts fb_post may queue ahead of the screen, 0 when it pans itself.
+    //Changes at runtime between 1 and numBuffers - 1.
+    volatile uint32_t flipQueueDepth;
+    fb_flip_stats flipStats;
 };
 
 
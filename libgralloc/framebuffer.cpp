@@ -16,6 +16,8 @@
  */
 
 #include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
 
 #include <cutils/log.h>
 #include <cutils/properties.h>
@@ -30,6 +32,7 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <cutils/atomic.h>
+#include <utils/Timers.h>
 
 #include <linux/fb.h>
 #include <linux/msm_mdp.h>
@@ -43,6 +46,8 @@
 #include <cutils/properties.h>
 #include <profiler.h>
 
+#define FLIP_DEBUG 0
+
 #define EVEN_OUT(x) if (x & 0x0001) {x--;}
 /** min of int a, b */
 static inline int min(int a, int b) {
@@ -98,6 +103,214 @@ static int fb_setUpdateRect(struct framebuffer_device_t* dev,
     return 0;
 }
 
+/* Pans to hnd and makes it the current buffer. Called from fb_post, or
+ * from the flip thread when the flip queue is on.
+ */
+static int fb_pan(private_module_t* m, private_handle_t* hnd, int32_t seq,
+                  struct fb_var_screeninfo* info)
+{
+    fb_handoff_t* h = &m->handoff;
+    info->activate = FB_ACTIVATE_VBL;
+    info->yoffset = (hnd->base - m->framebuffer->base) / m->finfo.line_length;
+    if (ioctl(m->framebuffer->fd, FBIOPUT_VSCREENINFO, info) == -1) {
+        int err = -errno;
+        ALOGE("FBIOPUT_VSCREENINFO failed");
+        // Do not leave the composition thread waiting for this pan
+        fb_handoff_publish(h, &h->panSeq, seq);
+        genlock_unlock_buffer(hnd);
+        return err;
+    }
+
+    //Signals the composition thread to unblock and loop over if necessary
+    fb_handoff_publish(h, &h->panSeq, seq);
+
+    if (m->currentBuffer) {
+        genlock_unlock_buffer(m->currentBuffer);
+        m->currentBuffer = 0;
+    }
+
+    CALC_FPS();
+    m->currentBuffer = hnd;
+    return 0;
+}
+
+/*****************************************************************************/
+
+/* Flip queue. With debug.gr.asyncflip set, fb_post only queues the buffer
+ * and returns, and a flip thread does the pan and its vblank wait. That
+ * lets composition of the next frame overlap the wait. Queued buffers stay
+ * read locked by genlock until they are replaced on screen, like posted
+ * ones, and the queue holds at most one buffer less than there are.
+ *
+ * The depth adapts: it starts at 1 (double buffering), grows to the
+ * maximum (triple buffering with 3 framebuffers) when pans start missing
+ * vsyncs and shrinks back after a long run without misses or when posting
+ * goes idle. All framebuffers stay allocated to SurfaceFlinger, so
+ * bufferMask is not touched; only how far fb_post may run ahead changes.
+ */
+// Misses within the window that make the queue grow
+#define FLIP_GROW_MISSES   2
+#define FLIP_GROW_WINDOW   60
+// Pans without a miss after which the queue shrinks
+#define FLIP_SHRINK_FRAMES 300
+// A gap between posts this long counts as idle
+#define FLIP_IDLE_NS       500000000LL
+struct flip_request_t {
+    private_handle_t* hnd;
+    int32_t seq;
+    // Snapshot at post time, fb_setUpdateRect writes m->info
+    struct fb_var_screeninfo info;
+};
+
+struct flip_queue_t {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    flip_request_t requests[NUM_FRAMEBUFFERS_MAX];
+    int head;
+    int count;
+    int depth;
+    int maxDepth;
+    bool running;
+    pthread_t thread;
+    // Depth policy state
+    nsecs_t period;
+    nsecs_t lastPost;
+    nsecs_t lastPan;
+    int windowFrames;
+    int windowMisses;
+    int cleanFrames;
+};
+
+static flip_queue_t sFlipQueue = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+};
+
+static void fb_set_flip_depth(private_module_t* m, flip_queue_t* q,
+                              int depth)
+{
+    if (depth == q->depth)
+        return;
+    if (depth > q->depth)
+        m->flipStats.grows++;
+    else
+        m->flipStats.shrinks++;
+    ALOGD_IF(FLIP_DEBUG, "%s: flip queue depth %d -> %d", __FUNCTION__,
+             q->depth, depth);
+    q->depth = depth;
+    q->windowFrames = 0;
+    q->windowMisses = 0;
+    q->cleanFrames = 0;
+    m->flipQueueDepth = depth;
+}
+
+/* Called by the flip thread after each pan with q->lock held. A pan that
+ * comes more than 1.5 periods after the previous one missed a vsync, unless
+ * the gap is long enough to be a pause in posting.
+ */
+static void fb_flip_policy(private_module_t* m, flip_queue_t* q, nsecs_t now)
+{
+    nsecs_t interval = q->lastPan ? now - q->lastPan : 0;
+    q->lastPan = now;
+    if (!interval || interval > 4 * q->period)
+        return;
+
+    bool missed = interval * 2 > q->period * 3;
+    if (missed)
+        m->flipStats.misses++;
+
+    q->windowFrames++;
+    if (missed) {
+        q->windowMisses++;
+        q->cleanFrames = 0;
+    } else {
+        q->cleanFrames++;
+    }
+
+    if (q->depth < q->maxDepth && q->windowMisses >= FLIP_GROW_MISSES) {
+        fb_set_flip_depth(m, q, q->maxDepth);
+    } else if (q->depth > 1 && q->cleanFrames >= FLIP_SHRINK_FRAMES) {
+        fb_set_flip_depth(m, q, 1);
+    } else if (q->windowFrames >= FLIP_GROW_WINDOW) {
+        q->windowFrames = 0;
+        q->windowMisses = 0;
+    }
+}
+
+static void* fb_flip_thread(void* param)
+{
+    private_module_t* m = reinterpret_cast<private_module_t*>(param);
+    flip_queue_t* q = &sFlipQueue;
+    prctl(PR_SET_NAME, (unsigned long) "fbFlipThread", 0, 0, 0);
+    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+
+    while (true) {
+        pthread_mutex_lock(&q->lock);
+        while (q->count == 0)
+            pthread_cond_wait(&q->cond, &q->lock);
+        // Keep the request queued until its pan is done, so that fb_post
+        // does not run more than depth buffers ahead of the screen
+        flip_request_t* req = &q->requests[q->head];
+        pthread_mutex_unlock(&q->lock);
+
+        fb_pan(m, req->hnd, req->seq, &req->info);
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        pthread_mutex_lock(&q->lock);
+        fb_flip_policy(m, q, now);
+        q->head = (q->head + 1) % NUM_FRAMEBUFFERS_MAX;
+        q->count--;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->lock);
+    }
+    return NULL;
+}
+
+static void fb_start_flip_thread(private_module_t* m)
+{
+    flip_queue_t* q = &sFlipQueue;
+    char property[PROPERTY_VALUE_MAX];
+    if (property_get("debug.gr.asyncflip", property, NULL) <= 0 ||
+        atoi(property) == 0)
+        return;
+    if (!(m->flags & PAGE_FLIP) || m->numBuffers < 2) {
+        ALOGW("%s: no page flipping, async flip not used", __FUNCTION__);
+        return;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    if (!q->running) {
+        q->maxDepth = min(m->numBuffers - 1, NUM_FRAMEBUFFERS_MAX);
+        q->depth = 1;
+        q->head = 0;
+        q->count = 0;
+        q->period = 1000000000LL / (m->fps > 0 ? (nsecs_t)m->fps : 60);
+        q->lastPost = 0;
+        q->lastPan = 0;
+        q->windowFrames = 0;
+        q->windowMisses = 0;
+        q->cleanFrames = 0;
+        if (pthread_create(&q->thread, NULL, fb_flip_thread, m) == 0) {
+            q->running = true;
+            m->flipQueueDepth = q->depth;
+            ALOGD("%s: async flip on, depth 1 to %d", __FUNCTION__,
+                  q->maxDepth);
+        } else {
+            ALOGE("%s: could not start the flip thread", __FUNCTION__);
+        }
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Waits until every queued buffer is on screen
+static void fb_drain_flip_queue()
+{
+    flip_queue_t* q = &sFlipQueue;
+    pthread_mutex_lock(&q->lock);
+    while (q->count)
+        pthread_cond_wait(&q->cond, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+}
+
 static int fb_post(struct framebuffer_device_t* dev, buffer_handle_t buffer)
 {
     if (private_handle_t::validate(buffer) < 0)
@@ -117,34 +330,34 @@ static int fb_post(struct framebuffer_device_t* dev, buffer_handle_t buffer)
 
         const size_t offset = hnd->base - m->framebuffer->base;
         // frame ready to be posted, signal so that hwc can update External
-        // display
-        pthread_mutex_lock(&m->fbPostLock);
+        // display. fb_post is the only writer of the handoff.
+        fb_handoff_t* h = &m->handoff;
         m->currentOffset = offset;
-        m->fbPostDone = true;
-        pthread_cond_signal(&m->fbPostCond);
-        pthread_mutex_unlock(&m->fbPostLock);
-
-        m->info.activate = FB_ACTIVATE_VBL;
-        m->info.yoffset = offset / m->finfo.line_length;
-        if (ioctl(m->framebuffer->fd, FBIOPUT_VSCREENINFO, &m->info) == -1) {
-            ALOGE("FBIOPUT_VSCREENINFO failed");
-            genlock_unlock_buffer(hnd);
-            return -errno;
-        }
-
-        //Signals the composition thread to unblock and loop over if necessary
-        pthread_mutex_lock(&m->fbPanLock);
-        m->fbPanDone = true;
-        pthread_cond_signal(&m->fbPanCond);
-        pthread_mutex_unlock(&m->fbPanLock);
-
-        if (m->currentBuffer) {
-            genlock_unlock_buffer(m->currentBuffer);
-            m->currentBuffer = 0;
+        int32_t seq = fb_handoff_post(h, offset,
+                                      systemTime(SYSTEM_TIME_MONOTONIC));
+
+        flip_queue_t* q = &sFlipQueue;
+        if (!m->flipQueueDepth)
+            return fb_pan(m, hnd, seq, &m->info);
+
+        pthread_mutex_lock(&q->lock);
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (q->lastPost && now - q->lastPost > FLIP_IDLE_NS) {
+            // Posting resumes after a pause, start from double buffering
+            fb_set_flip_depth(m, q, 1);
+            q->lastPan = 0;
         }
-
-        CALC_FPS();
-        m->currentBuffer = hnd;
+        q->lastPost = now;
+        while (q->count >= q->depth)
+            pthread_cond_wait(&q->cond, &q->lock);
+        flip_request_t* req =
+            &q->requests[(q->head + q->count) % NUM_FRAMEBUFFERS_MAX];
+        req->hnd = hnd;
+        req->seq = seq;
+        req->info = m->info;
+        q->count++;
+        pthread_cond_broadcast(&q->cond);
+        pthread_mutex_unlock(&q->lock);
     }
     return 0;
 }
@@ -369,12 +582,9 @@ int mapFrameBufferLocked(struct private_module_t* module)
     module->framebuffer->base = intptr_t(vaddr);
     memset(vaddr, 0, fbSize);
     module->currentOffset = 0;
-    module->fbPostDone = false;
-    pthread_mutex_init(&(module->fbPostLock), NULL);
-    pthread_cond_init(&(module->fbPostCond), NULL);
-    module->fbPanDone = false;
-    pthread_mutex_init(&(module->fbPanLock), NULL);
-    pthread_cond_init(&(module->fbPanCond), NULL);
+    memset(&module->handoff, 0, sizeof(module->handoff));
+    module->flipQueueDepth = 0;
+    memset(&module->flipStats, 0, sizeof(module->flipStats));
     return 0;
 }
 
@@ -392,6 +602,7 @@ static int fb_close(struct hw_device_t *dev)
 {
     fb_context_t* ctx = (fb_context_t*)dev;
     if (ctx) {
+        fb_drain_flip_queue();
         free(ctx);
     }
     return 0;
@@ -444,6 +655,7 @@ int fb_device_open(hw_module_t const* module, const char* name,
                 ALOGD("UPDATE_ON_DEMAND supported");
             }
 
+            fb_start_flip_thread(m);
             *device = &dev->device.common;
         }
 
@@ -207,11 +207,16 @@ int gpu_context_t::alloc_impl(int w, int h, int format, int usage,
     if (!pHandle || !pStride)
         return -EINVAL;
 
+    // Client buffers may be read before they are written, never hand out
+    // memory with a previous owner's content
+    usage &= ~GRALLOC_USAGE_PRIVATE_NO_ZERO_FILL;
+
     size_t size;
     int alignedw, alignedh;
     int colorFormat, bufferType;
     getGrallocInformationFromFormat(format, &colorFormat, &bufferType);
-    size = getBufferSizeAndDimensions(w, h, colorFormat, alignedw, alignedh);
+    size = getBufferSizeAndDimensions(w, h, colorFormat, usage,
+                                      alignedw, alignedh);
 
     if ((ssize_t)size <= 0)
         return -EINVAL;
@@ -50,8 +50,15 @@ inline size_t ALIGN(size_t x, size_t align) {
 
 int mapFrameBufferLocked(struct private_module_t* module);
 int terminateBuffer(gralloc_module_t const* module, private_handle_t* hnd);
+/* Width alignment at which the C2D blitter (copybit) reads and writes
+ * semi-planar YUV in place. Buffers allocated with GRALLOC_USAGE_HW_COMPOSER
+ * use it as their stride, so copybit needs no aligned temporary copy. */
+#define C2D_YUV_WIDTH_ALIGN 32
+
 size_t getBufferSizeAndDimensions(int width, int height, int format,
                                   int& alignedw, int &alignedh);
+size_t getBufferSizeAndDimensions(int width, int height, int format, int usage,
+                                  int& alignedw, int &alignedh);
 
 int decideBufferHandlingMechanism(int format, const char *compositionUsed,
                                   int hasBlitEngine, int *needConversion,
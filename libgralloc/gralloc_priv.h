@@ -80,6 +80,13 @@ enum {
      */
     GRALLOC_USAGE_PRIVATE_CP_BUFFER       =       0x00400000,
 
+    /* The caller overwrites the whole buffer before anything reads it,
+     * so it is not zero filled at allocation. Only honoured for buffers
+     * allocated and consumed inside the display HALs, gralloc clients
+     * always get zeroed memory.
+     */
+    GRALLOC_USAGE_PRIVATE_NO_ZERO_FILL    =       0x00800000,
+
     /* Legacy heaps - these heaps are no-ops so we are making them zero
      * The flags need to be around to compile certain HALs which have
      * not cleaned up the code
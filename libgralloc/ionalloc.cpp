@@ -36,13 +36,43 @@
 #include <errno.h>
 #include "gralloc_priv.h"
 #include "ionalloc.h"
+#include "alloc_controller.h"
 
 using gralloc::IonAlloc;
 
 #define ION_DEVICE "/dev/ion"
 
+IonAlloc* IonAlloc::sInstance = NULL;
+
+IonAlloc::IonAlloc() : mIonFd(FD_INIT), mHandleUse(0)
+{
+    for (int i = 0; i < MAX_ION_HANDLES; i++) {
+        mHandles[i].fd = FD_INIT;
+        mHandles[i].handle = NULL;
+        mHandles[i].lastUse = 0;
+        mHandles[i].refs = 0;
+    }
+    // Imported handles have to be dropped before their fd is closed,
+    // which happens in free_buffer and in gralloc_unregister_buffer.
+    sInstance = this;
+    registerBufferReleaseCallback(handle_release_callback);
+}
+
+IonAlloc::~IonAlloc()
+{
+    unregisterBufferReleaseCallback(handle_release_callback);
+    if (sInstance == this)
+        sInstance = NULL;
+    release_all_handles();
+    close_device();
+}
+
+// Only the shared ion fd is guarded by mLock. The ION driver serializes
+// per client internally, so allocations, mappings and cache maintenance
+// from different threads run in parallel.
 int IonAlloc::open_device()
 {
+    Locker::Autolock _l(mLock);
     if(mIonFd == FD_INIT)
         mIonFd = open(ION_DEVICE, O_RDONLY);
 
@@ -64,7 +94,6 @@ void IonAlloc::close_device()
 
 int IonAlloc::alloc_buffer(alloc_data& data)
 {
-    Locker::Autolock _l(mLock);
     int err = 0;
     int ionSyncFd = FD_INIT;
     int iFd = FD_INIT;
@@ -126,12 +155,21 @@ int IonAlloc::alloc_buffer(alloc_data& data)
             ALOGE("%s: Failed to map the allocated memory: %s",
                   __FUNCTION__, strerror(errno));
             ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+            close(fd_data.fd);
+            if(ionSyncFd >= 0)
+                close(ionSyncFd);
             ionSyncFd = FD_INIT;
             return err;
         }
-        memset(base, 0, ionAllocData.len);
-        // Clean cache after memset
-        clean_buffer(base, data.size, data.offset, fd_data.fd);
+        if(!data.noZeroFill) {
+            memset(base, 0, ionAllocData.len);
+            // Clean cache after memset
+            clean_buffer(base, data.size, data.offset, fd_data.fd);
+        } else if(!data.uncached) {
+            // Nothing was written, but stale lines must not be written
+            // back over what the producer puts in the buffer
+            clean_buffer(base, data.size, data.offset, fd_data.fd);
+        }
     }
 
     //Close the uncached FD since we no longer need it;
@@ -150,7 +188,6 @@ int IonAlloc::alloc_buffer(alloc_data& data)
 
 int IonAlloc::free_buffer(void* base, size_t size, int offset, int fd)
 {
-    Locker::Autolock _l(mLock);
     ALOGD_IF(DEBUG, "ion: Freeing buffer base:%p size:%d fd:%d",
           base, size, fd);
     int err = 0;
@@ -160,6 +197,7 @@ int IonAlloc::free_buffer(void* base, size_t size, int offset, int fd)
 
     if(base)
         err = unmap_buffer(base, size, offset);
+    notifyBufferRelease(fd);
     close(fd);
     return err;
 }
@@ -203,36 +241,162 @@ int IonAlloc::unmap_buffer(void *base, size_t size, int offset)
 int IonAlloc::clean_buffer(void *base, size_t size, int offset, int fd)
 {
     struct ion_flush_data flush_data;
-    struct ion_fd_data fd_data;
-    struct ion_handle_data handle_data;
     struct ion_handle* handle;
+    int slot;
     int err = 0;
 
     err = open_device();
     if (err)
         return err;
 
+    for (int attempt = 0; attempt < 2; attempt++) {
+        err = get_handle(fd, &handle, &slot);
+        if (err)
+            return err;
+
+        flush_data.handle  = handle;
+        flush_data.vaddr   = base;
+        flush_data.offset  = offset;
+        flush_data.length  = size;
+        if(!ioctl(mIonFd, ION_IOC_CLEAN_INV_CACHES, &flush_data)) {
+            put_handle(slot, handle, false);
+            return 0;
+        }
+
+        err = -errno;
+        // The cached handle may be stale if the fd was closed and reused
+        // without going through free/unregister, import it again once.
+        put_handle(slot, handle, true);
+    }
+    ALOGE("%s: ION_IOC_CLEAN_INV_CACHES failed with error - %s",
+          __FUNCTION__, strerror(-err));
+    return err;
+}
+
+int IonAlloc::get_handle(int fd, struct ion_handle** handle, int* slot)
+{
+    mHandleLock.lock();
+    for (int i = 0; i < MAX_ION_HANDLES; i++) {
+        if (mHandles[i].fd == fd) {
+            mHandles[i].lastUse = ++mHandleUse;
+            mHandles[i].refs++;
+            *handle = mHandles[i].handle;
+            *slot = i;
+            mHandleLock.unlock();
+            return 0;
+        }
+    }
+    mHandleLock.unlock();
+
+    // Import without holding the lock, a racing import of the same fd
+    // is resolved below
+    struct ion_fd_data fd_data;
     fd_data.fd = fd;
     if (ioctl(mIonFd, ION_IOC_IMPORT, &fd_data)) {
-        err = -errno;
+        int err = -errno;
         ALOGE("%s: ION_IOC_IMPORT failed with error - %s",
               __FUNCTION__, strerror(errno));
         return err;
     }
 
-    handle_data.handle = fd_data.handle;
-    flush_data.handle  = fd_data.handle;
-    flush_data.vaddr   = base;
-    flush_data.offset  = offset;
-    flush_data.length  = size;
-    if(ioctl(mIonFd, ION_IOC_CLEAN_INV_CACHES, &flush_data)) {
-        err = -errno;
-        ALOGE("%s: ION_IOC_CLEAN_INV_CACHES failed with error - %s",
-              __FUNCTION__, strerror(errno));
-        ioctl(mIonFd, ION_IOC_FREE, &handle_data);
-        return err;
+    struct ion_handle_data handle_data;
+    Locker::Autolock _l(mHandleLock);
+    int victim = -1;
+    for (int i = 0; i < MAX_ION_HANDLES; i++) {
+        if (mHandles[i].fd == fd) {
+            // Importing an fd twice returns the same handle with another
+            // reference, drop ours
+            handle_data.handle = fd_data.handle;
+            ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+            mHandles[i].lastUse = ++mHandleUse;
+            mHandles[i].refs++;
+            *handle = mHandles[i].handle;
+            *slot = i;
+            return 0;
+        }
+        // Entries in use are never evicted, prefer empty slots, then LRU
+        if (mHandles[i].refs)
+            continue;
+        if (victim < 0 ||
+            (mHandles[victim].fd != FD_INIT &&
+             (mHandles[i].fd == FD_INIT ||
+              mHandles[i].lastUse < mHandles[victim].lastUse)))
+            victim = i;
     }
-    ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+
+    *handle = fd_data.handle;
+    if (victim < 0) {
+        // Every slot is busy flushing, the caller frees this one
+        *slot = -1;
+        return 0;
+    }
+    if (mHandles[victim].fd != FD_INIT)
+        free_handle_locked(victim);
+    mHandles[victim].fd = fd;
+    mHandles[victim].handle = fd_data.handle;
+    mHandles[victim].lastUse = ++mHandleUse;
+    mHandles[victim].refs = 1;
+    ALOGD_IF(DEBUG, "ion: Imported handle %p for fd:%d in slot %d",
+             fd_data.handle, fd, victim);
+    *slot = victim;
     return 0;
 }
 
+void IonAlloc::put_handle(int slot, struct ion_handle* handle, bool stale)
+{
+    Locker::Autolock _l(mHandleLock);
+    if (slot < 0) {
+        struct ion_handle_data handle_data;
+        handle_data.handle = handle;
+        ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+        return;
+    }
+    ion_handle_entry& entry = mHandles[slot];
+    // A stale handle is unhooked from its fd so the next lookup imports
+    // again. Our reference keeps the slot from being reused meanwhile.
+    if (stale)
+        entry.fd = FD_INIT;
+    if (--entry.refs == 0 && entry.fd == FD_INIT)
+        free_handle_locked(slot);
+}
+
+void IonAlloc::free_handle_locked(int slot)
+{
+    struct ion_handle_data handle_data;
+    handle_data.handle = mHandles[slot].handle;
+    if (mIonFd >= 0)
+        ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+    mHandles[slot].fd = FD_INIT;
+    mHandles[slot].handle = NULL;
+    mHandles[slot].refs = 0;
+}
+
+void IonAlloc::release_handle(int fd)
+{
+    Locker::Autolock _l(mHandleLock);
+    for (int i = 0; i < MAX_ION_HANDLES; i++) {
+        if (mHandles[i].fd == fd) {
+            // A flush in progress keeps the handle until put_handle
+            if (mHandles[i].refs)
+                mHandles[i].fd = FD_INIT;
+            else
+                free_handle_locked(i);
+            break;
+        }
+    }
+}
+
+void IonAlloc::release_all_handles()
+{
+    Locker::Autolock _l(mHandleLock);
+    for (int i = 0; i < MAX_ION_HANDLES; i++) {
+        if (mHandles[i].handle)
+            free_handle_locked(i);
+    }
+}
+
+void IonAlloc::handle_release_callback(int fd)
+{
+    if (sInstance)
+        sInstance->release_handle(fd);
+}
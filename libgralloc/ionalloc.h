@@ -53,9 +53,9 @@ class IonAlloc : public IMemAlloc  {
     virtual int clean_buffer(void*base, size_t size,
                              int offset, int fd);
 
-    IonAlloc() { mIonFd = FD_INIT; }
+    IonAlloc();
 
-    ~IonAlloc() { close_device(); }
+    ~IonAlloc();
 
     private:
     int mIonFd;
@@ -66,6 +66,42 @@ class IonAlloc : public IMemAlloc  {
 
     mutable Locker mLock;
 
+    // ION handles imported for cache maintenance, keyed on the buffer fd.
+    // An entry lives until the fd is freed or unregistered (see
+    // notifyBufferRelease), or until it is evicted by a newer one.
+    // Flushes run without mHandleLock, so each entry counts the flushes
+    // using its handle. An entry released while in use is unhooked from
+    // its fd and the last user frees the handle.
+    enum { MAX_ION_HANDLES = 32 };
+
+    struct ion_handle_entry {
+        int fd;
+        struct ion_handle* handle;
+        unsigned int lastUse;
+        int refs;
+    };
+
+    ion_handle_entry mHandles[MAX_ION_HANDLES];
+    unsigned int mHandleUse;
+    Locker mHandleLock;
+
+    // Looks up or imports the handle for fd and takes a reference on it.
+    // slot is -1 if the handle could not be cached. Give it back with
+    // put_handle, with stale set if the handle did not work.
+    int get_handle(int fd, struct ion_handle** handle, int* slot);
+
+    void put_handle(int slot, struct ion_handle* handle, bool stale);
+
+    void free_handle_locked(int slot);
+
+    void release_handle(int fd);
+
+    void release_all_handles();
+
+    static void handle_release_callback(int fd);
+
+    static IonAlloc* sInstance;
+
 };
 
 }
@@ -139,6 +139,145 @@ static pthread_mutex_t sMapLock = PTHREAD_MUTEX_INITIALIZER;
 
 /*****************************************************************************/
 
+/*
+ * Region of a buffer written by the CPU since it was marked for flushing.
+ * Locks taken before the next unlock are merged into one bounding
+ * rectangle, and only that rectangle is cleaned on unlock. Buffers
+ * without an entry (no free slot, YUV formats) get cleaned whole.
+ */
+#define MAX_LOCK_REGIONS 16
+// Narrow regions are cleaned line by line up to this many lines
+#define MAX_LINE_CLEANS  16
+
+struct lock_region {
+    private_handle_t const* hnd;
+    bool whole;
+    int l, t, r, b;
+};
+
+static pthread_mutex_t sLockRegionLock = PTHREAD_MUTEX_INITIALIZER;
+static lock_region sLockRegions[MAX_LOCK_REGIONS];
+
+static int getBytesPerPixel(int format)
+{
+    switch (format) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            return 4;
+        case HAL_PIXEL_FORMAT_RGB_888:
+            return 3;
+        case HAL_PIXEL_FORMAT_RGB_565:
+        case HAL_PIXEL_FORMAT_RGBA_5551:
+        case HAL_PIXEL_FORMAT_RGBA_4444:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static void addLockRegion(private_handle_t const* hnd,
+                          int l, int t, int w, int h)
+{
+    int bpp = getBytesPerPixel(hnd->format);
+    bool whole = !bpp || l < 0 || t < 0 || w <= 0 || h <= 0 ||
+            l + w > hnd->width || t + h > hnd->height ||
+            (t + h) * hnd->width * bpp > hnd->size;
+
+    pthread_mutex_lock(&sLockRegionLock);
+    int slot = -1;
+    for (int i = 0; i < MAX_LOCK_REGIONS; i++) {
+        if (sLockRegions[i].hnd == hnd) {
+            lock_region& reg = sLockRegions[i];
+            reg.whole = reg.whole || whole;
+            if (!reg.whole) {
+                if (l < reg.l) reg.l = l;
+                if (t < reg.t) reg.t = t;
+                if (l + w > reg.r) reg.r = l + w;
+                if (t + h > reg.b) reg.b = t + h;
+            }
+            pthread_mutex_unlock(&sLockRegionLock);
+            return;
+        }
+        if (slot < 0 && sLockRegions[i].hnd == NULL)
+            slot = i;
+    }
+    if (slot >= 0) {
+        lock_region& reg = sLockRegions[slot];
+        reg.hnd = hnd;
+        reg.whole = whole;
+        reg.l = l;
+        reg.t = t;
+        reg.r = l + w;
+        reg.b = t + h;
+    }
+    pthread_mutex_unlock(&sLockRegionLock);
+}
+
+// Returns the region to clean and forgets it
+static lock_region takeLockRegion(private_handle_t const* hnd)
+{
+    lock_region ret;
+    ret.hnd = hnd;
+    ret.whole = true;
+    pthread_mutex_lock(&sLockRegionLock);
+    for (int i = 0; i < MAX_LOCK_REGIONS; i++) {
+        if (sLockRegions[i].hnd == hnd) {
+            ret = sLockRegions[i];
+            sLockRegions[i].hnd = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLockRegionLock);
+    return ret;
+}
+
+static void dropLockRegion(private_handle_t const* hnd)
+{
+    takeLockRegion(hnd);
+}
+
+static int cleanRange(IMemAlloc* memalloc, private_handle_t const* hnd,
+                      int start, int len)
+{
+    int err = memalloc->clean_buffer((void*)(hnd->base + start), len,
+                                     hnd->offset + start, hnd->fd);
+    ALOGE_IF(err < 0, "cannot flush handle %p (offs=%x len=%x, flags = 0x%x) err=%s\n",
+             hnd, hnd->offset + start, len, hnd->flags, strerror(errno));
+    return err;
+}
+
+/*
+ * Clean the part of the buffer written since lock. A region much narrower
+ * than the stride is cleaned line by line as long as that stays a handful
+ * of ioctls, otherwise the span from its first to its last byte is.
+ */
+static int cleanLockRegion(IMemAlloc* memalloc, private_handle_t const* hnd)
+{
+    lock_region reg = takeLockRegion(hnd);
+    if (reg.whole)
+        return cleanRange(memalloc, hnd, 0, hnd->size);
+
+    int bpp = getBytesPerPixel(hnd->format);
+    int stride = hnd->width * bpp;
+    int lineLen = (reg.r - reg.l) * bpp;
+    int lines = reg.b - reg.t;
+    int start = reg.t * stride + reg.l * bpp;
+
+    if (lines > 1 && lines <= MAX_LINE_CLEANS && lineLen * 2 <= stride) {
+        int err = 0;
+        for (int i = 0; i < lines; i++) {
+            int ret = cleanRange(memalloc, hnd, start + i * stride, lineLen);
+            if (ret)
+                err = ret;
+        }
+        return err;
+    }
+    return cleanRange(memalloc, hnd, start, (lines - 1) * stride + lineLen);
+}
+
+/*****************************************************************************/
+
 int gralloc_register_buffer(gralloc_module_t const* module,
                             buffer_handle_t handle)
 {
@@ -207,6 +346,10 @@ int gralloc_unregister_buffer(gralloc_module_t const* module,
             gralloc_unmap(module, handle);
         }
         hnd->base = 0;
+        // The fds are closed once we return, drop any state cached on them
+        notifyBufferRelease(hnd->fd);
+        notifyBufferRelease(hnd->fd_metadata);
+        dropLockRegion(hnd);
         // Release the genlock
         if (-1 != hnd->genlockHandle) {
             return genlock_release_lock((native_handle_t *)handle);
@@ -226,6 +369,7 @@ int terminateBuffer(gralloc_module_t const* module,
      * to un-map it. It's an error to be here with a locked buffer.
      */
 
+    dropLockRegion(hnd);
     if (hnd->base != 0) {
         // this buffer was mapped, unmap it now
         if (hnd->flags & (private_handle_t::PRIV_FLAGS_USES_PMEM |
@@ -293,6 +437,7 @@ int gralloc_lock(gralloc_module_t const* module,
             !(hnd->flags & private_handle_t::PRIV_FLAGS_FRAMEBUFFER)) {
             // Mark the buffer to be flushed after cpu read/write
             hnd->flags |= private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
+            addLockRegion(hnd, l, t, w, h);
         }
     }
     return err;
@@ -309,10 +454,7 @@ int gralloc_unlock(gralloc_module_t const* module,
     if (hnd->flags & private_handle_t::PRIV_FLAGS_NEEDS_FLUSH) {
         int err;
         IMemAlloc* memalloc = getAllocator(hnd->flags) ;
-        err = memalloc->clean_buffer((void*)hnd->base,
-                                     hnd->size, hnd->offset, hnd->fd);
-        ALOGE_IF(err < 0, "cannot flush handle %p (offs=%x len=%x, flags = 0x%x) err=%s\n",
-                 hnd, hnd->offset, hnd->size, hnd->flags, strerror(errno));
+        cleanLockRegion(memalloc, hnd);
         unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
         err = memalloc->clean_buffer((void*)hnd->base_metadata, size,
                 hnd->offset_metadata, hnd->fd_metadata);
@@ -42,6 +42,7 @@ struct alloc_data {
     size_t         align;
     unsigned int   pHandle;
     bool           uncached;
+    bool           noZeroFill;
     unsigned int   flags;
     int            allocType;
 };
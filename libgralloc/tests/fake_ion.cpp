@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * ALLOC, MAP, IMPORT, FREE and CLEAN_INV_CACHES on top of unlinked
+ * temporary files, so the buffer fds are real and can be mapped.
+ *
+ * Handles are reference counted per client as in ION: importing a buffer
+ * that already has a live handle returns that handle with one more
+ * reference. A handle keeps its buffer open until its last reference is
+ * dropped. Handle values are never reused, so flushing through a freed
+ * handle, freeing one too often or dropping the last reference while a
+ * flush runs on it are all caught and counted as errors.
+ *
+ * ALLOC faults in every page of the new buffer, which has the kernel
+ * hand out a cleared page each, as the ION heaps do. Flushes touch every
+ * cache line of the range. Both run outside the driver lock, so they cost
+ * real time and run in parallel like the per client locking of the real
+ * driver. IMPORT yields the CPU, as the real one can block,
+ * so that imports from different threads overlap even on a single CPU.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <linux/msm_ion.h>
+#include "fake_ion.h"
+
+#define MAX_FAKE_HANDLES (1 << 20)
+#define MAX_LIVE_HANDLES 4096
+#define FAKE_ION_DEVICE  "/dev/ion"
+
+struct fake_handle {
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    int refs;
+    int flushing;
+    int liveSlot;
+};
+
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static fake_handle *sHandles;
+static int sNumHandles;
+// Live handles, so IMPORT does not walk every handle ever made
+static int sLive[MAX_LIVE_HANDLES];
+static int sDevFd = -1;
+static fake_ion_stats sStats;
+
+// fake_ion_pause_next_flush state
+enum { PAUSE_NONE, PAUSE_ARMED, PAUSE_HELD };
+static int sPause = PAUSE_NONE;
+static pthread_cond_t sPauseCond = PTHREAD_COND_INITIALIZER;
+
+extern "C" int __real_open(const char *path, int flags, ...);
+
+/* Called with sLock held */
+static void fail(const char *what, int h)
+{
+    sStats.errors++;
+    fprintf(stderr, "fake ion: %s, handle %d\n", what, h);
+}
+
+static struct ion_handle* to_ion(int h)
+{
+    return (struct ion_handle*)(intptr_t)(h + 1);
+}
+
+/* Index of a handle that was handed out, -1 for garbage */
+static int from_ion(struct ion_handle *handle)
+{
+    int h = (int)(intptr_t)handle - 1;
+    return (h >= 0 && h < sNumHandles) ? h : -1;
+}
+
+/* New handle owning fd, called with sLock held */
+static int new_handle(int fd, const struct stat& st)
+{
+    if (!sHandles)
+        sHandles = (fake_handle*)calloc(MAX_FAKE_HANDLES, sizeof(fake_handle));
+    if (sNumHandles == MAX_FAKE_HANDLES || sStats.live == MAX_LIVE_HANDLES)
+        return -1;
+    fake_handle& fh = sHandles[sNumHandles];
+    fh.fd = fd;
+    fh.dev = st.st_dev;
+    fh.ino = st.st_ino;
+    fh.refs = 1;
+    fh.flushing = 0;
+    fh.liveSlot = sStats.live;
+    sLive[sStats.live++] = sNumHandles;
+    sStats.handles++;
+    return sNumHandles++;
+}
+
+static int do_alloc(struct ion_allocation_data *data)
+{
+    char path[] = "/tmp/fake_ion_XXXXXX";
+    struct stat st;
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+    unlink(path);
+    if (ftruncate(fd, data->len) || fstat(fd, &st)) {
+        close(fd);
+        return -1;
+    }
+    // Back every page now, as the heaps do, instead of on first use
+    void *pages = mmap(0, data->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0);
+    if (pages == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    for (size_t i = 0; i < data->len; i += 4096)
+        ((volatile unsigned char *)pages)[i] = 0;
+    munmap(pages, data->len);
+    pthread_mutex_lock(&sLock);
+    int h = new_handle(fd, st);
+    pthread_mutex_unlock(&sLock);
+    if (h < 0) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+    data->handle = to_ion(h);
+    return 0;
+}
+
+static int do_map(struct ion_fd_data *data)
+{
+    pthread_mutex_lock(&sLock);
+    int h = from_ion(data->handle);
+    int fd = -1;
+    if (h < 0 || sHandles[h].refs <= 0)
+        fail("MAP of a dead handle", h);
+    else
+        fd = dup(sHandles[h].fd);
+    pthread_mutex_unlock(&sLock);
+    if (fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    data->fd = fd;
+    return 0;
+}
+
+static int do_import(struct ion_fd_data *data)
+{
+    struct stat st;
+    if (fstat(data->fd, &st)) {
+        errno = EINVAL;
+        return -1;
+    }
+    sched_yield();
+    pthread_mutex_lock(&sLock);
+    for (int i = 0; i < sStats.live; i++) {
+        int h = sLive[i];
+        fake_handle& fh = sHandles[h];
+        if (fh.dev == st.st_dev && fh.ino == st.st_ino) {
+            fh.refs++;
+            sStats.sharedImports++;
+            data->handle = to_ion(h);
+            pthread_mutex_unlock(&sLock);
+            return 0;
+        }
+    }
+    int h = new_handle(dup(data->fd), st);
+    pthread_mutex_unlock(&sLock);
+    if (h < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    data->handle = to_ion(h);
+    return 0;
+}
+
+static int do_free(struct ion_handle_data *data)
+{
+    int fd = -1;
+    pthread_mutex_lock(&sLock);
+    int h = from_ion(data->handle);
+    if (h < 0 || sHandles[h].refs <= 0) {
+        fail("FREE of a dead handle", h);
+    } else if (--sHandles[h].refs == 0) {
+        if (sHandles[h].flushing)
+            fail("last reference dropped during a flush", h);
+        fd = sHandles[h].fd;
+        sHandles[h].fd = -1;
+        int last = sLive[--sStats.live];
+        sLive[sHandles[h].liveSlot] = last;
+        sHandles[last].liveSlot = sHandles[h].liveSlot;
+    }
+    pthread_mutex_unlock(&sLock);
+    if (fd >= 0)
+        close(fd);
+    return 0;
+}
+
+static int do_flush(struct ion_flush_data *data)
+{
+    pthread_mutex_lock(&sLock);
+    int h = from_ion(data->handle);
+    if (h < 0 || sHandles[h].refs <= 0) {
+        fail("flush through a dead handle", h);
+        pthread_mutex_unlock(&sLock);
+        errno = EINVAL;
+        return -1;
+    }
+    sHandles[h].flushing++;
+    sStats.flushes++;
+    if (sPause == PAUSE_ARMED) {
+        sPause = PAUSE_HELD;
+        pthread_cond_broadcast(&sPauseCond);
+        while (sPause == PAUSE_HELD)
+            pthread_cond_wait(&sPauseCond, &sLock);
+    }
+    pthread_mutex_unlock(&sLock);
+
+    volatile unsigned char *p = (volatile unsigned char *)data->vaddr;
+    unsigned int sum = 0;
+    for (unsigned int i = 0; i < data->length; i += 64)
+        sum += p[i];
+    (void)sum;
+
+    pthread_mutex_lock(&sLock);
+    if (sHandles[h].refs <= 0)
+        fail("handle freed during a flush", h);
+    sHandles[h].flushing--;
+    pthread_mutex_unlock(&sLock);
+    return 0;
+}
+
+extern "C" int __wrap_open(const char *path, int flags, ...)
+{
+    if (!strcmp(path, FAKE_ION_DEVICE)) {
+        pthread_mutex_lock(&sLock);
+        if (sDevFd < 0) {
+            int fds[2];
+            if (!pipe(fds)) {
+                close(fds[1]);
+                sDevFd = fds[0];
+            }
+        }
+        int fd = (sDevFd < 0) ? -1 : dup(sDevFd);
+        pthread_mutex_unlock(&sLock);
+        return fd;
+    }
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+    return __real_open(path, flags, mode);
+}
+
+extern "C" int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    (void)fd;
+
+    switch (request) {
+        case ION_IOC_ALLOC:
+            return do_alloc((struct ion_allocation_data *)arg);
+        case ION_IOC_MAP:
+            return do_map((struct ion_fd_data *)arg);
+        case ION_IOC_IMPORT:
+            return do_import((struct ion_fd_data *)arg);
+        case ION_IOC_FREE:
+            return do_free((struct ion_handle_data *)arg);
+        case ION_IOC_CLEAN_INV_CACHES:
+            return do_flush((struct ion_flush_data *)arg);
+    }
+    errno = ENOTTY;
+    return -1;
+}
+
+void fake_ion_get_stats(fake_ion_stats *stats)
+{
+    pthread_mutex_lock(&sLock);
+    *stats = sStats;
+    pthread_mutex_unlock(&sLock);
+}
+
+void fake_ion_pause_next_flush()
+{
+    pthread_mutex_lock(&sLock);
+    sPause = PAUSE_ARMED;
+    pthread_mutex_unlock(&sLock);
+}
+
+void fake_ion_wait_paused()
+{
+    pthread_mutex_lock(&sLock);
+    while (sPause != PAUSE_HELD)
+        pthread_cond_wait(&sPauseCond, &sLock);
+    pthread_mutex_unlock(&sLock);
+}
+
+void fake_ion_resume()
+{
+    pthread_mutex_lock(&sLock);
+    sPause = PAUSE_NONE;
+    pthread_cond_broadcast(&sPauseCond);
+    pthread_mutex_unlock(&sLock);
+}
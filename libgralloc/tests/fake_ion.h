@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FAKE_ION_H
+#define FAKE_ION_H
+
+/*
+ * User space stand-in for the ION driver, enough of it for IonAlloc.
+ * The test links with -Wl,--wrap=open,--wrap=ioctl so that opening
+ * /dev/ion and every ioctl made by ionalloc.cpp land in fake_ion.cpp.
+ */
+
+struct fake_ion_stats {
+    int handles;        // handles created by ALLOC or IMPORT
+    int sharedImports;  // IMPORTs that found a handle for the buffer
+    int flushes;
+    int live;           // handles not freed yet
+    int errors;         // misuse caught, see fake_ion.cpp
+};
+
+void fake_ion_get_stats(fake_ion_stats *stats);
+
+// Hold the next flush in the driver, with its handle in use, until
+// fake_ion_resume. fake_ion_wait_paused returns once it is held.
+void fake_ion_pause_next_flush();
+void fake_ion_wait_paused();
+void fake_ion_resume();
+
+#endif // FAKE_ION_H
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Stress test for the fb_post to HWC handoff.
+ *
+ * A producer thread posts the way fb_post does and the main thread
+ * calls wait4fbPost and wait4Pan like the composition thread. First the
+ * producer posts in bursts of up to three times FB_POST_SLOTS with short
+ * pauses in between and some slow pans, while the consumer sleeps now
+ * and then to fall a whole burst behind. Then both run flat out, so the
+ * consumer gets preempted while posts overtake it.
+ *
+ * The offset and timestamp of every post are derived from its sequence
+ * number, so a slot that was read while it was being refilled shows up
+ * as a mismatch. Sequences the consumer sees must keep increasing and no
+ * wait may time out. Returns non zero on any error.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gralloc_priv.h>
+#include <fb_priv.h>
+#include "hwc_utils.h"
+
+#define TOTAL_POSTS 50000
+#define FLOOD_POSTS 500000
+#define MAX_BURST   (3 * FB_POST_SLOTS)
+
+static private_module_t sModule;
+
+static uint32_t post_offset(int32_t seq)
+{
+    return (uint32_t)seq * 4096;
+}
+
+static int64_t post_timestamp(int32_t seq)
+{
+    // Above 32 bits, so a torn copy of the timestamp shows up too
+    return (1LL << 40) + seq * 16666667LL;
+}
+
+static int sTimeouts, sRepeats, sMismatches;
+
+// Posts TOTAL_POSTS more frames. Paced runs post in bursts with pauses
+// and slow pans, the others post back to back, so that the consumer is
+// preempted in the middle of reading a slot while posts overtake it.
+static void* producer(void *arg)
+{
+    bool paced = arg != NULL;
+    fb_handoff_t* h = &sModule.handoff;
+    unsigned int seed = 1;
+    int32_t seq = h->postSeq;
+    int32_t end = seq + (paced ? TOTAL_POSTS : FLOOD_POSTS);
+    while ((int32_t)(seq - end) < 0) {
+        int burst = 1 + rand_r(&seed) % MAX_BURST;
+        for (int i = 0; i < burst && (int32_t)(seq - end) < 0; i++) {
+            seq = fb_handoff_post(h, post_offset(seq + 1),
+                                  post_timestamp(seq + 1));
+            // Stands in for the pan ioctl
+            if (paced && rand_r(&seed) % 4 == 0)
+                usleep(rand_r(&seed) % 200);
+            fb_handoff_publish(h, &h->panSeq, seq);
+        }
+        if (paced)
+            usleep(rand_r(&seed) % 500);
+    }
+    return NULL;
+}
+
+// Consumes frames like the composition thread until the producer is
+// done, returns the number of frames seen
+static int consume(hwc_context_t* ctx, bool paced)
+{
+    pthread_t tid;
+    int32_t end = ctx->fbPost.seq + (paced ? TOTAL_POSTS : FLOOD_POSTS);
+    pthread_create(&tid, NULL, producer, paced ? (void *)1 : NULL);
+
+    unsigned int seed = 2;
+    int frames = 0;
+    while ((int32_t)(ctx->fbPost.seq - end) < 0) {
+        int32_t last = ctx->fbPost.seq;
+        qhwc::wait4fbPost(ctx);
+        if (ctx->fbPost.seq == last) {
+            sTimeouts++;
+            continue;
+        }
+        if ((int32_t)(ctx->fbPost.seq - last) < 0)
+            sRepeats++;
+        if (ctx->fbPost.info.offset != post_offset(ctx->fbPost.seq) ||
+            ctx->fbPost.info.timestamp != post_timestamp(ctx->fbPost.seq))
+            sMismatches++;
+        qhwc::wait4Pan(ctx);
+        if ((int32_t)(sModule.handoff.panSeq - ctx->fbPost.seq) < 0)
+            sTimeouts++;
+        frames++;
+        // Fall behind now and then, like a slow composition
+        if (paced && rand_r(&seed) % 8 == 0)
+            usleep(rand_r(&seed) % 1000);
+    }
+    pthread_join(tid, NULL);
+    return frames;
+}
+
+int main()
+{
+    hwc_context_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    memset(&sModule, 0, sizeof(sModule));
+    // The device has const members, only the module pointer is used
+    ctx.mFbDev = (framebuffer_device_t*)calloc(1, sizeof(*ctx.mFbDev));
+    ctx.mFbDev->common.module = &sModule.base.common;
+
+    int frames = consume(&ctx, true);
+    printf("paced: %d posts, %d frames\n", TOTAL_POSTS, frames);
+    frames = consume(&ctx, false);
+    printf("back to back: %d posts, %d frames\n", FLOOD_POSTS, frames);
+    free(ctx.mFbDev);
+
+    printf("timeouts %d, repeated or out of order %d, mismatches %d\n",
+           sTimeouts, sRepeats, sMismatches);
+    return (sTimeouts || sRepeats || sMismatches) ? 1 : 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Multi-threaded stress test for IonAlloc on top of the fake ION driver.
+ *
+ * Every thread keeps a few private buffers that it cleans and keeps
+ * replacing, and all threads clean a shared set of buffers that thread 0
+ * replaces now and then. There are more buffers in use than IonAlloc
+ * caches handles for, so entries are evicted and released while other
+ * threads flush through them, and threads meeting on a new shared buffer
+ * import it at the same time. The fake driver counts any flush through a
+ * freed handle, double free or leak as an error.
+ *
+ * The run is repeated for 1, 2, 4 and 8 threads and prints the clean
+ * throughput of each. Before that, one flush is held in the driver
+ * while enough other buffers are cleaned to make its entry the eviction
+ * candidate, and the allocation throughput is printed for the same
+ * thread counts. Each thread allocates and frees cached, zero filled
+ * buffers, the slowest path through alloc_buffer, which used to run
+ * under mLock. Returns non zero on errors or leaked handles.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ionalloc.h"
+#include "fake_ion.h"
+
+using gralloc::IonAlloc;
+using gralloc::alloc_data;
+
+#define BUFFER_SIZE      (256 * 1024)
+#define PRIVATE_BUFFERS  16
+#define SHARED_BUFFERS   8
+#define ITERATIONS       20000
+#define ALLOC_ITERATIONS 1000
+#define MAX_THREADS      8
+
+struct buffer {
+    void *base;
+    int fd;
+};
+
+static IonAlloc *sIon;
+static buffer sShared[SHARED_BUFFERS];
+// Last shared buffer replaced and a count of replacements
+static int sNewest;
+static volatile int sGeneration;
+static pthread_rwlock_t sSharedLock = PTHREAD_RWLOCK_INITIALIZER;
+static int sFailures;
+
+static bool alloc(buffer& b, bool zeroFill = false)
+{
+    alloc_data data;
+    memset(&data, 0, sizeof(data));
+    data.size = BUFFER_SIZE;
+    data.align = 4096;
+    // Uncached and not zero filled, so alloc_buffer does not import.
+    // Every IMPORT that finds a live handle then is a racing import
+    // inside IonAlloc. Zero filled ones are cached, so they are cleaned
+    // after the fill.
+    data.uncached = !zeroFill;
+    data.noZeroFill = !zeroFill;
+    if (sIon->alloc_buffer(data)) {
+        __sync_fetch_and_add(&sFailures, 1);
+        return false;
+    }
+    b.base = data.base;
+    b.fd = data.fd;
+    return true;
+}
+
+static void release(buffer& b)
+{
+    sIon->free_buffer(b.base, BUFFER_SIZE, 0, b.fd);
+    b.base = NULL;
+    b.fd = -1;
+}
+
+static int sCleans;
+
+static void clean(const buffer& b)
+{
+    if (sIon->clean_buffer(b.base, BUFFER_SIZE, 0, b.fd))
+        __sync_fetch_and_add(&sFailures, 1);
+    __sync_fetch_and_add(&sCleans, 1);
+}
+
+static void* worker(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    unsigned int seed = id + 1;
+    buffer priv[PRIVATE_BUFFERS];
+    for (int i = 0; i < PRIVATE_BUFFERS; i++)
+        alloc(priv[i]);
+
+    int seen = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        buffer& mine = priv[i % PRIVATE_BUFFERS];
+        clean(mine);
+        if (i % 64 == 63) {
+            release(mine);
+            alloc(mine);
+        }
+
+        // Threads waiting on the writer all go for the buffer it just
+        // replaced, so they import it at the same time
+        pthread_rwlock_rdlock(&sSharedLock);
+        if (seen != sGeneration) {
+            seen = sGeneration;
+            clean(sShared[sNewest]);
+        }
+        clean(sShared[rand_r(&seed) % SHARED_BUFFERS]);
+        pthread_rwlock_unlock(&sSharedLock);
+
+        if (id == 0 && i % 16 == 15) {
+            pthread_rwlock_wrlock(&sSharedLock);
+            sNewest = rand_r(&seed) % SHARED_BUFFERS;
+            release(sShared[sNewest]);
+            alloc(sShared[sNewest]);
+            sGeneration++;
+            pthread_rwlock_unlock(&sSharedLock);
+        }
+    }
+
+    for (int i = 0; i < PRIVATE_BUFFERS; i++)
+        release(priv[i]);
+    return NULL;
+}
+
+static int sAllocs;
+
+static void* alloc_worker(void *arg)
+{
+    for (int i = 0; i < ALLOC_ITERATIONS; i++) {
+        buffer b;
+        if (alloc(b, true)) {
+            release(b);
+            __sync_fetch_and_add(&sAllocs, 1);
+        }
+    }
+    return NULL;
+}
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static double run(int threads)
+{
+    pthread_t tids[MAX_THREADS];
+    sIon = new IonAlloc();
+    for (int i = 0; i < SHARED_BUFFERS; i++)
+        alloc(sShared[i]);
+
+    double start = now_ms();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, worker, (void *)(intptr_t)i);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    double elapsed = now_ms() - start;
+
+    for (int i = 0; i < SHARED_BUFFERS; i++)
+        release(sShared[i]);
+    delete sIon;
+    sIon = NULL;
+    return elapsed;
+}
+
+static double run_allocs(int threads)
+{
+    pthread_t tids[MAX_THREADS];
+    sIon = new IonAlloc();
+    double start = now_ms();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, alloc_worker, NULL);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    double elapsed = now_ms() - start;
+    delete sIon;
+    sIon = NULL;
+    return elapsed;
+}
+
+static void* clean_one(void *arg)
+{
+    clean(*(buffer *)arg);
+    return NULL;
+}
+
+/*
+ * Hold a flush in the driver while more buffers than there are cache
+ * slots get cleaned, so the entry in use is the eviction candidate.
+ * The handle must survive until the flush is done.
+ */
+static int evict_during_flush()
+{
+    fake_ion_stats before, after;
+    buffer held, others[48];
+    pthread_t tid;
+
+    fake_ion_get_stats(&before);
+    sIon = new IonAlloc();
+    alloc(held);
+    for (int i = 0; i < 48; i++)
+        alloc(others[i]);
+
+    fake_ion_pause_next_flush();
+    pthread_create(&tid, NULL, clean_one, &held);
+    fake_ion_wait_paused();
+    for (int i = 0; i < 48; i++)
+        clean(others[i]);
+    fake_ion_resume();
+    pthread_join(tid, NULL);
+
+    release(held);
+    for (int i = 0; i < 48; i++)
+        release(others[i]);
+    delete sIon;
+    sIon = NULL;
+    fake_ion_get_stats(&after);
+    printf("evict during flush: %s\n",
+           after.errors == before.errors ? "ok" : "FAILED");
+    return after.errors - before.errors;
+}
+
+int main()
+{
+    evict_during_flush();
+
+    double base = 0;
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        sAllocs = 0;
+        double ms = run_allocs(threads);
+        double rate = sAllocs / ms;
+        if (threads == 1)
+            base = rate;
+        printf("%d threads: %8.2f allocs/ms  x%.2f\n", threads, rate,
+               rate / base);
+    }
+
+    fake_ion_stats before, after;
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        fake_ion_get_stats(&before);
+        sCleans = 0;
+        double ms = run(threads);
+        fake_ion_get_stats(&after);
+        double rate = sCleans / ms;
+        if (threads == 1)
+            base = rate;
+        printf("%d threads: %8.0f cleans/ms  x%.2f  imports %d, racing %d\n",
+               threads, rate, rate / base, after.handles - before.handles,
+               after.sharedImports - before.sharedImports);
+    }
+    printf("errors %d, failed calls %d, leaked handles %d\n", after.errors,
+           sFailures, after.live);
+    return (after.errors || sFailures || after.live) ? 1 : 0;
+}
@@ -14,12 +14,15 @@ LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
 LOCAL_SRC_FILES               := hwc.cpp          \
                                  hwc_video.cpp    \
                                  hwc_utils.cpp    \
+                                 hwc_fbpost.cpp   \
                                  hwc_uimirror.cpp \
                                  hwc_uevents.cpp  \
                                  hwc_vsync.cpp    \
                                  hwc_copybit.cpp  \
                                  hwc_mdpcomp.cpp  \
-                                 hwc_extonly.cpp
+                                 hwc_extonly.cpp  \
+                                 hwc_framecache.cpp \
+                                 hwc_strategy.cpp
 
 include $(BUILD_SHARED_LIBRARY)
 
@@ -44,6 +47,7 @@ LOCAL_MODULE_PATH             := $(TARGET_OUT_SHARED_LIBRARIES)
 LOCAL_MODULE_TAGS             := optional
 LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
 LOCAL_SHARED_LIBRARIES        := $(common_libs) libhwcexternal libbinder \
+                                 libqdutils
 
 LOCAL_CFLAGS                  := $(common_flags) -DLOG_TAG=\"hwcservice\"
 LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
@@ -51,3 +55,29 @@ LOCAL_SRC_FILES               := hwc_service.cpp \
                                  ihwc.cpp
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Host check of the MDP composition pipe solver, on a fake overlay
+ifeq ($(HOST_OS),linux)
+include $(CLEAR_VARS)
+LOCAL_MODULE                  := mdpcomp_solver_test
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_STATIC_LIBRARIES        := liblog libcutils
+LOCAL_CFLAGS                  := $(common_flags) -DLOG_TAG=\"hwcomposer\"
+LOCAL_SRC_FILES               := hwc_mdpcomp.cpp tests/mdpcomp_fakes.cpp \
+                                 tests/mdpcomp_solver_test.cpp
+LOCAL_LDLIBS                  := -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
+# Host check that MDP composition does not allocate per frame. It replaces
+# malloc on top of the glibc one.
+include $(CLEAR_VARS)
+LOCAL_MODULE                  := mdpcomp_alloc_test
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) $(kernel_includes)
+LOCAL_STATIC_LIBRARIES        := liblog libcutils
+LOCAL_CFLAGS                  := $(common_flags) -DLOG_TAG=\"hwcomposer\"
+LOCAL_SRC_FILES               := hwc_mdpcomp.cpp tests/mdpcomp_fakes.cpp \
+                                 tests/mdpcomp_alloc_test.cpp
+include $(BUILD_HOST_EXECUTABLE)
+endif
@@ -25,6 +25,7 @@
 #include <overlay.h>
 #include <fb_priv.h>
 #include <mdp_version.h>
+#include <frame_trace.h>
 #include "hwc_utils.h"
 #include "hwc_qbuf.h"
 #include "hwc_video.h"
@@ -33,6 +34,9 @@
 #include "hwc_external.h"
 #include "hwc_mdpcomp.h"
 #include "hwc_extonly.h"
+#include "hwc_framecache.h"
+#include "hwc_strategy.h"
+#include "hwc_vsync.h"
 #include "qcom_ui.h"
 
 #define VSYNC_DEBUG 0
@@ -82,12 +86,21 @@ static void hwc_registerProcs(struct hwc_composer_device* dev,
 static int hwc_prepare(hwc_composer_device_t *dev, hwc_layer_list_t* list)
 {
     hwc_context_t* ctx = (hwc_context_t*)(dev);
+    if(qdutils::FrameTrace::isEnabled())
+        qdutils::FrameTrace::getInstance().nextFrame();
+    qdutils::TraceScope prepareTrace(qdutils::TRACE_PREPARE);
     ctx->overlayInUse = false;
 
     if(ctx->mExtDisplay->getExternalDisplay())
         ovutils::setExtType(ctx->mExtDisplay->getExternalDisplay());
 
     if (LIKELY(list)) {
+        //Unchanged frame, the last decisions and pipe setup still hold
+        if(FrameCache::lookup(ctx, list)) {
+            qdutils::CBUtils::checkforGPULayer(list);
+            return 0;
+        }
+
         //reset for this draw round
         VideoOverlay::reset();
         ExtOnly::reset();
@@ -95,25 +108,16 @@ static int hwc_prepare(hwc_composer_device_t *dev, hwc_layer_list_t* list)
         getLayerStats(ctx, list);
         // Mark all layers to COPYBIT initially
         CopyBit::prepare(ctx, list);
-        if(VideoOverlay::prepare(ctx, list)) {
-            ctx->overlayInUse = true;
-            //Nothing here
-        } else if(ExtOnly::prepare(ctx, list)) {
-            ctx->overlayInUse = true;
-        } else if(UIMirrorOverlay::prepare(ctx, list)) {
-            ctx->overlayInUse = true;
-        } else if(MDPComp::configure(dev, list)) {
-            ctx->overlayInUse = true;
-        } else if (0) {
-            //Other features
-            ctx->overlayInUse = true;
-        } else { // Else set this flag to false, otherwise video cases
-                 // fail in non-overlay targets.
-            ctx->overlayInUse = false;
-            ctx->mOverlay->setState(ovutils::OV_CLOSED);
+        // Video, ext-only, UI mirror, MDP comp or FB, cheapest first
+        {
+            qdutils::TraceScope trace(qdutils::TRACE_STRATEGY);
+            ctx->overlayInUse = CompStrategy::prepare(ctx, list);
         }
 
+        FrameCache::save(ctx, list);
         qdutils::CBUtils::checkforGPULayer(list);
+    } else {
+        FrameCache::reset();
     }
 
     return 0;
@@ -126,8 +130,6 @@ static int hwc_eventControl(struct hwc_composer_device* dev,
     static int prev_value, temp;
 
     hwc_context_t* ctx = (hwc_context_t*)(dev);
-    private_module_t* m = reinterpret_cast<private_module_t*>(
-                ctx->mFbDev->common.module);
     switch(event) {
         case HWC_EVENT_VSYNC:
             if (value == prev_value){
@@ -136,23 +138,20 @@ static int hwc_eventControl(struct hwc_composer_device* dev,
                         __FUNCTION__, (value)?"ENABLED":"DISABLED");
             }
             temp = ctx->vstate.enable;
-            if(ioctl(m->framebuffer->fd, MSMFB_OVERLAY_VSYNC_CTRL, &value) < 0)
-                ret = -errno;
 
             /* vsync state change logic */
+            pthread_mutex_lock(&ctx->vstate.lock);
+            ret = set_hw_vsync_locked(ctx, value);
             if (value == 1) {
                 //unblock vsync thread
-                pthread_mutex_lock(&ctx->vstate.lock);
                 ctx->vstate.enable = true;
                 pthread_cond_signal(&ctx->vstate.cond);
-                pthread_mutex_unlock(&ctx->vstate.lock);
             }
             if (value == 0 && temp) {
                 //vsync thread will block
-                pthread_mutex_lock(&ctx->vstate.lock);
                 ctx->vstate.enable = false;
-                pthread_mutex_unlock(&ctx->vstate.lock);
             }
+            pthread_mutex_unlock(&ctx->vstate.lock);
             ALOGD_IF (VSYNC_DEBUG, "VSYNC state changed from %s to %s",
               (prev_value)?"ENABLED":"DISABLED", (value)?"ENABLED":"DISABLED");
             prev_value = value;
@@ -165,6 +164,7 @@ static int hwc_eventControl(struct hwc_composer_device* dev,
            break;
        case HWC_EVENT_ORIENTATION:
              ctx->deviceOrientation = value;
+             android_atomic_inc(&ctx->compGeneration);
            break;
         default:
             ret = -EINVAL;
@@ -185,8 +185,9 @@ static int hwc_query(struct hwc_composer_device* dev,
         value[0] = 0;
         break;
     case HWC_VSYNC_PERIOD:
-        value[0] = 1000000000.0 / m->fps;
-        ALOGI("fps: %d", value[0]);
+        // Measured once the vsync model has locked, nominal before
+        value[0] = VsyncModel::getPeriod();
+        ALOGI("vsync period: %d ns (fps: %d)", value[0], m->fps);
         break;
     default:
         return -EINVAL;
@@ -202,25 +203,64 @@ static int hwc_set(hwc_composer_device_t *dev,
 {
     int ret = 0;
     hwc_context_t* ctx = (hwc_context_t*)(dev);
+    qdutils::TraceScope setTrace(qdutils::TRACE_SET);
     if (LIKELY(list)) {
-        VideoOverlay::draw(ctx, list);
-        ExtOnly::draw(ctx, list);
-        CopyBit::draw(ctx, list, (EGLDisplay)dpy, (EGLSurface)sur);
-        MDPComp::draw(ctx, list);
-        EGLBoolean sucess = eglSwapBuffers((EGLDisplay)dpy, (EGLSurface)sur);
+        {
+            qdutils::TraceScope trace(qdutils::TRACE_VIDEO_DRAW);
+            VideoOverlay::draw(ctx, list);
+        }
+        {
+            qdutils::TraceScope trace(qdutils::TRACE_EXTONLY_DRAW);
+            ExtOnly::draw(ctx, list);
+        }
+        {
+            qdutils::TraceScope trace(qdutils::TRACE_COPYBIT_DRAW);
+            CopyBit::draw(ctx, list, (EGLDisplay)dpy, (EGLSurface)sur);
+        }
+        {
+            qdutils::TraceScope trace(qdutils::TRACE_MDPCOMP_DRAW);
+            MDPComp::draw(ctx, list);
+        }
+        {
+            //Copybit layers must land in the FB before it is posted
+            qdutils::TraceScope trace(qdutils::TRACE_COPYBIT_FINISH);
+            CopyBit::finishDraw(ctx);
+        }
+        EGLBoolean sucess;
+        {
+            qdutils::TraceScope trace(qdutils::TRACE_SWAP_BUFFERS);
+            sucess = eglSwapBuffers((EGLDisplay)dpy, (EGLSurface)sur);
+        }
         if(ctx->mMDP.hasOverlay) {
-            wait4fbPost(ctx);
-            //Can draw to HDMI only when fb_post is reached
-            UIMirrorOverlay::draw(ctx);
+            {
+                qdutils::TraceScope trace(qdutils::TRACE_WAIT_FB_POST);
+                wait4fbPost(ctx);
+            }
+            {
+                //Can draw to HDMI only when fb_post is reached
+                qdutils::TraceScope trace(qdutils::TRACE_UIMIRROR_DRAW);
+                UIMirrorOverlay::draw(ctx);
+            }
             //HDMI commit and primary commit (PAN) happening in parallel
-            if(ctx->mExtDisplay->getExternalDisplay())
+            if(ctx->mExtDisplay->getExternalDisplay()) {
+                qdutils::TraceScope trace(qdutils::TRACE_EXT_COMMIT);
                 ctx->mExtDisplay->commit();
-            //Virtual barrier for threads to finish
-            wait4Pan(ctx);
+            }
+            //Virtual barrier for threads to finish. With fb_post queueing
+            //its flips, only needed before releasing overlay buffers that
+            //may still be on screen or with an external commit in flight.
+            if(!fbFlipQueued(ctx) || ctx->qbuf->hasPrevious() ||
+               ctx->mExtDisplay->getExternalDisplay()) {
+                qdutils::TraceScope trace(qdutils::TRACE_WAIT_PAN);
+                wait4Pan(ctx);
+            }
         }
     } else {
         ctx->mOverlay->setState(ovutils::OV_CLOSED);
         ctx->qbuf->unlockAll();
+        FrameCache::reset();
+        //Nothing is drawn until the next list, drop the copybit scratch
+        CopyBit::releaseTmpBuffers();
     }
 
 
@@ -228,6 +268,29 @@ static int hwc_set(hwc_composer_device_t *dev,
     return ret;
 }
 
+static void hwc_dump(struct hwc_composer_device* dev, char *buff,
+                     int buff_len)
+{
+    if(buff_len <= 0)
+        return;
+    hwc_context_t* ctx = (hwc_context_t*)(dev);
+    private_module_t* m = reinterpret_cast<private_module_t*>(
+        ctx->mFbDev->common.module);
+    android::String8 result;
+    if(m->flipQueueDepth) {
+        result.appendFormat("FB flip queue: depth %u, grown %u, shrunk %u, "
+                            "late pans %u\n", m->flipQueueDepth,
+                            m->flipStats.grows, m->flipStats.shrinks,
+                            m->flipStats.misses);
+    }
+    CopyBit::dump(result);
+    VsyncStats::dump(result);
+    VsyncModel::dump(result);
+    qdutils::FrameTrace::getInstance().dump(result,
+                                            qdutils::TRACE_FORMAT_TEXT);
+    snprintf(buff, buff_len, "%s", result.string());
+}
+
 static int hwc_device_close(struct hw_device_t *dev)
 {
     if(!dev) {
@@ -272,6 +335,7 @@ static int hwc_device_open(const struct hw_module_t* module, const char* name,
         dev->device.set            = hwc_set;
         dev->device.registerProcs  = hwc_registerProcs;
         dev->device.query          = hwc_query;
+        dev->device.dump           = hwc_dump;
         dev->device.methods        = methods;
         *device                    = &dev->device.common;
         status = 0;
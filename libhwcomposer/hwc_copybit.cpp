@@ -21,11 +21,16 @@
 #define DEBUG_COPYBIT 0
 #include <copybit.h>
 #include <genlock.h>
+#include <cutils/properties.h>
 #include "hwc_copybit.h"
+#include "hwc_strategy.h"
 #include "comptype.h"
 #include "egl_handles.h"
+#include "frame_trace.h"
 
 #define  MAX_COPYBIT_RECT 5
+// Frames an unused intermediate buffer is kept for
+#define  TMP_BUFFER_MAX_AGE 60
 
 namespace qhwc {
 
@@ -70,6 +75,29 @@ private:
 bool CopyBit::sIsModeOn = false;
 bool CopyBit::sIsSkipLayerPresent = false;
 bool CopyBit::sCopyBitDraw = false;
+bool CopyBit::sBatchDraw = false;
+void* CopyBit::sFrameTimestamp = NULL;
+private_handle_t* CopyBit::sPendingUnlock[MAX_BATCHED_LAYERS];
+int CopyBit::sNumPendingUnlock = 0;
+private_handle_t* CopyBit::sPendingRelease[MAX_BATCHED_LAYERS];
+int CopyBit::sNumPendingRelease = 0;
+CopyBit::tmp_buffer CopyBit::sTmpBuffers[MAX_TMP_BUFFERS];
+unsigned int CopyBit::sFrameCount = 0;
+unsigned int CopyBit::sTmpHits = 0;
+unsigned int CopyBit::sTmpMisses = 0;
+unsigned int CopyBit::sTmpEvictions = 0;
+
+void CopyBit::init(hwc_context_t *ctx) {
+    // Batch the copybit layers of a frame into one submission when the
+    // engine supports it. debug.hwc.copybit.batch=0 blits synchronously.
+    char property[PROPERTY_VALUE_MAX];
+    copybit_device_t *copybit = ctx->mCopybitEngine->getEngine();
+    property_get("debug.hwc.copybit.batch", property, "1");
+    sBatchDraw = copybit && copybit->begin_frame && copybit->end_frame &&
+                 copybit->wait_frame && (atoi(property) != 0);
+    ALOGD_IF(DEBUG_COPYBIT, "%s: batched copybit draw %s", __FUNCTION__,
+             sBatchDraw ? "enabled" : "disabled");
+}
 
 bool CopyBit::canUseCopybitForYUV(hwc_context_t *ctx) {
     // return true for non-overlay targets
@@ -104,20 +132,8 @@ bool CopyBit::canUseCopybitForRGB(hwc_context_t *ctx, hwc_layer_list_t *list) {
 
     if (compositionType & qdutils::COMPOSITION_TYPE_DYN) {
         // DYN Composition:
-        // use copybit, depending on dyn threshold
-
-        framebuffer_device_t *fbDev = ctx->mFbDev;
-        if (!fbDev) {
-            ALOGE("%s:Invalid FB device", __FUNCTION__);
-            return false;
-        }
-        unsigned int fbArea = (fbDev->width * fbDev->height);
-        unsigned int renderArea = getRGBRenderingArea(list);
-            ALOGD_IF (DEBUG_COPYBIT, "%s:renderArea %u, fbArea %u",
-                                  __FUNCTION__, renderArea, fbArea);
-        if (renderArea < (unsigned int) (ctx->dynThreshold * fbArea)) {
-            return true;
-        }
+        // use copybit if its estimated cost is below the GPU's
+        return CompStrategy::preferCopybit(ctx);
     } else if ((compositionType & qdutils::COMPOSITION_TYPE_MDP)) {
       // MDP composition, use COPYBIT always
       return true;
@@ -128,22 +144,6 @@ bool CopyBit::canUseCopybitForRGB(hwc_context_t *ctx, hwc_layer_list_t *list) {
     return false;
 }
 
-unsigned int CopyBit::getRGBRenderingArea(const hwc_layer_list_t *list) {
-    //Calculates total rendering area for RGB layers
-    unsigned int renderArea = 0;
-    unsigned int w=0, h=0;
-    for (unsigned int i=0; i<list->numHwLayers; i++) {
-         private_handle_t *hnd = (private_handle_t *)list->hwLayers[i].handle;
-         if (hnd) {
-             if (BUFFER_TYPE_UI == hnd->bufferType) {
-                 getLayerResolution(&list->hwLayers[i], w, h);
-                 renderArea += (w*h);
-             }
-         }
-    }
-    return renderArea;
-}
-
 bool CopyBit::prepare(hwc_context_t *ctx, hwc_layer_list_t *list) {
 
     sCopyBitDraw = false;
@@ -211,6 +211,9 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_layer_list_t *list, EGLDisplay dpy,
     // draw layers marked for COPYBIT
     int retVal = true;
 
+    sFrameCount++;
+    ageTmpBuffers(TMP_BUFFER_MAX_AGE);
+
     if(sCopyBitDraw == false) // there is no any layer marked for copybit
        return true ;
 
@@ -222,8 +225,16 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_layer_list_t *list, EGLDisplay dpy,
         return -1;
     }
 
+    copybit_device_t *copybit = ctx->mCopybitEngine->getEngine();
+    if (sBatchDraw)
+        copybit->begin_frame(copybit);
+
     for (size_t i=0; i<list->numHwLayers; i++) {
         if (list->hwLayers[i].compositionType == HWC_USE_COPYBIT) {
+            qdutils::TraceScope trace(qdutils::TRACE_COPYBIT_LAYER, i);
+            if (sBatchDraw && (sNumPendingUnlock == MAX_BATCHED_LAYERS ||
+                               sNumPendingRelease == MAX_BATCHED_LAYERS))
+                restartBatch(ctx);
             retVal = drawLayerUsingCopybit(ctx, &(list->hwLayers[i]),
                                                      (EGLDisplay)dpy,
                                                      (EGLSurface)sur,
@@ -233,9 +244,140 @@ bool CopyBit::draw(hwc_context_t *ctx, hwc_layer_list_t *list, EGLDisplay dpy,
            }
         }
     }
+
+    // Submit the whole frame, finishDraw waits for it
+    if (sBatchDraw)
+        copybit->end_frame(copybit, &sFrameTimestamp);
     return true;
 }
 
+void CopyBit::finishDraw(hwc_context_t *ctx) {
+    if (!sBatchDraw)
+        return;
+
+    copybit_device_t *copybit = ctx->mCopybitEngine->getEngine();
+    if (sFrameTimestamp || sNumPendingUnlock || sNumPendingRelease)
+        copybit->wait_frame(copybit, sFrameTimestamp);
+    sFrameTimestamp = NULL;
+
+    for (int i = 0; i < sNumPendingRelease; i++)
+        putTmpBuffer(sPendingRelease[i]);
+    sNumPendingRelease = 0;
+
+    for (int i = 0; i < sNumPendingUnlock; i++) {
+        if (GENLOCK_FAILURE == genlock_unlock_buffer(sPendingUnlock[i])) {
+            ALOGE("%s: genlock_unlock_buffer failed", __FUNCTION__);
+        }
+    }
+    sNumPendingUnlock = 0;
+}
+
+private_handle_t *CopyBit::getTmpBuffer(int w, int h, int format, int usage) {
+    int freeSlot = -1;
+    int lruSlot = -1;
+    for (int i = 0; i < MAX_TMP_BUFFERS; i++) {
+        tmp_buffer& buf = sTmpBuffers[i];
+        if (!buf.hnd) {
+            if (freeSlot < 0)
+                freeSlot = i;
+            continue;
+        }
+        if (buf.inUse)
+            continue;
+        if (buf.w == w && buf.h == h && buf.format == format &&
+            buf.usage == usage) {
+            buf.inUse = true;
+            buf.lastUsed = sFrameCount;
+            sTmpHits++;
+            return buf.hnd;
+        }
+        if (lruSlot < 0 || buf.lastUsed < sTmpBuffers[lruSlot].lastUsed)
+            lruSlot = i;
+    }
+
+    sTmpMisses++;
+    private_handle_t *hnd = NULL;
+    if (0 != alloc_buffer(&hnd, w, h, format, usage)) {
+        // Memory pressure, give back everything idle and retry once
+        ALOGD_IF(DEBUG_COPYBIT, "%s: alloc %dx%d failed, flushing cache",
+                 __FUNCTION__, w, h);
+        ageTmpBuffers(0);
+        freeSlot = 0;
+        while (freeSlot < MAX_TMP_BUFFERS && sTmpBuffers[freeSlot].hnd)
+            freeSlot++;
+        if (freeSlot == MAX_TMP_BUFFERS)
+            freeSlot = -1;
+        lruSlot = -1;
+        if (0 != alloc_buffer(&hnd, w, h, format, usage))
+            return NULL;
+    }
+
+    if (freeSlot < 0 && lruSlot >= 0) {
+        // Make room by dropping the least recently used idle buffer
+        free_buffer(sTmpBuffers[lruSlot].hnd);
+        sTmpBuffers[lruSlot].hnd = NULL;
+        sTmpEvictions++;
+        freeSlot = lruSlot;
+    }
+    if (freeSlot >= 0) {
+        tmp_buffer& buf = sTmpBuffers[freeSlot];
+        buf.hnd = hnd;
+        buf.w = w;
+        buf.h = h;
+        buf.format = format;
+        buf.usage = usage;
+        buf.inUse = true;
+        buf.lastUsed = sFrameCount;
+    }
+    // else every slot is in use, the buffer is freed when put back
+    return hnd;
+}
+
+void CopyBit::putTmpBuffer(private_handle_t *hnd) {
+    for (int i = 0; i < MAX_TMP_BUFFERS; i++) {
+        if (sTmpBuffers[i].hnd == hnd) {
+            sTmpBuffers[i].inUse = false;
+            return;
+        }
+    }
+    free_buffer(hnd);
+}
+
+void CopyBit::ageTmpBuffers(unsigned int maxAge) {
+    for (int i = 0; i < MAX_TMP_BUFFERS; i++) {
+        tmp_buffer& buf = sTmpBuffers[i];
+        if (buf.hnd && !buf.inUse &&
+            (sFrameCount - buf.lastUsed) >= maxAge) {
+            ALOGD_IF(DEBUG_COPYBIT, "%s: freeing %dx%d buffer", __FUNCTION__,
+                     buf.w, buf.h);
+            free_buffer(buf.hnd);
+            buf.hnd = NULL;
+        }
+    }
+}
+
+void CopyBit::releaseTmpBuffers() {
+    ageTmpBuffers(0);
+}
+
+void CopyBit::dump(android::String8& buf) {
+    int cached = 0;
+    for (int i = 0; i < MAX_TMP_BUFFERS; i++) {
+        if (sTmpBuffers[i].hnd)
+            cached++;
+    }
+    buf.appendFormat("Copybit intermediate buffers: %d cached, hits=%u "
+                     "misses=%u evictions=%u\n", cached, sTmpHits,
+                     sTmpMisses, sTmpEvictions);
+}
+
+void CopyBit::restartBatch(hwc_context_t *ctx) {
+    copybit_device_t *copybit = ctx->mCopybitEngine->getEngine();
+    copybit->end_frame(copybit, &sFrameTimestamp);
+    finishDraw(ctx);
+    copybit->begin_frame(copybit);
+}
+
 int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_t *layer,
                                                             EGLDisplay dpy,
                                                         EGLSurface surface,
@@ -409,7 +551,10 @@ int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_t *layer,
        int usage = GRALLOC_USAGE_PRIVATE_MM_HEAP|GRALLOC_USAGE_PRIVATE_UNCACHED;
        if(dev->mMDP.version < 400)
           usage = GRALLOC_USAGE_PRIVATE_CAMERA_HEAP|GRALLOC_USAGE_PRIVATE_UNCACHED;
-       if (0 == alloc_buffer(&tmpHnd, tmp_w, tmp_h, HAL_PIXEL_FORMAT_RGB_565, usage)){
+       // The first pass writes the whole buffer
+       usage |= GRALLOC_USAGE_PRIVATE_NO_ZERO_FILL;
+       tmpHnd = getTmpBuffer(tmp_w, tmp_h, HAL_PIXEL_FORMAT_RGB_565, usage);
+       if (tmpHnd) {
             copybit_image_t tmp_dst;
             copybit_rect_t tmp_rect;
             tmp_dst.w = tmp_w;
@@ -434,8 +579,7 @@ int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_t *layer,
             if(err < 0){
                 ALOGE("%s:%d::tmp copybit stretch failed",__FUNCTION__,
                                                              __LINE__);
-                if(tmpHnd)
-                    free_buffer(tmpHnd);
+                putTmpBuffer(tmpHnd);
                 genlock_unlock_buffer(hnd);
                 return err;
             }
@@ -480,12 +624,20 @@ int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_t *layer,
     copybit->set_parameter(copybit, COPYBIT_BLIT_TO_FRAMEBUFFER,
                                                COPYBIT_DISABLE);
 
-    if(tmpHnd)
-        free_buffer(tmpHnd);
-
     if(err < 0)
         ALOGE("%s: copybit stretch failed",__FUNCTION__);
 
+    if (sBatchDraw) {
+        // The blit is only queued, keep the buffers until finishDraw
+        if(tmpHnd)
+            sPendingRelease[sNumPendingRelease++] = tmpHnd;
+        sPendingUnlock[sNumPendingUnlock++] = hnd;
+        return err;
+    }
+
+    if(tmpHnd)
+        putTmpBuffer(tmpHnd);
+
     // Unlock this buffer since copybit is done with it.
     err = genlock_unlock_buffer(hnd);
     if (GENLOCK_FAILURE == err) {
@@ -535,7 +687,7 @@ CopybitEngine* CopybitEngine::getInstance() {
    return sInstance;
 }
 
-CopybitEngine::CopybitEngine(){
+CopybitEngine::CopybitEngine() : sEngine(NULL) {
     hw_module_t const *module;
     if (hw_get_module(COPYBIT_HARDWARE_MODULE_ID, &module) == 0) {
         copybit_open(module, &sEngine);
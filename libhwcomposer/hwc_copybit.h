@@ -25,19 +25,30 @@
 #include <gralloc_priv.h>
 #include <gr.h>
 #include <dlfcn.h>
+#include <utils/String8.h>
 
 #define LIKELY( exp )       (__builtin_expect( (exp) != 0, true  ))
 #define UNLIKELY( exp )     (__builtin_expect( (exp) != 0, false ))
+#define MAX_BATCHED_LAYERS  8
+#define MAX_TMP_BUFFERS     4
 
 namespace qhwc {
 
 class CopyBit {
 public:
+    //Reads the copybit configuration
+    static void init(hwc_context_t *ctx);
     //Sets up members and prepares copybit if conditions are met
     static bool prepare(hwc_context_t *ctx, hwc_layer_list_t *list);
     //Draws layer if the layer is set for copybit in prepare
     static bool draw(hwc_context_t *ctx, hwc_layer_list_t *list, EGLDisplay dpy,
                                                                 EGLSurface sur);
+    //Waits for the blits queued by draw, call before posting the FB
+    static void finishDraw(hwc_context_t *ctx);
+    //Frees the cached intermediate buffers that are not in use
+    static void releaseTmpBuffers();
+    //Appends the intermediate buffer cache stats
+    static void dump(android::String8& buf);
     //Receives data from hwc
     static void setStats(int skipCount);
 
@@ -62,8 +73,40 @@ private:
     static bool sIsModeOn;
     // flag that indicates whether CopyBit is enabled or not
     static bool sCopyBitDraw;
+    // Queue all layers of a frame and flush them once
+    static bool sBatchDraw;
+    // Timestamp of the blits submitted by draw, NULL if none pending
+    static void *sFrameTimestamp;
+    // Buffers that must stay locked/allocated until the blits complete
+    static private_handle_t *sPendingUnlock[MAX_BATCHED_LAYERS];
+    static int sNumPendingUnlock;
+    static private_handle_t *sPendingRelease[MAX_BATCHED_LAYERS];
+    static int sNumPendingRelease;
+    //Flushes the queued blits and starts a new batch
+    static void restartBatch(hwc_context_t *ctx);
 
-    static  unsigned int getRGBRenderingArea (const hwc_layer_list_t *list);
+    //Intermediate buffers of two pass scaling, reused across frames
+    struct tmp_buffer {
+        private_handle_t *hnd;
+        int w;
+        int h;
+        int format;
+        int usage;
+        bool inUse;
+        unsigned int lastUsed;
+    };
+    static tmp_buffer sTmpBuffers[MAX_TMP_BUFFERS];
+    static unsigned int sFrameCount;
+    static unsigned int sTmpHits;
+    static unsigned int sTmpMisses;
+    static unsigned int sTmpEvictions;
+    //Returns a buffer of the given key, allocating it on a miss
+    static private_handle_t *getTmpBuffer(int w, int h, int format,
+                                          int usage);
+    //Hands a buffer from getTmpBuffer back to the cache
+    static void putTmpBuffer(private_handle_t *hnd);
+    //Frees the idle buffers unused for maxAge frames, 0 frees all idle ones
+    static void ageTmpBuffers(unsigned int maxAge);
 
     static void getLayerResolution(const hwc_layer_t* layer,
                                    unsigned int &width, unsigned int& height);
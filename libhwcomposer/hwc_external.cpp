@@ -33,6 +33,7 @@
 #include <sys/poll.h>
 #include <sys/resource.h>
 #include <cutils/properties.h>
+#include <cutils/atomic.h>
 #include "hwc_utils.h"
 #include "hwc_external.h"
 #include "overlayUtils.h"
@@ -484,6 +485,9 @@ void ExternalDisplay::setExternalDisplay(int connected)
                  connected);
         // Store the external display
         mExternalDisplay = connected;
+        // Mode, action safe and connection changes need a fresh prepare
+        android_atomic_inc(&ctx->compGeneration);
+        android_atomic_inc(&ctx->vstate.hotplugGeneration);
         const char* prop = (connected) ? "1" : "0";
         // set system property
         property_set("hw.hdmiON", prop);
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gralloc_priv.h>
+#include <fb_priv.h>
+#include "hwc_utils.h"
+
+// Bounds the waits on fb_post, a lost post must not hang composition
+#define FB_HANDOFF_TIMEOUT_MS 500
+
+namespace qhwc {
+
+void wait4fbPost(hwc_context_t* ctx) {
+    framebuffer_device_t *fbDev = ctx->mFbDev;
+    if(fbDev) {
+        private_module_t* m = reinterpret_cast<private_module_t*>(
+                              fbDev->common.module);
+        fb_handoff_t* h = &m->handoff;
+        //wait for the fb_post to be called
+        if(!fb_handoff_wait(h, &h->postSeq, ctx->fbPost.seq + 1,
+                            FB_HANDOFF_TIMEOUT_MS)) {
+            ALOGE("%s: no fb_post in %d ms", __FUNCTION__,
+                  FB_HANDOFF_TIMEOUT_MS);
+            return;
+        }
+        //Take the newest post. Slot seq is refilled for post
+        //seq + FB_POST_SLOTS, which fb_post starts writing as soon as it
+        //has published seq + FB_POST_SLOTS - 1. Read again if it got that
+        //far while we were copying.
+        int32_t seq;
+        do {
+            seq = android_atomic_acquire_load(&h->postSeq);
+            ctx->fbPost.info = h->posts[(uint32_t)seq % FB_POST_SLOTS];
+            //The copy has to be done before postSeq is checked again
+            android_memory_barrier();
+        } while((int32_t)(android_atomic_acquire_load(&h->postSeq) - seq) >=
+                FB_POST_SLOTS - 1);
+        ctx->fbPost.seq = seq;
+    }
+}
+
+bool fbFlipQueued(hwc_context_t* ctx) {
+    framebuffer_device_t *fbDev = ctx->mFbDev;
+    if(!fbDev)
+        return false;
+    private_module_t* m = reinterpret_cast<private_module_t*>(
+                          fbDev->common.module);
+    return m->flipQueueDepth > 0;
+}
+
+void wait4Pan(hwc_context_t* ctx) {
+    framebuffer_device_t *fbDev = ctx->mFbDev;
+    if(fbDev) {
+        private_module_t* m = reinterpret_cast<private_module_t*>(
+                              fbDev->common.module);
+        fb_handoff_t* h = &m->handoff;
+        //wait for the fb_post's PAN to finish
+        if(!fb_handoff_wait(h, &h->panSeq, ctx->fbPost.seq,
+                            FB_HANDOFF_TIMEOUT_MS)) {
+            ALOGE("%s: pan of post %d not done in %d ms", __FUNCTION__,
+                  ctx->fbPost.seq, FB_HANDOFF_TIMEOUT_MS);
+        }
+    }
+}
+};//namespace
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/properties.h>
+#include "comptype.h"
+#include "hwc_framecache.h"
+#include "hwc_external.h"
+#include "qdMetaData.h"
+
+namespace qhwc {
+
+#define FRAMECACHE_DEBUG 0
+
+//Static Members
+bool FrameCache::sEnabled = false;
+bool FrameCache::sValid = false;
+bool FrameCache::sNextValid = false;
+bool FrameCache::sOverlayInUse = false;
+FrameCache::frame_key FrameCache::sKey;
+FrameCache::frame_key FrameCache::sNextKey;
+FrameCache::layer_result FrameCache::sResult[MAX_CACHED_LAYERS];
+unsigned int FrameCache::sHits = 0;
+unsigned int FrameCache::sMisses = 0;
+
+void FrameCache::init(hwc_context_t *ctx) {
+    char property[PROPERTY_VALUE_MAX];
+    sEnabled = true;
+    if((property_get("debug.hwc.framecache", property, NULL) > 0) &&
+       (!strncmp(property, "0", PROPERTY_VALUE_MAX) ||
+        (!strncasecmp(property,"false", PROPERTY_VALUE_MAX )))) {
+        sEnabled = false;
+    }
+    reset();
+    ALOGD_IF(FRAMECACHE_DEBUG, "%s: frame cache %s", __FUNCTION__,
+             sEnabled ? "enabled" : "disabled");
+}
+
+void FrameCache::reset() {
+    sValid = false;
+    sNextValid = false;
+}
+
+//Order dependent hash of the visible rects
+uint32_t FrameCache::hashRegion(const hwc_region_t& region) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < region.numRects; i++) {
+        const hwc_rect_t& r = region.rects[i];
+        hash = (hash ^ (uint32_t)r.left) * 16777619u;
+        hash = (hash ^ (uint32_t)r.top) * 16777619u;
+        hash = (hash ^ (uint32_t)r.right) * 16777619u;
+        hash = (hash ^ (uint32_t)r.bottom) * 16777619u;
+    }
+    return hash;
+}
+
+bool FrameCache::makeKey(hwc_context_t *ctx, const hwc_layer_list_t *list,
+                         frame_key& key) {
+    if(list->numHwLayers > MAX_CACHED_LAYERS)
+        return false;
+
+    //Keys are compared with memcmp, clear the padding
+    memset(&key, 0, sizeof(key));
+    key.numHwLayers = list->numHwLayers;
+    key.generation = ctx->compGeneration;
+    key.extDisplay = ctx->mExtDisplay->getExternalDisplay();
+    key.orientation = ctx->deviceOrientation;
+    key.compositionType =
+        qdutils::QCCompositionType::getInstance().getCompositionType();
+
+    for(size_t i = 0; i < list->numHwLayers; i++) {
+        const hwc_layer_t *layer = &list->hwLayers[i];
+        const private_handle_t *hnd = (const private_handle_t *)layer->handle;
+        layer_key& lk = key.layers[i];
+        if(hnd) {
+            lk.format = hnd->format;
+            lk.width = hnd->width;
+            lk.height = hnd->height;
+            lk.size = hnd->size;
+            lk.bufferType = hnd->bufferType;
+            lk.privFlags = hnd->flags;
+            MetaData_t *metadata = (MetaData_t *)hnd->base_metadata;
+            if(isYuvBuffer(hnd) && metadata &&
+               (metadata->operation & PP_PARAM_INTERLACED)) {
+                lk.interlaced = metadata->interlaced ? 1 : 0;
+            }
+        }
+        lk.skip = layer->flags & HWC_SKIP_LAYER;
+        lk.transform = layer->transform;
+        lk.blending = layer->blending;
+        lk.sourceCrop = layer->sourceCrop;
+        lk.displayFrame = layer->displayFrame;
+        lk.numVisibleRects = layer->visibleRegionScreen.numRects;
+        lk.visibleHash = hashRegion(layer->visibleRegionScreen);
+    }
+    return true;
+}
+
+bool FrameCache::lookup(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    sNextValid = false;
+    if(!sEnabled)
+        return false;
+
+    if(list->flags & HWC_GEOMETRY_CHANGED) {
+        sValid = false;
+    }
+
+    if(!makeKey(ctx, list, sNextKey)) {
+        ALOGD_IF(FRAMECACHE_DEBUG, "%s: %d layers, not cached", __FUNCTION__,
+                 list->numHwLayers);
+        sValid = false;
+        return false;
+    }
+    sNextValid = true;
+
+    if(!sValid || memcmp(&sKey, &sNextKey, sizeof(sKey))) {
+        sMisses++;
+        ALOGD_IF(FRAMECACHE_DEBUG, "%s: miss, hits=%u misses=%u",
+                 __FUNCTION__, sHits, sMisses);
+        return false;
+    }
+
+    //Same frame, hand back the decisions made the last time
+    for(size_t i = 0; i < list->numHwLayers; i++) {
+        hwc_layer_t *layer = &list->hwLayers[i];
+        layer->compositionType = sResult[i].compositionType;
+        layer->hints = sResult[i].hints;
+        layer->flags = sResult[i].flags;
+    }
+    ctx->overlayInUse = sOverlayInUse;
+    sHits++;
+    return true;
+}
+
+void FrameCache::save(hwc_context_t *ctx, const hwc_layer_list_t *list) {
+    if(!sNextValid) {
+        sValid = false;
+        return;
+    }
+    sNextValid = false;
+
+    memcpy(&sKey, &sNextKey, sizeof(sKey));
+    for(size_t i = 0; i < list->numHwLayers; i++) {
+        const hwc_layer_t *layer = &list->hwLayers[i];
+        sResult[i].compositionType = layer->compositionType;
+        sResult[i].hints = layer->hints;
+        sResult[i].flags = layer->flags;
+    }
+    sOverlayInUse = ctx->overlayInUse;
+    sValid = true;
+}
+
+}; //namespace qhwc
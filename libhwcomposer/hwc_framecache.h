@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HWC_FRAMECACHE_H
+#define HWC_FRAMECACHE_H
+
+#include "hwc_utils.h"
+
+#define MAX_CACHED_LAYERS 16
+
+namespace qhwc {
+//Remembers the composition decisions of the last prepared frame so that an
+//identical frame can skip the strategy chain in hwc_prepare. Only what the
+//strategies look at is compared: buffer properties, not the handles
+//themselves, since those rotate between the queued buffers every frame.
+class FrameCache {
+public:
+    //Reads the cache configuration
+    static void init(hwc_context_t *ctx);
+    //Returns true and restores the last decisions if list matches the last
+    //prepared frame
+    static bool lookup(hwc_context_t *ctx, hwc_layer_list_t *list);
+    //Records the decisions made for list by the strategies
+    static void save(hwc_context_t *ctx, const hwc_layer_list_t *list);
+    //Drops the cached frame, next lookup will miss
+    static void reset();
+private:
+    struct layer_key {
+        //Buffer properties
+        int format;
+        int width;
+        int height;
+        int size;
+        int bufferType;
+        int privFlags;
+        int interlaced;
+        //Layer geometry
+        uint32_t skip;
+        uint32_t transform;
+        int32_t blending;
+        hwc_rect_t sourceCrop;
+        hwc_rect_t displayFrame;
+        size_t numVisibleRects;
+        uint32_t visibleHash;
+    };
+    struct layer_result {
+        int32_t compositionType;
+        uint32_t hints;
+        uint32_t flags;
+    };
+    struct frame_key {
+        size_t numHwLayers;
+        int32_t generation;
+        int extDisplay;
+        int orientation;
+        int compositionType;
+        layer_key layers[MAX_CACHED_LAYERS];
+    };
+
+    //Builds the key of list, returns false if list can not be cached
+    static bool makeKey(hwc_context_t *ctx, const hwc_layer_list_t *list,
+                        frame_key& key);
+    static uint32_t hashRegion(const hwc_region_t& region);
+
+    //Flags if this feature is on.
+    static bool sEnabled;
+    //Flags if sKey and sResult hold a prepared frame
+    static bool sValid;
+    //Flags if sNextKey holds the key of the frame being prepared
+    static bool sNextValid;
+    static bool sOverlayInUse;
+    static frame_key sKey;
+    static frame_key sNextKey;
+    static layer_result sResult[MAX_CACHED_LAYERS];
+    static unsigned int sHits;
+    static unsigned int sMisses;
+};
+
+}; //namespace qhwc
+
+#endif //HWC_FRAMECACHE_H
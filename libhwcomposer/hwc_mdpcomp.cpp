@@ -17,7 +17,9 @@
  */
 
 #include <cutils/properties.h>
+#include <cutils/atomic.h>
 #include <mdp_version.h>
+#include <frame_trace.h>
 #include "hwc_mdpcomp.h"
 #include "hwc_qbuf.h"
 #include "hwc_external.h"
@@ -28,7 +30,7 @@ namespace qhwc {
 
 /****** Class PipeMgr ***********/
 
-void inline PipeMgr::reset() {
+void PipeMgr::reset() {
     mVGPipes = MAX_VG;
     mVGUsed = 0;
     mVGIndex = 0;
@@ -37,6 +39,12 @@ void inline PipeMgr::reset() {
     mRGBIndex = MAX_VG;
     mTotalAvail = mVGPipes + mRGBPipes;
     memset(&mStatus, 0x0 , sizeof(int)*mTotalAvail);
+#if !SUPPORT_4LAYER
+    //Without the variable pipe, VAR_INDEX has no overlay dest, keep it off
+    //the free list so solve does not hand it out
+    mRGBPipes--;
+    mTotalAvail--;
+#endif
 }
 
 int PipeMgr::req_for_pipe(int pipe_req) {
@@ -92,6 +100,50 @@ int PipeMgr::assign_pipe(int pipe_pref) {
     };
 }
 
+/*
+ * With two pipe types, a layer that can use either one only competes for
+ * the pipes the single type layers leave over, so counting them is enough
+ * to tell if an assignment exists. The flexible layers then take the spare
+ * RGB pipes first and keep the VG pipes for YUV and scaled layers.
+ */
+bool PipeMgr::solve(const int* caps, int count, int* pipe_req) {
+    int vgOnly = 0, rgbOnly = 0;
+
+    for(int i = 0; i < count; i++) {
+        switch(caps[i]) {
+            case PIPE_CAP_VG:
+                vgOnly++;
+                break;
+            case PIPE_CAP_RGB:
+                rgbOnly++;
+                break;
+            case PIPE_CAP_VG | PIPE_CAP_RGB:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if(vgOnly > mVGPipes || rgbOnly > mRGBPipes ||
+            count > mVGPipes + mRGBPipes)
+        return false;
+
+    int rgbSpare = mRGBPipes - rgbOnly;
+    for(int i = 0; i < count; i++) {
+        if(caps[i] == PIPE_CAP_VG) {
+            pipe_req[i] = PIPE_REQ_VG;
+        } else if(caps[i] == PIPE_CAP_RGB) {
+            pipe_req[i] = PIPE_REQ_RGB;
+        } else if(rgbSpare) {
+            pipe_req[i] = PIPE_REQ_RGB;
+            rgbSpare--;
+        } else {
+            pipe_req[i] = PIPE_REQ_VG;
+        }
+    }
+    return true;
+}
+
 /****** Class MDPComp ***********/
 
 MDPComp::State MDPComp::sMDPCompState = MDPCOMP_OFF;
@@ -102,6 +154,7 @@ bool MDPComp::sIdleFallBack = false;
 bool MDPComp::sDebugLogs = false;
 int MDPComp::sSkipCount = 0;
 int MDPComp::sMaxLayers = 0;
+int MDPComp::sFBLayerCount = 0;
 
 bool MDPComp::deinit() {
     //XXX: Tear down MDP comp state
@@ -123,6 +176,8 @@ void MDPComp::timeout_handler(void *udata) {
         return;
     }
     sIdleFallBack = true;
+    //The fallback changes the composition of an otherwise unchanged frame
+    android_atomic_inc(&ctx->compGeneration);
     /* Trigger SF to redraw the current frame */
     proc->invalidate(proc);
 }
@@ -138,8 +193,7 @@ void MDPComp::reset_comp_type(hwc_layer_list_t* list) {
 
 void MDPComp::reset( hwc_context_t *ctx, hwc_layer_list_t* list ) {
     sCurrentFrame.count = 0;
-    free(sCurrentFrame.pipe_layer);
-    sCurrentFrame.pipe_layer = NULL;
+    sCurrentFrame.fb_count = 0;
 
     //Reset MDP pipes
     sPipeMgr.reset();
@@ -291,7 +345,6 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_layer_t *layer,
         ovutils::eTransform orient =
             static_cast<ovutils::eTransform>(layer->transform);
 
-        ov.setTransform(orient, dest);
         ovutils::Whf info(hnd->width, hnd->height, hnd->format, hnd->size);
         ovutils::eMdpFlags mdpFlags = mdp_info.isVG ? ovutils::OV_MDP_PIPE_SHARE
                                                    : ovutils::OV_MDP_FLAGS_NONE;
@@ -303,11 +356,15 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_layer_t *layer,
                     ovutils::OV_MDP_BLEND_FG_PREMULT);
         }
 
+        //Rotated layers are fetched from the output of the pipe's rotator
+        ovutils::eRotFlags rotFlags = layer->transform ?
+                ovutils::ROT_FLAG_ENABLED : ovutils::ROT_FLAG_DISABLED;
+
         ovutils::PipeArgs parg(mdpFlags,
                                info,
                                zOrder,
                                isFG,
-                               ovutils::ROT_FLAG_DISABLED);
+                               rotFlags);
 
         ovutils::PipeArgs pargs[MAX_PIPES] = { parg, parg, parg };
         if (!ov.setSource(pargs, dest)) {
@@ -321,6 +378,12 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_layer_t *layer,
             return -1;
         }
 
+        //After setSource, which resets the pipe's rotator use
+        if (!ov.setTransform(orient, dest)) {
+            ALOGE("%s: setTransform failed", __FUNCTION__);
+            return -1;
+        }
+
         ovutils::Dim dim(dst.left, dst.top, dst_w, dst_h);
         if (!ov.setPosition(dim, dest)) {
             ALOGE("%s: setPosition failed", __FUNCTION__);
@@ -342,12 +405,13 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_layer_t *layer,
 
 /*
  * MDPComp not possible when
- * 1. We have more than sMaxLayers
+ * 1. The list is empty
  * 2. External display connected
  * 3. Composition is triggered by
  *    Idle timer expiry
- * 4. Rotation is  needed
- * 5. Overlay in use
+ * 4. Overlay in use
+ * Layers MDP cannot fetch, and layers beyond sMaxLayers, are left to the FB
+ * by get_fb_split.
  */
 
 bool MDPComp::is_doable(hwc_composer_device_t *dev, hwc_layer_list_t* list) {
@@ -359,7 +423,7 @@ bool MDPComp::is_doable(hwc_composer_device_t *dev, hwc_layer_list_t* list) {
     }
 
     //Number of layers
-    if(list->numHwLayers < 1 || list->numHwLayers > (uint32_t) sMaxLayers) {
+    if(list->numHwLayers < 1) {
         ALOGD_IF(isDebug(), "%s: Unsupported number of layers",__FUNCTION__);
         return false;
     }
@@ -377,19 +441,23 @@ bool MDPComp::is_doable(hwc_composer_device_t *dev, hwc_layer_list_t* list) {
         return false;
     }
 
-    //MDP composition is not efficient if rotation is needed.
-    for(unsigned int i = 0; i < list->numHwLayers; ++i) {
-        if(list->hwLayers[i].transform) {
-                ALOGD_IF(isDebug(), "%s: orientation involved",__FUNCTION__);
-                return false;
-        }
-    }
-
     return true;
 }
 
 void MDPComp::setMDPCompLayerFlags(hwc_layer_list_t* list) {
 
+    //In mixed mode the FB holds the layers below the pipes, it must not be
+    //cleared under them
+    bool clearFB = (sCurrentFrame.fb_count == 0);
+
+    for(int index = 0 ; index < sCurrentFrame.fb_count; index++) {
+        hwc_layer_t* layer = &(list->hwLayers[index]);
+
+        if(layer->compositionType == HWC_OVERLAY)
+            layer->compositionType = HWC_FRAMEBUFFER;
+        layer->hints &= ~HWC_HINT_CLEAR_FB;
+    }
+
     for(int index = 0 ; index < sCurrentFrame.count; index++ )
     {
         int layer_index = sCurrentFrame.pipe_layer[index].layer_index;
@@ -398,7 +466,10 @@ void MDPComp::setMDPCompLayerFlags(hwc_layer_list_t* list) {
 
             layer->flags |= HWC_MDPCOMP;
             layer->compositionType = HWC_OVERLAY;
-            layer->hints |= HWC_HINT_CLEAR_FB;
+            if(clearFB)
+                layer->hints |= HWC_HINT_CLEAR_FB;
+            else
+                layer->hints &= ~HWC_HINT_CLEAR_FB;
         }
     }
 }
@@ -417,71 +488,144 @@ void MDPComp::get_layer_info(hwc_layer_t* layer, int& flags) {
     if(layer->blending != HWC_BLENDING_NONE)
         flags |= MDPCOMP_LAYER_BLEND;
 
+    if(isYuvBuffer(hnd))
+        flags |= MDPCOMP_LAYER_YUV;
+
     int dst_w, dst_h;
     getLayerResolution(layer, dst_w, dst_h);
 
     hwc_rect_t sourceCrop = layer->sourceCrop;
-    const int src_w = sourceCrop.right - sourceCrop.left;
-    const int src_h = sourceCrop.bottom - sourceCrop.top;
+    int src_w = sourceCrop.right - sourceCrop.left;
+    int src_h = sourceCrop.bottom - sourceCrop.top;
+    //The pipe scales the rotator output
+    if(layer->transform & HAL_TRANSFORM_ROT_90) {
+        int tmp = src_w;
+        src_w = src_h;
+        src_h = tmp;
+    }
     if(((src_w > dst_w) || (src_h > dst_h))) {
         flags |= MDPCOMP_LAYER_DOWNSCALE;
     }
+    if((src_w != dst_w) || (src_h != dst_h))
+        flags |= MDPCOMP_LAYER_SCALE;
+
+    if(layer->transform) {
+        flags |= MDPCOMP_LAYER_TRANSFORM;
+
+        //Screen clipping trims the crop in source orientation, which is
+        //wrong once the rotator has turned the buffer
+        hwc_rect_t dst = layer->displayFrame;
+        const int fbWidth =
+                ovutils::FrameBufferInfo::getInstance()->getWidth();
+        const int fbHeight =
+                ovutils::FrameBufferInfo::getInstance()->getHeight();
+        if(dst.left < 0 || dst.top < 0 ||
+                dst.right > fbWidth || dst.bottom > fbHeight)
+            flags |= MDPCOMP_LAYER_ROT_CLIPPED;
+    }
 }
 
-int MDPComp::mark_layers(hwc_layer_list_t* list, layer_mdp_info* layer_info,
-                                                    frame_info& current_frame) {
+int MDPComp::get_pipe_caps(int layer_prop) {
+    if(layer_prop & MDPCOMP_LAYER_FB_ONLY)
+        return 0;
 
-    int layer_count = list->numHwLayers;
+    bool isMDP42 = (qdutils::MDPVersion::getInstance().getMDPVersion() >=
+                    qdutils::MDP_V4_2);
 
-    if(layer_count > sMaxLayers) {
-        if(!sPipeMgr.req_for_pipe(PIPE_REQ_FB)) {
-            ALOGE("%s: binding var pipe to FB failed!!", __FUNCTION__);
+    //Downscaling a blended layer only works on the RGB pipes of MDP 4.2
+    if((layer_prop & MDPCOMP_LAYER_DOWNSCALE) &&
+                    (layer_prop & MDPCOMP_LAYER_BLEND)) {
+        if(!isMDP42 || (layer_prop & MDPCOMP_LAYER_YUV))
             return 0;
-        }
+        return PIPE_CAP_RGB;
     }
 
-    //Parse layers from higher z-order
-    for(int index = layer_count - 1 ; index >= 0; index-- ) {
-        hwc_layer_t* layer = &list->hwLayers[index];
+    //RGB pipes cannot fetch YUV, and only scale from MDP 4.2 on
+    if((layer_prop & MDPCOMP_LAYER_YUV) ||
+            ((layer_prop & MDPCOMP_LAYER_SCALE) && !isMDP42))
+        return PIPE_CAP_VG;
+
+    return PIPE_CAP_VG | PIPE_CAP_RGB;
+}
 
+/*
+ * The FB is the base stage of the mixer, below every pipe. So the layers it
+ * composes are a range at the bottom of the list, the ones above go to MDP
+ * pipes. The range has to cover every layer MDP cannot fetch; above that the
+ * lowest split PipeMgr::solve finds pipes for offloads the most pixels,
+ * since each higher split offloads a subset of it. Rotated layers beyond
+ * what the rotator takes per frame count as FB only.
+ * Returns the number of layers left to the FB, -1 if no layer can use MDP.
+ * pipe_req gets the request for each MDP layer, from the split up, and
+ * sPipeMgr is left reset for that split.
+ */
+int MDPComp::get_fb_split(hwc_layer_list_t* list, int* pipe_req) {
+    int layer_count = list->numHwLayers;
+    int max_mdp = (sMaxLayers < MAX_PIPES) ? sMaxLayers : MAX_PIPES;
+    int base = layer_count - max_mdp;
+    if(base < 0)
+        base = 0;
+
+    //Pipe types of the layers that may go to MDP
+    int caps[MAX_PIPES];
+    int split = base;
+    int rot_count = 0;
+    for(int index = layer_count - 1; index >= base; index--) {
         int layer_prop = 0;
-        get_layer_info(layer, layer_prop);
+        get_layer_info(&list->hwLayers[index], layer_prop);
+        caps[index - base] = get_pipe_caps(layer_prop);
 
-        ALOGD_IF(isDebug(),"%s: prop for layer [%d]: %x", __FUNCTION__,
-                                                             index, layer_prop);
+        if(caps[index - base] && (layer_prop & MDPCOMP_LAYER_TRANSFORM) &&
+                (++rot_count > MAX_ROT_LAYERS))
+            caps[index - base] = 0;
 
-        //Both in cases of NON-CONTIGUOUS memory or SKIP layer,
-        //current version of mdp composition falls back completely to FB
-        //composition.
-        //TO DO: Support dual mode composition
+        ALOGD_IF(isDebug(),"%s: prop for layer [%d]: %x caps: %x",
+                 __FUNCTION__, index, layer_prop, caps[index - base]);
 
-        if(layer_prop & MDPCOMP_LAYER_UNSUPPORTED_MEM) {
-            ALOGD_IF(isDebug(), "%s: Non contigous memory",__FUNCTION__);
-            return MDPCOMP_ABORT;
+        if(!caps[index - base]) {
+            split = index + 1;
+            break;
         }
+    }
 
-        if(layer_prop & MDPCOMP_LAYER_SKIP) {
-            ALOGD_IF(isDebug(), "%s:skip layer",__FUNCTION__);
-            return MDPCOMP_ABORT;
+    for(; split < layer_count; split++) {
+        sPipeMgr.reset();
+#if SUPPORT_4LAYER
+        //The FB is fetched by the variable pipe, below the MDP layers
+        if(split && !sPipeMgr.req_for_pipe(PIPE_REQ_FB))
+            continue;
+#endif
+        if(sPipeMgr.solve(&caps[split - base], layer_count - split,
+                          pipe_req)) {
+            ALOGD_IF(isDebug(), "%s: %d layers to FB, %d to MDP", __FUNCTION__,
+                                              split, layer_count - split);
+            return split;
         }
+    }
 
-        //Request for MDP pipes
-        int pipe_pref = PIPE_REQ_VG;
+    ALOGD_IF(isDebug(), "%s: no layer can use MDP", __FUNCTION__);
+    return -1;
+}
 
-        if((layer_prop & MDPCOMP_LAYER_DOWNSCALE) &&
-                        (layer_prop & MDPCOMP_LAYER_BLEND)) {
-            if (qdutils::MDPVersion::getInstance().getMDPVersion() >=
-                    qdutils::MDP_V4_2) {
-                pipe_pref = PIPE_REQ_RGB;
-            } else {
-                return MDPCOMP_ABORT;
-            }
-         }
+int MDPComp::mark_layers(hwc_layer_list_t* list, layer_mdp_info* layer_info,
+                                                    frame_info& current_frame) {
+
+    int layer_count = list->numHwLayers;
 
-        int allocated_pipe = sPipeMgr.req_for_pipe( pipe_pref);
+    //Skip layers, non contiguous memory and the like are composed into the
+    //FB along with every layer below them, the rest use MDP pipes.
+    int pipe_req[MAX_PIPES];
+    int split = get_fb_split(list, pipe_req);
+    if(split < 0)
+        return MDPCOMP_ABORT;
+
+    //Parse layers from higher z-order
+    current_frame.fb_count = split;
+    for(int index = layer_count - 1 ; index >= split; index-- ) {
+        int allocated_pipe = sPipeMgr.req_for_pipe(pipe_req[index - split]);
         if(allocated_pipe) {
-          layer_info[index].can_use_mdp = true;
-          layer_info[index].pipe_pref = allocated_pipe;
+          layer_info[index - split].can_use_mdp = true;
+          layer_info[index - split].pipe_pref = allocated_pipe;
           current_frame.count++;
         }else {
             ALOGE("%s: pipe marking in mark layer fails for : %d",
@@ -512,26 +656,28 @@ bool MDPComp::alloc_layer_pipes(hwc_layer_list_t* list,
                             __FUNCTION__, (layer_count != mdp_count),
                             layer_count, mdp_count, fallback_count);
 
-    for(int index = 0 ; index < layer_count ; index++ ) {
-        hwc_layer_t* layer = &list->hwLayers[index];
+    //layer_info starts at the first layer above the FB
+    for(int index = fallback_count ; index < layer_count ; index++ ) {
+        layer_mdp_info& mdp_info = layer_info[index - fallback_count];
 
-        if(layer_info[index].can_use_mdp) {
+        if(mdp_info.can_use_mdp) {
              pipe_layer_pair& info = current_frame.pipe_layer[frame_pipe_count];
              mdp_pipe_info& pipe_info = info.pipe_index;
 
-             pipe_info.index = sPipeMgr.assign_pipe(layer_info[index].pipe_pref);
-             pipe_info.isVG = (layer_info[index].pipe_pref == PIPE_REQ_VG);
-             pipe_info.isFG = (frame_pipe_count == 0);
+             pipe_info.index = sPipeMgr.assign_pipe(mdp_info.pipe_pref);
+             pipe_info.isVG = (mdp_info.pipe_pref == PIPE_REQ_VG);
+             //The lowest pipe hides the FB only when nothing is left in it
+             pipe_info.isFG = (frame_pipe_count == 0) && !fallback_count;
              /* if VAR pipe is attached to FB, FB will be updated with
                 VSYNC WAIT flag, so no need to set VSYNC WAIT for any
                 bypass pipes. if not, set VSYNC WAIT to the last updating pipe*/
              pipe_info.vsync_wait =
                  (sPipeMgr.getStatus(VAR_INDEX) == PIPE_IN_FB_MODE) ? false:
                                       (frame_pipe_count == (mdp_count - 1));
-             /* All the layers composed on FB will have MDP zorder 0, so start
-                assigning from  1*/
-                pipe_info.z_order = index -
-                        (fallback_count ? fallback_count - 1 : fallback_count);
+             /* With the FB on the VAR pipe it takes MDP zorder 0, so start
+                assigning from 1 */
+             pipe_info.z_order = frame_pipe_count +
+                 ((sPipeMgr.getStatus(VAR_INDEX) == PIPE_IN_FB_MODE) ? 1 : 0);
 
              info.layer_index = index;
              frame_pipe_count++;
@@ -544,30 +690,22 @@ bool MDPComp::alloc_layer_pipes(hwc_layer_list_t* list,
 bool MDPComp::parse_and_allocate(hwc_context_t* ctx, hwc_layer_list_t* list,
                                                   frame_info& current_frame ) {
 
-    int layer_count = list->numHwLayers;
-
-    /* clear pipe status */
-    sPipeMgr.reset();
+    //Only the layers above the FB split can use MDP, at most one per pipe
+    layer_mdp_info bp_layer_info[MAX_PIPES];
 
-    layer_mdp_info* bp_layer_info = (layer_mdp_info*)
-                                   malloc(sizeof(layer_mdp_info)* layer_count);
-
-    reset_layer_mdp_info(bp_layer_info, layer_count);
+    reset_layer_mdp_info(bp_layer_info, MAX_PIPES);
 
     /* iterate through layer list to mark candidate */
-    if(mark_layers(list, bp_layer_info, current_frame) == MDPCOMP_ABORT) {
-        free(bp_layer_info);
+    if(mark_layers(list, bp_layer_info, current_frame) != MDPCOMP_SUCCESS) {
         current_frame.count = 0;
+        current_frame.fb_count = 0;
         ALOGE_IF(isDebug(), "%s:mark_layers failed!!", __FUNCTION__);
         return false;
     }
-    current_frame.pipe_layer = (pipe_layer_pair*)
-                          malloc(sizeof(pipe_layer_pair) * current_frame.count);
 
     /* allocate MDP pipes for marked layers */
     alloc_layer_pipes( list, bp_layer_info, current_frame);
 
-    free(bp_layer_info);
     return true;
 }
 #if SUPPORT_4LAYER
@@ -613,6 +751,7 @@ bool MDPComp::setup(hwc_context_t* ctx, hwc_layer_list_t* list) {
 
     frame_info &current_frame = sCurrentFrame;
     current_frame.count = 0;
+    current_frame.fb_count = 0;
 
     if(!ctx) {
        ALOGE("%s: invalid context", __FUNCTION__);
@@ -707,6 +846,7 @@ int MDPComp::draw(hwc_context_t *ctx, hwc_layer_list_t* list) {
             continue;
         }
 
+        qdutils::TraceScope trace(qdutils::TRACE_MDPCOMP_LAYER, i);
         int data_index = getLayerIndex(layer);
         mdp_pipe_info& pipe_info =
                           sCurrentFrame.pipe_layer[data_index].pipe_index;
@@ -814,6 +954,29 @@ bool MDPComp::init(hwc_context_t *dev) {
     return true;
 }
 
+bool MDPComp::isFeasible(hwc_context_t *ctx, hwc_layer_list_t* list) {
+
+    if(!isEnabled())
+        return false;
+
+    bool doable = is_doable(&ctx->device, list);
+
+    //Idle fallback is for one frame, configure may not run to clear it
+    sIdleFallBack = false;
+
+    if(!doable)
+        return false;
+
+    //Same split as mark_layers will make
+    int pipe_req[MAX_PIPES];
+    int split = get_fb_split(list, pipe_req);
+    if(split < 0)
+        return false;
+
+    sFBLayerCount = split;
+    return true;
+}
+
 bool MDPComp::configure(hwc_composer_device_t *dev,  hwc_layer_list_t* list) {
 
     if(!isEnabled()) {
@@ -32,6 +32,8 @@
 #define MAX_RGB 2
 #define VAR_INDEX 3
 #define MAX_PIPES (MAX_VG + MAX_RGB)
+//The MDP rotator is one block shared by all the pipes
+#define MAX_ROT_LAYERS 1
 #define HWC_MDPCOMP_INDEX_MASK 0x00000030
 
 
@@ -54,6 +56,12 @@ enum {
     PIPE_REQ_FB,
 };
 
+// pipe types a layer can be fetched by
+enum {
+    PIPE_CAP_VG = 1,
+    PIPE_CAP_RGB = 2,
+};
+
 // MDP Comp Status
 enum {
     MDPCOMP_SUCCESS = 0,
@@ -78,6 +86,11 @@ public:
     //Allocate requested pipe and update availablity
     int assign_pipe(int pipe_pref);
 
+    //Picks a pipe request for each of count layers, from the PIPE_CAP_*
+    //types each one can use, such that all of them get one of the free
+    //pipes. Returns false if there is no such assignment.
+    bool solve(const int* caps, int count, int* pipe_req);
+
     // Get/Set pipe status
     void setStatus(int pipe_index, int pipe_status) {
         mStatus[pipe_index] = pipe_status;
@@ -109,6 +122,17 @@ class MDPComp {
         MDPCOMP_LAYER_DOWNSCALE = 2,
         MDPCOMP_LAYER_SKIP = 4,
         MDPCOMP_LAYER_UNSUPPORTED_MEM = 8,
+        MDPCOMP_LAYER_TRANSFORM = 16,
+        MDPCOMP_LAYER_SCALE = 32,
+        MDPCOMP_LAYER_YUV = 64,
+        MDPCOMP_LAYER_ROT_CLIPPED = 128,
+    };
+
+    //Layers that only the GPU can compose
+    enum {
+        MDPCOMP_LAYER_FB_ONLY = MDPCOMP_LAYER_SKIP |
+                                MDPCOMP_LAYER_UNSUPPORTED_MEM |
+                                MDPCOMP_LAYER_ROT_CLIPPED,
     };
 
     struct mdp_pipe_info {
@@ -127,7 +151,10 @@ class MDPComp {
 
     struct frame_info {
         int count;
-        struct pipe_layer_pair* pipe_layer;
+        //layers at the bottom of the list left to the FB
+        int fb_count;
+        //kept inline, the frame is set up without touching the heap
+        struct pipe_layer_pair pipe_layer[MAX_PIPES];
 
     };
 
@@ -142,6 +169,7 @@ class MDPComp {
     static PipeMgr sPipeMgr;
     static int sSkipCount;
     static int sMaxLayers;
+    static int sFBLayerCount;
     static bool sDebugLogs;
     static bool sIdleFallBack;
 
@@ -153,6 +181,12 @@ public:
     static bool init(hwc_context_t *ctx);
     static bool deinit();
 
+    /* checks if some layers of the frame can be given MDP pipes */
+    static bool isFeasible(hwc_context_t *ctx, hwc_layer_list_t* list);
+
+    /* layers left to the FB by the last isFeasible */
+    static int getFBLayerCount() { return sFBLayerCount; }
+
     /*sets up mdp comp for the current frame */
     static bool configure(hwc_composer_device_t *ctx,  hwc_layer_list_t* list);
 
@@ -187,7 +221,14 @@ private:
     /* parses layer for properties affecting mdp comp */
     static void get_layer_info(hwc_layer_t* layer, int& flags);
 
-    /* iterates through layer list to choose candidate to use overlay */
+    /* PIPE_CAP_* types that can fetch a layer, 0 if it has to go to FB */
+    static int  get_pipe_caps(int layer_prop);
+
+    /* splits the list between FB and MDP, returns the FB layer count */
+    static int  get_fb_split(hwc_layer_list_t* list, int* pipe_req);
+
+    /* iterates through layer list to choose candidate to use overlay,
+       layer_info is indexed from the first layer above the FB */
     static int  mark_layers(hwc_layer_list_t* list, layer_mdp_info* layer_info,
                                                   frame_info& current_frame);
     static bool parse_and_allocate(hwc_context_t* ctx, hwc_layer_list_t* list,
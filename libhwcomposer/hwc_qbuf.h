@@ -37,6 +37,8 @@ class QueuedBufferStore {
     void unlockAllPrevious();
     //Unlocks previous as well as current, useful in suspend case
     void unlockAll();
+    //True if the next unlockAllPrevious releases buffers
+    bool hasPrevious() const { return prevCount > 0; }
 
     private:
     QueuedBufferStore& operator=(const QueuedBufferStore&);
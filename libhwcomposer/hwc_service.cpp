@@ -29,6 +29,7 @@
 
 #include <hwc_service.h>
 #include <hwc_utils.h>
+#include <frame_trace.h>
 
 #define HWC_SERVICE_DEBUG 0
 
@@ -110,6 +111,18 @@ status_t HWComposerService::getExternalDisplay(int *dispType) {
     return NO_ERROR;
 }
 
+status_t HWComposerService::setFrameTrace(int enable) {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "enable=%d", enable);
+    qdutils::FrameTrace::getInstance().setEnabled(enable != 0);
+    return NO_ERROR;
+}
+
+status_t HWComposerService::getFrameTrace(int format, String8 *trace) {
+    ALOGD_IF(HWC_SERVICE_DEBUG, "format=%d", format);
+    qdutils::FrameTrace::getInstance().dump(*trace, format);
+    return NO_ERROR;
+}
+
 HWComposerService* HWComposerService::getInstance()
 {
     if(!sHwcService) {
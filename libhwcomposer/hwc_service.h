@@ -59,6 +59,9 @@ public:
     virtual android::status_t setHPDStatus(int enable);
     virtual android::status_t setResolutionMode(int resMode);
     virtual android::status_t setActionSafeDimension(int w, int h);
+    virtual android::status_t setFrameTrace(int enable);
+    virtual android::status_t getFrameTrace(int format,
+                                            android::String8 *trace);
     void setHwcContext(hwc_context_t *hwcCtx);
 
 private:
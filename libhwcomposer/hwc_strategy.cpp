@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cutils/properties.h>
+#include <overlay.h>
+#include "hwc_strategy.h"
+#include "hwc_video.h"
+#include "hwc_extonly.h"
+#include "hwc_uimirror.h"
+#include "hwc_mdpcomp.h"
+#include "hwc_external.h"
+
+namespace qhwc {
+
+//Setup charge of composing one layer with the GPU, in bytes
+#define COST_GPU_LAYER    (16 * 1024)
+//Setup charge of programming one MDP pipe, in bytes
+#define COST_PIPE_LAYER   (4 * 1024)
+//Setup charge of a rotator session, in bytes
+#define COST_ROT_LAYER    (8 * 1024)
+//Copybit moves a byte at this many times the GPU cost...
+#define COST_C2D_WEIGHT   2
+//...and this many times more again when it has to scale
+#define COST_C2D_SCALE    2
+
+//Static Members
+const CompStrategy::plan CompStrategy::sPlans[PLAN_COUNT] = {
+    { "video",    videoFeasible,    videoCost,    videoApply },
+    { "extonly",  extOnlyFeasible,  extOnlyCost,  extOnlyApply },
+    { "uimirror", uiMirrorFeasible, uiMirrorCost, uiMirrorApply },
+    { "mdpcomp",  mdpCompFeasible,  mdpCompCost,  mdpCompApply },
+    { "fb",       fbFeasible,       fbCost,       fbApply },
+};
+int CompStrategy::sYuvCount = 0;
+int CompStrategy::sYuvLayerIndex = -1;
+bool CompStrategy::sIsYuvLayerSkip = false;
+int CompStrategy::sExtLayerIndex = -1;
+CompStrategy::layer_cost CompStrategy::sYuvCost;
+CompStrategy::layer_cost CompStrategy::sExtCost;
+uint64_t CompStrategy::sGpuTotal = 0;
+uint64_t CompStrategy::sRGBBlitCost = 0;
+uint64_t CompStrategy::sRGBGpuCost = 0;
+uint64_t CompStrategy::sFbScanout = 0;
+uint64_t CompStrategy::sGpuFrameCost = 0;
+uint64_t CompStrategy::sMdpCompCost = 0;
+bool CompStrategy::sDebugLogs = false;
+
+static int getBitsPerPixel(const private_handle_t *hnd, int format) {
+    if(isYuvBuffer(hnd))
+        return 12;
+    switch(format) {
+        case HAL_PIXEL_FORMAT_RGB_565:
+        case HAL_PIXEL_FORMAT_RGBA_5551:
+        case HAL_PIXEL_FORMAT_RGBA_4444:
+            return 16;
+        case HAL_PIXEL_FORMAT_RGB_888:
+            return 24;
+        default:
+            return 32;
+    }
+}
+
+void CompStrategy::init(hwc_context_t *ctx) {
+    char property[PROPERTY_VALUE_MAX];
+
+    sDebugLogs = false;
+    if(property_get("debug.hwc.strategy.logs", property, NULL) > 0) {
+        if(atoi(property) != 0)
+           sDebugLogs = true;
+    }
+
+    framebuffer_device_t *fbDev = ctx->mFbDev;
+    uint64_t fbArea = fbDev->width * fbDev->height;
+    sFbScanout = fbArea * getBitsPerPixel(NULL, fbDev->format) / 8;
+
+    //Calibrated so that opaque, unscaled 32bpp layers go to copybit
+    //below dynThreshold times the FB area, the old selection rule.
+    sGpuFrameCost = (uint64_t)(ctx->dynThreshold * fbArea * 8 *
+                               (COST_C2D_WEIGHT - 1));
+
+    ALOGD_IF(sDebugLogs, "%s: fb scanout %llu, gpu frame cost %llu",
+             __FUNCTION__, (unsigned long long)sFbScanout,
+             (unsigned long long)sGpuFrameCost);
+}
+
+void CompStrategy::measure(hwc_context_t *ctx, const hwc_layer_t *layer,
+                           layer_cost& cost) {
+    memset(&cost, 0, sizeof(cost));
+    private_handle_t *hnd = (private_handle_t *)layer->handle;
+    if(!hnd)
+        return;
+
+    hwc_rect_t crop = layer->sourceCrop;
+    hwc_rect_t dst = layer->displayFrame;
+    int src_w = crop.right - crop.left;
+    int src_h = crop.bottom - crop.top;
+    int dst_w = dst.right - dst.left;
+    int dst_h = dst.bottom - dst.top;
+    cost.scaled = (src_w != dst_w) || (src_h != dst_h);
+
+    //Only the on screen part of the destination is written
+    calculate_crop_rects(crop, dst, ctx->mFbDev->width, ctx->mFbDev->height);
+    src_w = crop.right - crop.left;
+    src_h = crop.bottom - crop.top;
+    dst_w = dst.right - dst.left;
+    dst_h = dst.bottom - dst.top;
+    if(src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0)
+        return;
+
+    int fbBpp = getBitsPerPixel(NULL, ctx->mFbDev->format);
+    cost.fetch = (uint64_t)src_w * src_h *
+                 getBitsPerPixel(hnd, hnd->format) / 8;
+    cost.write = (uint64_t)dst_w * dst_h * fbBpp / 8;
+    if(layer->blending != HWC_BLENDING_NONE)
+        cost.blend = cost.write;
+}
+
+uint64_t CompStrategy::gpuCost(const layer_cost& cost) {
+    return cost.fetch + cost.write + cost.blend + COST_GPU_LAYER;
+}
+
+//The fetch by the pipe plus the FB clear under the layer
+uint64_t CompStrategy::pipeCost(const layer_cost& cost) {
+    return cost.fetch + cost.write + COST_PIPE_LAYER;
+}
+
+void CompStrategy::setStats(hwc_context_t *ctx, const hwc_layer_list_t *list,
+        int yuvCount, int yuvLayerIndex, bool isYuvLayerSkip,
+        int extLayerIndex) {
+    sYuvCount = yuvCount;
+    sYuvLayerIndex = yuvLayerIndex;
+    sIsYuvLayerSkip = isYuvLayerSkip;
+    sExtLayerIndex = extLayerIndex;
+    memset(&sYuvCost, 0, sizeof(sYuvCost));
+    memset(&sExtCost, 0, sizeof(sExtCost));
+    sGpuTotal = 0;
+    sRGBBlitCost = 0;
+    sRGBGpuCost = 0;
+
+    for (size_t i = 0; i < list->numHwLayers; i++) {
+        const hwc_layer_t *layer = &list->hwLayers[i];
+        private_handle_t *hnd = (private_handle_t *)layer->handle;
+        layer_cost cost;
+        measure(ctx, layer, cost);
+
+        sGpuTotal += gpuCost(cost);
+        if((int)i == yuvLayerIndex)
+            sYuvCost = cost;
+        if((int)i == extLayerIndex)
+            sExtCost = cost;
+        if(hnd && hnd->bufferType == BUFFER_TYPE_UI) {
+            uint64_t bytes = cost.fetch + cost.write + cost.blend;
+            sRGBGpuCost += bytes;
+            sRGBBlitCost += bytes * COST_C2D_WEIGHT *
+                            (cost.scaled ? COST_C2D_SCALE : 1);
+        }
+    }
+}
+
+bool CompStrategy::preferCopybit(hwc_context_t *ctx) {
+    uint64_t gpu = sRGBGpuCost + sGpuFrameCost;
+    ALOGD_IF(sDebugLogs, "%s: copybit %llu gpu %llu", __FUNCTION__,
+             (unsigned long long)sRGBBlitCost, (unsigned long long)gpu);
+    return sRGBBlitCost < gpu;
+}
+
+/* Video overlay: the yuv layer is fetched by a pipe, on the TV too if one is
+ * connected, the rest is composed into the FB. A skipped yuv layer stays in
+ * the FB and is only shown on the TV by the pipe. */
+bool CompStrategy::videoFeasible(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    if(!ctx->mMDP.hasOverlay || sYuvCount != 1)
+        return false;
+    return !sIsYuvLayerSkip || ctx->mExtDisplay->getExternalDisplay();
+}
+
+uint64_t CompStrategy::videoCost(hwc_context_t *ctx) {
+    uint64_t gpu = sGpuTotal;
+    uint64_t pipe = sYuvCost.fetch + COST_PIPE_LAYER;
+    if(!sIsYuvLayerSkip) {
+        gpu -= gpuCost(sYuvCost);
+        pipe = pipeCost(sYuvCost);
+        if(ctx->mExtDisplay->getExternalDisplay())
+            pipe += sYuvCost.fetch + COST_PIPE_LAYER;
+    }
+    return sGpuFrameCost + gpu + pipe + sFbScanout;
+}
+
+bool CompStrategy::videoApply(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    return VideoOverlay::prepare(ctx, list);
+}
+
+/* Ext only: the external only layer is fetched by a pipe for the TV, the
+ * rest is composed into the FB */
+bool CompStrategy::extOnlyFeasible(hwc_context_t *ctx,
+                                   hwc_layer_list_t *list) {
+    return ctx->mMDP.hasOverlay && sExtLayerIndex != -1 &&
+           ctx->mExtDisplay->getExternalDisplay();
+}
+
+uint64_t CompStrategy::extOnlyCost(hwc_context_t *ctx) {
+    return sGpuFrameCost + sGpuTotal - gpuCost(sExtCost) +
+           sExtCost.fetch + COST_PIPE_LAYER + sFbScanout;
+}
+
+bool CompStrategy::extOnlyApply(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    return ExtOnly::prepare(ctx, list);
+}
+
+/* UI mirror: everything is composed into the FB, which is scanned out a
+ * second time for the TV */
+bool CompStrategy::uiMirrorFeasible(hwc_context_t *ctx,
+                                    hwc_layer_list_t *list) {
+    return ctx->mMDP.hasOverlay && ctx->mExtDisplay->getExternalDisplay();
+}
+
+uint64_t CompStrategy::uiMirrorCost(hwc_context_t *ctx) {
+    return sGpuFrameCost + sGpuTotal + 2 * sFbScanout + COST_PIPE_LAYER;
+}
+
+bool CompStrategy::uiMirrorApply(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    return UIMirrorOverlay::prepare(ctx, list);
+}
+
+/* MDP composition: the layers above the FB split are fetched by their own
+ * pipes, rotated ones through the rotator. The ones below are composed into
+ * the FB, which is then left alone under the pipes; with none below, the
+ * GPU only clears the FB. */
+bool CompStrategy::mdpCompFeasible(hwc_context_t *ctx,
+                                   hwc_layer_list_t *list) {
+    if(!MDPComp::isFeasible(ctx, list))
+        return false;
+
+    int fbCount = MDPComp::getFBLayerCount();
+    sMdpCompCost = sFbScanout + (fbCount ? sGpuFrameCost : 0);
+    for(int i = 0; i < (int)list->numHwLayers; i++) {
+        const hwc_layer_t *layer = &list->hwLayers[i];
+        layer_cost cost;
+        measure(ctx, layer, cost);
+        if(i < fbCount) {
+            sMdpCompCost += gpuCost(cost);
+            continue;
+        }
+        sMdpCompCost += fbCount ? cost.fetch + COST_PIPE_LAYER
+                                : pipeCost(cost);
+        //The rotator reads the buffer and writes the turned copy the pipe
+        //fetches
+        if(layer->transform)
+            sMdpCompCost += 2 * cost.fetch + COST_ROT_LAYER;
+    }
+    return true;
+}
+
+uint64_t CompStrategy::mdpCompCost(hwc_context_t *ctx) {
+    return sMdpCompCost;
+}
+
+bool CompStrategy::mdpCompApply(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    return MDPComp::configure(&ctx->device, list);
+}
+
+/* Framebuffer: everything is composed by the GPU or copybit, the overlay
+ * is closed. Not a choice while a TV is connected, it would go blank; it is
+ * still the fallback if no other plan applies. */
+bool CompStrategy::fbFeasible(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    return !(ctx->mMDP.hasOverlay && ctx->mExtDisplay->getExternalDisplay());
+}
+
+uint64_t CompStrategy::fbCost(hwc_context_t *ctx) {
+    return sGpuFrameCost + sGpuTotal + sFbScanout;
+}
+
+bool CompStrategy::fbApply(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    // Set the overlay state to closed, otherwise video cases fail in
+    // non-overlay targets.
+    ctx->mOverlay->setState(ovutils::OV_CLOSED);
+    return true;
+}
+
+bool CompStrategy::prepare(hwc_context_t *ctx, hwc_layer_list_t *list) {
+    int order[PLAN_COUNT];
+    uint64_t cost[PLAN_COUNT];
+    int count = 0;
+
+    //Sort the feasible plans by cost, ties keep the preference order
+    for(int i = 0; i < PLAN_COUNT; i++) {
+        if(!sPlans[i].feasible(ctx, list)) {
+            ALOGD_IF(sDebugLogs, "%s: %s not feasible", __FUNCTION__,
+                     sPlans[i].name);
+            continue;
+        }
+        cost[i] = sPlans[i].cost(ctx);
+        ALOGD_IF(sDebugLogs, "%s: %s cost %llu", __FUNCTION__,
+                 sPlans[i].name, (unsigned long long)cost[i]);
+        int pos = count++;
+        while(pos > 0 && cost[order[pos - 1]] > cost[i]) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = i;
+    }
+
+    for(int i = 0; i < count; i++) {
+        const plan& p = sPlans[order[i]];
+        if(p.apply(ctx, list)) {
+            ALOGD_IF(sDebugLogs, "%s: using %s, %d layers, cost %llu",
+                     __FUNCTION__, p.name, list->numHwLayers,
+                     (unsigned long long)cost[order[i]]);
+            return order[i] != PLAN_FRAMEBUFFER;
+        }
+        ALOGD_IF(sDebugLogs, "%s: %s failed to apply", __FUNCTION__, p.name);
+    }
+
+    ALOGD_IF(sDebugLogs, "%s: no plan applied, using fb", __FUNCTION__);
+    fbApply(ctx, list);
+    return false;
+}
+
+}; //namespace qhwc
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HWC_STRATEGY_H
+#define HWC_STRATEGY_H
+
+#include <stdint.h>
+#include "hwc_utils.h"
+
+namespace qhwc {
+
+//Composition plans for a frame. The order is also the preference order
+//between plans of equal cost.
+enum {
+    PLAN_VIDEO_OVERLAY = 0,
+    PLAN_EXT_ONLY,
+    PLAN_UI_MIRROR,
+    PLAN_MDP_COMP,
+    PLAN_FRAMEBUFFER,
+    PLAN_COUNT,
+};
+
+//Picks the composition plan for a frame by estimating what each feasible
+//plan costs, in bytes of memory traffic plus a per-layer setup charge for
+//the engine doing the work, and trying them cheapest first.
+class CompStrategy {
+public:
+    //Reads the cost model configuration
+    static void init(hwc_context_t *ctx);
+    //Receives data from hwc and measures the layers of this frame
+    static void setStats(hwc_context_t *ctx, const hwc_layer_list_t *list,
+            int yuvCount, int yuvLayerIndex, bool isYuvLayerSkip,
+            int extLayerIndex);
+    //Applies the cheapest plan that succeeds, returns true if it uses the
+    //overlay
+    static bool prepare(hwc_context_t *ctx, hwc_layer_list_t *list);
+    //Returns true if blitting the RGB layers with copybit is estimated to
+    //be cheaper than composing them with the GPU
+    static bool preferCopybit(hwc_context_t *ctx);
+private:
+    struct layer_cost {
+        //Bytes fetched from the layer buffer
+        uint64_t fetch;
+        //Bytes written to the FB for the layer's destination
+        uint64_t write;
+        //FB bytes read back for blending
+        uint64_t blend;
+        bool scaled;
+    };
+    struct plan {
+        const char *name;
+        //Returns false if the plan can not be used for this frame
+        bool (*feasible)(hwc_context_t *ctx, hwc_layer_list_t *list);
+        uint64_t (*cost)(hwc_context_t *ctx);
+        //Sets up the plan, returns false if it could not be applied
+        bool (*apply)(hwc_context_t *ctx, hwc_layer_list_t *list);
+    };
+
+    static void measure(hwc_context_t *ctx, const hwc_layer_t *layer,
+            layer_cost& cost);
+    //Cost of composing a layer into the FB with the GPU
+    static uint64_t gpuCost(const layer_cost& cost);
+    //Cost of fetching a layer with an MDP pipe
+    static uint64_t pipeCost(const layer_cost& cost);
+
+    static bool videoFeasible(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static uint64_t videoCost(hwc_context_t *ctx);
+    static bool videoApply(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static bool extOnlyFeasible(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static uint64_t extOnlyCost(hwc_context_t *ctx);
+    static bool extOnlyApply(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static bool uiMirrorFeasible(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static uint64_t uiMirrorCost(hwc_context_t *ctx);
+    static bool uiMirrorApply(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static bool mdpCompFeasible(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static uint64_t mdpCompCost(hwc_context_t *ctx);
+    static bool mdpCompApply(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static bool fbFeasible(hwc_context_t *ctx, hwc_layer_list_t *list);
+    static uint64_t fbCost(hwc_context_t *ctx);
+    static bool fbApply(hwc_context_t *ctx, hwc_layer_list_t *list);
+
+    static const plan sPlans[PLAN_COUNT];
+    //Per frame stats
+    static int sYuvCount;
+    static int sYuvLayerIndex;
+    static bool sIsYuvLayerSkip;
+    static int sExtLayerIndex;
+    static layer_cost sYuvCost;
+    static layer_cost sExtCost;
+    //Sum of gpuCost over all layers
+    static uint64_t sGpuTotal;
+    //Copybit and GPU cost of the RGB layers
+    static uint64_t sRGBBlitCost;
+    static uint64_t sRGBGpuCost;
+    //Bytes scanned out of the FB every frame
+    static uint64_t sFbScanout;
+    //Fixed GPU charge per frame, derived from the dyn threshold
+    static uint64_t sGpuFrameCost;
+    //Cost of the FB split found by mdpCompFeasible
+    static uint64_t sMdpCompCost;
+    static bool sDebugLogs;
+};
+
+}; //namespace qhwc
+
+#endif //HWC_STRATEGY_H
@@ -131,14 +131,14 @@ bool UIMirrorOverlay::draw(hwc_context_t *ctx)
                               fbDev->common.module);
         switch (state) {
             case ovutils::OV_UI_MIRROR:
-                if (!ov.queueBuffer(m->framebuffer->fd, m->currentOffset,
+                if (!ov.queueBuffer(m->framebuffer->fd, ctx->fbPost.info.offset,
                                                            ovutils::OV_PIPE0)) {
                     ALOGE("%s: queueBuffer failed for external", __FUNCTION__);
                     ret = false;
                 }
                 break;
             case ovutils::OV_2D_TRUE_UI_MIRROR:
-                if (!ov.queueBuffer(m->framebuffer->fd, m->currentOffset,
+                if (!ov.queueBuffer(m->framebuffer->fd, ctx->fbPost.info.offset,
                                                            ovutils::OV_PIPE2)) {
                     ALOGE("%s: queueBuffer failed for external", __FUNCTION__);
                     ret = false;
@@ -27,6 +27,9 @@
 #include "hwc_external.h"
 #include "hwc_mdpcomp.h"
 #include "hwc_extonly.h"
+#include "hwc_framecache.h"
+#include "hwc_strategy.h"
+#include "hwc_vsync.h"
 #include "hwc_service.h"
 #include "comptype.h"
 
@@ -54,8 +57,10 @@ void initContext(hwc_context_t *ctx)
     ctx->mMDP.hasOverlay = qdutils::MDPVersion::getInstance().hasOverlay();
     ctx->mMDP.panel = qdutils::MDPVersion::getInstance().getPanelType();
     ctx->mCopybitEngine = CopybitEngine::getInstance();
+    CopyBit::init(ctx);
     ctx->mExtDisplay = new ExternalDisplay(ctx);
     MDPComp::init(ctx);
+    FrameCache::init(ctx);
 
     init_uevent_thread(ctx);
 
@@ -73,10 +78,21 @@ void initContext(hwc_context_t *ctx)
     pthread_mutex_init(&(ctx->vstate.lock), NULL);
     pthread_cond_init(&(ctx->vstate.cond), NULL);
     ctx->vstate.enable = false;
+    ctx->vstate.hwEnabled = false;
+    ctx->vstate.hotplugGeneration = 0;
+
+    //Posts made before HWC came up are not waited for
+    private_module_t* m = reinterpret_cast<private_module_t*>(
+                ctx->mFbDev->common.module);
+    ctx->fbPost.seq = android_atomic_acquire_load(&m->handoff.postSeq);
+    ctx->fbPost.info.offset = m->currentOffset;
+    ctx->fbPost.info.timestamp = 0;
 
     ALOGI("Initializing Qualcomm Hardware Composer");
     ALOGI("MDP version: %d", ctx->mMDP.version);
     ALOGI("DYN composition threshold : %f", ctx->dynThreshold);
+    CompStrategy::init(ctx);
+    VsyncModel::init(ctx);
 }
 
 void closeContext(hwc_context_t *ctx)
@@ -169,6 +185,8 @@ void getLayerStats(hwc_context_t *ctx, const hwc_layer_list_t *list)
     VideoOverlay::setStats(yuvCount, yuvLayerIndex, isYuvLayerSkip,
             ccLayerIndex);
     ExtOnly::setStats(extCount, extLayerIndex, isExtBlockPresent);
+    CompStrategy::setStats(ctx, list, yuvCount, yuvLayerIndex, isYuvLayerSkip,
+            extLayerIndex);
     CopyBit::setStats(skipCount);
     MDPComp::setStats(skipCount);
 
@@ -231,34 +249,4 @@ void calculate_crop_rects(hwc_rect_t& crop, hwc_rect_t& dst,
         dst_h = dst_b - dst_y;
     }
 }
-
-void wait4fbPost(hwc_context_t* ctx) {
-    framebuffer_device_t *fbDev = ctx->mFbDev;
-    if(fbDev) {
-        private_module_t* m = reinterpret_cast<private_module_t*>(
-                              fbDev->common.module);
-        //wait for the fb_post to be called
-        pthread_mutex_lock(&m->fbPostLock);
-        while(m->fbPostDone == false) {
-            pthread_cond_wait(&(m->fbPostCond), &(m->fbPostLock));
-        }
-        m->fbPostDone = false;
-        pthread_mutex_unlock(&m->fbPostLock);
-    }
-}
-
-void wait4Pan(hwc_context_t* ctx) {
-    framebuffer_device_t *fbDev = ctx->mFbDev;
-    if(fbDev) {
-        private_module_t* m = reinterpret_cast<private_module_t*>(
-                              fbDev->common.module);
-        //wait for the fb_post's PAN to finish
-        pthread_mutex_lock(&m->fbPanLock);
-        while(m->fbPanDone == false) {
-            pthread_cond_wait(&(m->fbPanCond), &(m->fbPanLock));
-        }
-        m->fbPanDone = false;
-        pthread_mutex_unlock(&m->fbPanLock);
-    }
-}
 };//namespace
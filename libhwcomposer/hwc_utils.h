@@ -20,6 +20,7 @@
 
 #include <hardware/hwcomposer.h>
 #include <gralloc_priv.h>
+#include <fb_priv.h>
 
 #define ALIGN_TO(x, align)     (((x) + ((align)-1)) & ~((align)-1))
 #define LIKELY( exp )       (__builtin_expect( (exp) != 0, true  ))
@@ -84,6 +85,9 @@ void wait4fbPost(hwc_context_t* ctx);
 // Waits for the fb_post to finish PAN (primary commit)
 void wait4Pan(hwc_context_t* ctx);
 
+// True if fb_post hands its pans to the flip thread
+bool fbFlipQueued(hwc_context_t* ctx);
+
 // Inline utility functions
 static inline bool isSkipLayer(const hwc_layer_t* l) {
     return (UNLIKELY(l && (l->flags & HWC_SKIP_LAYER)));
@@ -120,6 +124,9 @@ void init_uevent_thread(hwc_context_t* ctx);
 // Initialize vsync thread
 void init_vsync_thread(hwc_context_t* ctx);
 
+// Turn the primary vsync interrupt on or off, vstate.lock must be held
+int set_hw_vsync_locked(hwc_context_t* ctx, int enable);
+
 inline void getLayerResolution(const hwc_layer_t* layer,
                                          int& width, int& height)
 {
@@ -129,10 +136,23 @@ inline void getLayerResolution(const hwc_layer_t* layer,
 }
 }; //qhwc namespace
 
+//Last fb_post consumed by the composition thread
+struct fb_post_state {
+    int32_t seq;
+    fb_post_info info;
+};
+
 struct vsync_state {
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+    //SurfaceFlinger wants vsync events
     bool enable;
+    //The vsync interrupt is on. May be off while enabled when the vsync
+    //thread generates events from VsyncModel.
+    bool hwEnabled;
+    //Bumped on external display changes, the vsync thread then picks the
+    //vsync node again
+    volatile int32_t hotplugGeneration;
 };
 
 // -----------------------------------------------------------------------------
@@ -145,6 +165,9 @@ struct hwc_context_t {
     int deviceOrientation;
     int swapInterval;
     double dynThreshold;
+    //Bumped when state outside the layer list changes the composition,
+    //invalidates the frame cache
+    volatile int32_t compGeneration;
 
     //Framebuffer device
     framebuffer_device_t *mFbDev;
@@ -169,6 +192,9 @@ struct hwc_context_t {
     //Vsync
     struct vsync_state vstate;
 
+    //Frame handed over by fb_post, see wait4fbPost
+    struct fb_post_state fbPost;
+
 };
 
 #endif //HWC_UTILS_H
@@ -23,33 +23,385 @@
 
 #include <utils/Log.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
+#include <sys/ioctl.h>
+#include <linux/msm_mdp.h>
+#include <time.h>
+#include <math.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <gralloc_priv.h>
+#include <fb_priv.h>
 #include "hwc_utils.h"
+#include "hwc_vsync.h"
 #include "hwc_external.h"
 #include "string.h"
 
 #define PAGE_SIZE 4096
+// Bounds the wait for kernels that never notify on vsync_event
+#define VSYNC_POLL_TIMEOUT_MS 50
+// Poll timeouts in a row, each followed by a fresh timestamp, before the
+// node is taken for one that blocks in read instead of notifying
+#define VSYNC_POLL_MISSES 3
+// Samples needed before the model may lock
+#define VSYNC_MODEL_MIN_SAMPLES 8
+// Outliers in a row that make the model start over
+#define VSYNC_MODEL_MAX_OUTLIERS 3
+// Hardware vsyncs taken to resync the model before predicting again
+#define VSYNC_RESYNC_SAMPLES 6
+// Predicted vsyncs generated before the hardware is turned back on
+#define VSYNC_PREDICT_RUN 120
 
 namespace qhwc {
 
+static const char* vsync_timestamp_fb[] = {
+    "/sys/class/graphics/fb0/vsync_event",
+    "/sys/class/graphics/fb1/vsync_event",
+};
+
+//Upper bounds of the histogram buckets, the last one takes the rest
+static const nsecs_t sBucketLimits[VSYNC_HIST_BUCKETS - 1] = {
+    50000, 100000, 250000, 500000, 1000000, 2000000, 4000000,
+};
+
+pthread_mutex_t VsyncStats::sLock = PTHREAD_MUTEX_INITIALIZER;
+nsecs_t VsyncStats::sPeriod = 0;
+nsecs_t VsyncStats::sLastTimestamp = 0;
+unsigned int VsyncStats::sEvents = 0;
+unsigned int VsyncStats::sMissed = 0;
+unsigned int VsyncStats::sPredicted = 0;
+unsigned int VsyncStats::sJitter[VSYNC_HIST_BUCKETS];
+unsigned int VsyncStats::sLatency[VSYNC_HIST_BUCKETS];
+nsecs_t VsyncStats::sMaxJitter = 0;
+nsecs_t VsyncStats::sMaxLatency = 0;
+
+int VsyncStats::bucket(nsecs_t delta) {
+    int i = 0;
+    while(i < VSYNC_HIST_BUCKETS - 1 && delta >= sBucketLimits[i])
+        i++;
+    return i;
+}
+
+void VsyncStats::restart(nsecs_t period) {
+    pthread_mutex_lock(&sLock);
+    sPeriod = period;
+    sLastTimestamp = 0;
+    pthread_mutex_unlock(&sLock);
+}
+
+void VsyncStats::record(nsecs_t timestamp, nsecs_t now) {
+    pthread_mutex_lock(&sLock);
+    sEvents++;
+    if(sLastTimestamp && sPeriod) {
+        nsecs_t interval = timestamp - sLastTimestamp;
+        if(interval * 2 > sPeriod * 3) {
+            sMissed++;
+        } else {
+            nsecs_t jitter = interval - sPeriod;
+            if(jitter < 0)
+                jitter = -jitter;
+            sJitter[bucket(jitter)]++;
+            if(jitter > sMaxJitter)
+                sMaxJitter = jitter;
+        }
+    }
+    sLastTimestamp = timestamp;
+
+    nsecs_t latency = now - timestamp;
+    if(latency >= 0) {
+        sLatency[bucket(latency)]++;
+        if(latency > sMaxLatency)
+            sMaxLatency = latency;
+    }
+    pthread_mutex_unlock(&sLock);
+}
+
+void VsyncStats::recordPredicted() {
+    pthread_mutex_lock(&sLock);
+    sPredicted++;
+    pthread_mutex_unlock(&sLock);
+}
+
+void VsyncStats::dump(android::String8& buf) {
+    pthread_mutex_lock(&sLock);
+    buf.appendFormat("Vsync: events %u, predicted %u, missed %u, "
+                     "period %lld us\n", sEvents, sPredicted, sMissed,
+                     sPeriod / 1000);
+    buf.appendFormat("  max jitter %lld us, max latency %lld us\n",
+                     sMaxJitter / 1000, sMaxLatency / 1000);
+    buf.append("  <us     jitter  latency\n");
+    for(int i = 0; i < VSYNC_HIST_BUCKETS; i++) {
+        if(i < VSYNC_HIST_BUCKETS - 1)
+            buf.appendFormat("  %-6lld", sBucketLimits[i] / 1000);
+        else
+            buf.append("  more  ");
+        buf.appendFormat(" %7u  %7u\n", sJitter[i], sLatency[i]);
+    }
+    pthread_mutex_unlock(&sLock);
+}
+
+//-------------- VsyncModel -----------------------//
+pthread_mutex_t VsyncModel::sLock = PTHREAD_MUTEX_INITIALIZER;
+bool VsyncModel::sPredict = false;
+bool VsyncModel::sLocked = false;
+nsecs_t VsyncModel::sNominalPeriod = 1000000000LL / 60;
+nsecs_t VsyncModel::sPeriod = 1000000000LL / 60;
+nsecs_t VsyncModel::sPhase = 0;
+nsecs_t VsyncModel::sError = 0;
+nsecs_t VsyncModel::sSamples[VSYNC_MODEL_SAMPLES];
+int VsyncModel::sNumSamples = 0;
+int VsyncModel::sNextSample = 0;
+int VsyncModel::sOutliers = 0;
+unsigned int VsyncModel::sRejected = 0;
+unsigned int VsyncModel::sResets = 0;
+
+void VsyncModel::init(hwc_context_t *ctx) {
+    private_module_t* m = reinterpret_cast<private_module_t*>(
+                ctx->mFbDev->common.module);
+    char property[PROPERTY_VALUE_MAX];
+    sPredict = false;
+    if((property_get("debug.hwc.vsync.predict", property, NULL) > 0) &&
+       (!strncmp(property, "1", PROPERTY_VALUE_MAX) ||
+        (!strncasecmp(property,"true", PROPERTY_VALUE_MAX )))) {
+        sPredict = true;
+    }
+    reset(1000000000LL / (m->fps ? m->fps : 60));
+    ALOGD_IF(VSYNC_DEBUG, "%s: prediction %s, nominal period %lld",
+             __FUNCTION__, sPredict ? "on" : "off", sNominalPeriod);
+}
+
+void VsyncModel::reset(nsecs_t nominalPeriod) {
+    pthread_mutex_lock(&sLock);
+    sNominalPeriod = nominalPeriod;
+    sPeriod = nominalPeriod;
+    sPhase = 0;
+    sError = 0;
+    sLocked = false;
+    sNumSamples = 0;
+    sNextSample = 0;
+    sOutliers = 0;
+    pthread_mutex_unlock(&sLock);
+}
+
+//Least squares fit of the samples to phase + k * period. The vsync index k
+//of each sample is its distance to the newest one in current periods, so
+//missed interrupts do not disturb the fit. Called with sLock held.
+void VsyncModel::fit() {
+    int n = sNumSamples;
+    if(n < 2) {
+        sLocked = false;
+        return;
+    }
+    int newest = (sNextSample + VSYNC_MODEL_SAMPLES - 1) % VSYNC_MODEL_SAMPLES;
+    nsecs_t ref = sSamples[newest];
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for(int i = 0; i < n; i++) {
+        double y = (double)(sSamples[i] - ref);
+        double x = floor(y / sPeriod + 0.5);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double det = n * sxx - sx * sx;
+    if(det <= 0)
+        return;
+    double slope = (n * sxy - sx * sy) / det;
+    double intercept = (sy - slope * sx) / n;
+    if(slope < sNominalPeriod / 2 || slope > sNominalPeriod * 3 / 2) {
+        sLocked = false;
+        return;
+    }
+
+    double error = 0;
+    for(int i = 0; i < n; i++) {
+        double y = (double)(sSamples[i] - ref);
+        double x = floor(y / sPeriod + 0.5);
+        double r = fabs(y - (intercept + slope * x));
+        if(r > error)
+            error = r;
+    }
+    sPeriod = (nsecs_t)slope;
+    sPhase = ref + (nsecs_t)intercept;
+    sError = (nsecs_t)error;
+    sLocked = (n >= VSYNC_MODEL_MIN_SAMPLES) && (sError < sPeriod / 16);
+}
+
+bool VsyncModel::addSample(nsecs_t timestamp) {
+    pthread_mutex_lock(&sLock);
+    if(sNumSamples) {
+        int newest = (sNextSample + VSYNC_MODEL_SAMPLES - 1) %
+                VSYNC_MODEL_SAMPLES;
+        if(timestamp <= sSamples[newest]) {
+            pthread_mutex_unlock(&sLock);
+            return false;
+        }
+    }
+    if(sLocked) {
+        nsecs_t d = timestamp - sPhase + sPeriod / 2;
+        nsecs_t k = d / sPeriod;
+        if(d < 0 && k * sPeriod != d)
+            k--;
+        nsecs_t r = timestamp - sPhase - k * sPeriod;
+        if(r < 0)
+            r = -r;
+        if(r > sPeriod / 8) {
+            sRejected++;
+            if(++sOutliers < VSYNC_MODEL_MAX_OUTLIERS) {
+                pthread_mutex_unlock(&sLock);
+                return false;
+            }
+            // The panel timing changed, start over from this sample
+            ALOGD_IF(VSYNC_DEBUG, "%s: model reset after %d outliers",
+                     __FUNCTION__, sOutliers);
+            sResets++;
+            sPeriod = sNominalPeriod;
+            sLocked = false;
+            sNumSamples = 0;
+            sNextSample = 0;
+        }
+    }
+    sOutliers = 0;
+    sSamples[sNextSample] = timestamp;
+    sNextSample = (sNextSample + 1) % VSYNC_MODEL_SAMPLES;
+    if(sNumSamples < VSYNC_MODEL_SAMPLES)
+        sNumSamples++;
+    fit();
+    pthread_mutex_unlock(&sLock);
+    return true;
+}
+
+bool VsyncModel::isLocked() {
+    pthread_mutex_lock(&sLock);
+    bool locked = sLocked;
+    pthread_mutex_unlock(&sLock);
+    return locked;
+}
+
+nsecs_t VsyncModel::predict(nsecs_t t, int n) {
+    pthread_mutex_lock(&sLock);
+    nsecs_t period = sPeriod;
+    nsecs_t phase = sPhase;
+    if(!sLocked) {
+        // Best effort from the newest sample and the nominal period
+        period = sNominalPeriod;
+        phase = sNumSamples ? sSamples[(sNextSample + VSYNC_MODEL_SAMPLES - 1)
+                % VSYNC_MODEL_SAMPLES] : t;
+    }
+    pthread_mutex_unlock(&sLock);
+
+    nsecs_t d = t - phase;
+    nsecs_t k = d / period;
+    if(d < 0 && k * period != d)
+        k--;
+    return phase + (k + n) * period;
+}
+
+nsecs_t VsyncModel::getPeriod() {
+    pthread_mutex_lock(&sLock);
+    nsecs_t period = sLocked ? sPeriod : sNominalPeriod;
+    pthread_mutex_unlock(&sLock);
+    return period;
+}
+
+void VsyncModel::dump(android::String8& buf) {
+    pthread_mutex_lock(&sLock);
+    buf.appendFormat("Vsync model: %s, prediction %s, period %lld ns "
+                     "(nominal %lld), error %lld us\n",
+                     sLocked ? "locked" : "unlocked",
+                     sPredict ? "on" : "off", sPeriod, sNominalPeriod,
+                     sError / 1000);
+    buf.appendFormat("  samples %d, rejected %u, resets %u\n",
+                     sNumSamples, sRejected, sResets);
+    pthread_mutex_unlock(&sLock);
+}
+
+//Turns the vsync interrupt of the primary on or off. Called with
+//ctx->vstate.lock held.
+int set_hw_vsync_locked(hwc_context_t* ctx, int enable) {
+    private_module_t* m = reinterpret_cast<private_module_t*>(
+                ctx->mFbDev->common.module);
+    if(ioctl(m->framebuffer->fd, MSMFB_OVERLAY_VSYNC_CTRL, &enable) < 0) {
+        ALOGE("%s: MSMFB_OVERLAY_VSYNC_CTRL %d failed, %s", __FUNCTION__,
+              enable, strerror(errno));
+        return -errno;
+    }
+    ctx->vstate.hwEnabled = enable;
+    return 0;
+}
+
+//Used by the vsync thread, leaves the interrupt alone if SurfaceFlinger
+//has turned vsync off in the meantime
+static void resync_hw_vsync(hwc_context_t* ctx, bool enable) {
+    pthread_mutex_lock(&ctx->vstate.lock);
+    if(ctx->vstate.enable && ctx->vstate.hwEnabled != enable)
+        set_hw_vsync_locked(ctx, enable);
+    pthread_mutex_unlock(&ctx->vstate.lock);
+}
+
+static void sleep_until(nsecs_t t) {
+    struct timespec ts;
+    ts.tv_sec = t / 1000000000LL;
+    ts.tv_nsec = t % 1000000000LL;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/* The vsync_event node of the panel driving the vsync, HDMI on fb1 when it
+ * is connected and configured, fb0 otherwise. Nodes are opened once and
+ * kept open, the choice only changes on hotplug.
+ */
+static int selectVsyncNode(hwc_context_t* ctx, int fds[]) {
+    int fb = 0;
+    if(ctx->mExtDisplay->isHDMIConfigured() &&
+       (ctx->mExtDisplay->getExternalDisplay() == EXTERN_DISPLAY_FB1)) {
+        fb = 1;
+    }
+    if(fds[fb] < 0) {
+        fds[fb] = open(vsync_timestamp_fb[fb], O_RDONLY);
+        if(fds[fb] < 0) {
+            ALOGE("%s:not able to open file:%s, %s",  __FUNCTION__,
+                  vsync_timestamp_fb[fb], strerror(errno));
+            if(fb == 0)
+                return -1;
+            // Keep running on the primary
+            return selectVsyncNode(ctx, fds) < 0 ? -1 : 0;
+        }
+    }
+    return fb;
+}
+
 static void *vsync_loop(void *param)
 {
-    const char* vsync_timestamp_fb0 = "/sys/class/graphics/fb0/vsync_event";
-    const char* vsync_timestamp_fb1 = "/sys/class/graphics/fb1/vsync_event";
-
     hwc_context_t * ctx = reinterpret_cast<hwc_context_t *>(param);
+    private_module_t* m = reinterpret_cast<private_module_t*>(
+                ctx->mFbDev->common.module);
 
     char thread_name[64] = "hwcVsyncThread";
     prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
-    setpriority(PRIO_PROCESS, 0, 
+    setpriority(PRIO_PROCESS, 0,
                 HAL_PRIORITY_URGENT_DISPLAY + ANDROID_PRIORITY_MORE_FAVORABLE);
 
     static char vdata[PAGE_SIZE];
 
-    uint64_t cur_timestamp=0;
-    int32_t len = -1, fd_timestamp = -1;
-    bool fb1_vsync = false;
+    uint64_t cur_timestamp = 0, last_timestamp = 0;
+    int32_t len = -1;
+    int fds[2] = { -1, -1 };
+    int fb = -1;
+    int32_t hotplugGeneration = 0;
+    // Cleared when the driver turns out not to notify pollers, the read
+    // then blocks until the next vsync by itself. Set again if a read
+    // returns without a new timestamp, so it never spins on the node.
+    bool usePoll = true;
+    bool pollNotified = false;
+    int pollMisses = 0;
+    // Prediction state, vsyncs generated from the model since the
+    // hardware was turned off and hardware vsyncs since it was back on
+    bool predicting = false;
+    int predictedRun = 0;
+    int hwRun = 0;
+    nsecs_t last_sent = 0;
 
     /* Currently read vsync timestamp from drivers
        e.g. VSYNC=41800875994
@@ -58,64 +410,146 @@ static void *vsync_loop(void *param)
     hwc_procs* proc = (hwc_procs*)ctx->device.reserved_proc[0];
 
     do {
+        bool resumed = false;
         pthread_mutex_lock(&ctx->vstate.lock);
-        if(ctx->vstate.enable == false) {
-          pthread_cond_wait(&ctx->vstate.cond, &ctx->vstate.lock);
+        while(ctx->vstate.enable == false) {
+            pthread_cond_wait(&ctx->vstate.cond, &ctx->vstate.lock);
+            resumed = true;
         }
         pthread_mutex_unlock(&ctx->vstate.lock);
 
-       int hdmiconnected = ctx->mExtDisplay->getExternalDisplay();
-
-       // vsync for primary OR HDMI ?
-       if(ctx->mExtDisplay->isHDMIConfigured() &&
-              (hdmiconnected == EXTERN_DISPLAY_FB1)){
-          fb1_vsync = true;
-       } else {
-          fb1_vsync = false;
-       }
-
-       // try to open timestamp sysfs
-       if (fb1_vsync){
-          fd_timestamp = open(vsync_timestamp_fb1, O_RDONLY);
-       } else {
-          fd_timestamp = open(vsync_timestamp_fb0, O_RDONLY);
-       }
-       if (fd_timestamp < 0) {
-           ALOGE ("FATAL:%s:not able to open file:%s, %s",  __FUNCTION__,
-                 (fb1_vsync) ? vsync_timestamp_fb1 : vsync_timestamp_fb0,
-                                                         strerror(errno));
-           return NULL;
-       }
-       // Open success - read now
-       len = read(fd_timestamp, vdata, PAGE_SIZE);
-       if (len < 0){
-           ALOGE ("FATAL:%s:not able to read file:%s, %s", __FUNCTION__,
-                (fb1_vsync) ? vsync_timestamp_fb1 : vsync_timestamp_fb0,
-                                                        strerror(errno));
-           fd_timestamp = -1;
-           return NULL;
-       }
-
-      // extract timestamp
-      const char *str = vdata;
-      if (!strncmp(str, "VSYNC=", strlen("VSYNC="))) {
-          cur_timestamp = strtoull(str + strlen("VSYNC="), NULL, 0);
-      } else {
-        ALOGE ("FATAL:%s:timestamp data not in correct format",
-                                                 __FUNCTION__);
-      }
-      // send timestamp to HAL
-      ALOGD_IF (VSYNC_DEBUG, "%s: timestamp %llu sent to HWC for %s",
-            __FUNCTION__, cur_timestamp, (fb1_vsync) ? "fb1" : "fb0");
-      proc->vsync(proc, 0, cur_timestamp);
-
-      // close open fds
-      close (fd_timestamp);
-
-      // reset fd
-      fd_timestamp = -1;
-
-      // repeat, whatever, you just did
+        // vsync for primary OR HDMI ? Only rechecked after hotplug
+        int32_t generation = android_atomic_acquire_load(
+                    &ctx->vstate.hotplugGeneration);
+        if(fb < 0 || generation != hotplugGeneration) {
+            hotplugGeneration = generation;
+            fb = selectVsyncNode(ctx, fds);
+            if(fb < 0) {
+                ALOGE("FATAL:%s:no vsync node", __FUNCTION__);
+                return NULL;
+            }
+            usePoll = true;
+            pollMisses = 0;
+            resumed = true;
+        }
+        if(resumed) {
+            last_timestamp = 0;
+            predicting = false;
+            hwRun = 0;
+            VsyncStats::restart(1000000000LL / (m->fps ? m->fps : 60));
+        }
+
+        /* With prediction on, a locked model stands in for the primary's
+         * vsync interrupt for VSYNC_PREDICT_RUN vsyncs. The interrupt is
+         * then turned back on for VSYNC_RESYNC_SAMPLES vsyncs to keep the
+         * model in phase.
+         */
+        if(VsyncModel::isPredictionEnabled() && fb == 0) {
+            if(!predicting && hwRun >= VSYNC_RESYNC_SAMPLES &&
+               VsyncModel::isLocked()) {
+                predicting = true;
+                predictedRun = 0;
+                resync_hw_vsync(ctx, false);
+            }
+            if(predicting && (predictedRun >= VSYNC_PREDICT_RUN ||
+                              !VsyncModel::isLocked())) {
+                predicting = false;
+                hwRun = 0;
+                resync_hw_vsync(ctx, true);
+            }
+            if(predicting) {
+                nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+                nsecs_t after = last_sent + VsyncModel::getPeriod() / 2;
+                nsecs_t next = VsyncModel::predict(now > after ? now : after);
+                sleep_until(next);
+                if(!ctx->vstate.enable)
+                    continue;
+                ALOGD_IF (VSYNC_DEBUG, "%s: predicted timestamp %lld sent "
+                          "to HWC", __FUNCTION__, next);
+                proc->vsync(proc, 0, next);
+                last_sent = next;
+                predictedRun++;
+                VsyncStats::recordPredicted();
+                VsyncStats::record(next, systemTime(SYSTEM_TIME_MONOTONIC));
+                continue;
+            }
+        }
+
+        if(usePoll) {
+            struct pollfd pfd;
+            pfd.fd = fds[fb];
+            pfd.events = POLLPRI | POLLERR;
+            pfd.revents = 0;
+            int ret = poll(&pfd, 1, VSYNC_POLL_TIMEOUT_MS);
+            pollNotified = (ret > 0);
+            if(ret < 0 && errno != EINTR) {
+                ALOGE("%s: poll failed on %s, %s", __FUNCTION__,
+                      vsync_timestamp_fb[fb], strerror(errno));
+            }
+            // Timed out with vsync on. Before any timestamp was seen there
+            // is nothing to compare the read below with.
+            if(ret == 0 && !last_timestamp)
+                continue;
+        }
+
+        // Reading from offset 0 also re-arms the notification
+        len = pread(fds[fb], vdata, PAGE_SIZE - 1, 0);
+        if (len < 0) {
+            ALOGE ("FATAL:%s:not able to read file:%s, %s", __FUNCTION__,
+                   vsync_timestamp_fb[fb], strerror(errno));
+            close(fds[0]);
+            if(fds[1] >= 0)
+                close(fds[1]);
+            return NULL;
+        }
+        vdata[len] = '\0';
+
+        // extract timestamp
+        const char *str = vdata;
+        if (!strncmp(str, "VSYNC=", strlen("VSYNC="))) {
+            cur_timestamp = strtoull(str + strlen("VSYNC="), NULL, 0);
+        } else {
+            ALOGE ("FATAL:%s:timestamp data not in correct format",
+                   __FUNCTION__);
+            continue;
+        }
+        // Woken up without a new vsync
+        if (cur_timestamp == last_timestamp) {
+            if (!usePoll) {
+                ALOGI("%s: %s read did not block, polling again",
+                      __FUNCTION__, vsync_timestamp_fb[fb]);
+                usePoll = true;
+                pollMisses = 0;
+            }
+            continue;
+        }
+        VsyncModel::addSample(cur_timestamp);
+        hwRun++;
+        if (usePoll && last_timestamp) {
+            // A fresh timestamp after a poll timeout. Once is a late
+            // notification, several in a row mean the driver blocks in
+            // read instead of notifying.
+            pollMisses = pollNotified ? 0 : pollMisses + 1;
+            if (pollMisses >= VSYNC_POLL_MISSES) {
+                ALOGI("%s: %s does not notify, using blocking reads",
+                      __FUNCTION__, vsync_timestamp_fb[fb]);
+                usePoll = false;
+            }
+        }
+        last_timestamp = cur_timestamp;
+
+        // Right after predicting the same vsync may already have been sent
+        if ((nsecs_t)cur_timestamp <= last_sent + VsyncModel::getPeriod() / 2)
+            continue;
+
+        // send timestamp to HAL
+        ALOGD_IF (VSYNC_DEBUG, "%s: timestamp %llu sent to HWC for fb%d",
+                  __FUNCTION__, cur_timestamp, fb);
+        proc->vsync(proc, 0, cur_timestamp);
+        last_sent = cur_timestamp;
+        VsyncStats::record(cur_timestamp, systemTime(SYSTEM_TIME_MONOTONIC));
+
+        // repeat, whatever, you just did
     } while (true);
 }
 
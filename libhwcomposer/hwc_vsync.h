@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HWC_VSYNC_H
+#define HWC_VSYNC_H
+
+#include <pthread.h>
+#include <utils/Timers.h>
+#include <utils/String8.h>
+#include "hwc_utils.h"
+
+#define VSYNC_HIST_BUCKETS 8
+#define VSYNC_MODEL_SAMPLES 32
+
+namespace qhwc {
+//Statistics on the vsync timestamps the vsync thread hands to SurfaceFlinger.
+//Jitter is the distance of each interval from the nominal refresh period,
+//latency is how long after the hardware vsync the event was delivered.
+class VsyncStats {
+public:
+    //Counts a vsync that was generated from the model
+    static void recordPredicted();
+    //Starts a new run of intervals, after hotplug or a disabled period
+    static void restart(nsecs_t period);
+    //Records a timestamp delivered at time now
+    static void record(nsecs_t timestamp, nsecs_t now);
+    static void dump(android::String8& buf);
+private:
+    static int bucket(nsecs_t delta);
+
+    static pthread_mutex_t sLock;
+    static nsecs_t sPeriod;
+    static nsecs_t sLastTimestamp;
+    static unsigned int sEvents;
+    //Intervals longer than 1.5 periods, at least one vsync was not seen
+    static unsigned int sMissed;
+    static unsigned int sPredicted;
+    static unsigned int sJitter[VSYNC_HIST_BUCKETS];
+    static unsigned int sLatency[VSYNC_HIST_BUCKETS];
+    static nsecs_t sMaxJitter;
+    static nsecs_t sMaxLatency;
+};
+
+//Software model of the display refresh: vsync(k) = phase + k * period, fit
+//by least squares over the recent hardware timestamps. Once locked it can
+//stand in for the hardware interrupt, see vsync_loop.
+class VsyncModel {
+public:
+    //Reads the configuration, starts from the nominal panel period
+    static void init(hwc_context_t *ctx);
+    //Forgets all samples, the refresh rate or the panel changed
+    static void reset(nsecs_t nominalPeriod);
+    //Adds a hardware timestamp, returns false if it was rejected as outlier
+    static bool addSample(nsecs_t timestamp);
+    //True if the fit is good enough to predict from
+    static bool isLocked();
+    //Time of the n-th vsync after time t, n >= 1
+    static nsecs_t predict(nsecs_t t, int n = 1);
+    //Fitted period, or the nominal one when not locked
+    static nsecs_t getPeriod();
+    //Flags if predicted vsyncs may replace the hardware interrupt
+    static bool isPredictionEnabled() { return sPredict; }
+    static void dump(android::String8& buf);
+private:
+    static void fit();
+
+    static pthread_mutex_t sLock;
+    static bool sPredict;
+    static bool sLocked;
+    static nsecs_t sNominalPeriod;
+    static nsecs_t sPeriod;
+    //Time of a vsync on the fitted line
+    static nsecs_t sPhase;
+    //Worst residual of the last fit
+    static nsecs_t sError;
+    static nsecs_t sSamples[VSYNC_MODEL_SAMPLES];
+    static int sNumSamples;
+    static int sNextSample;
+    //Outliers in a row, enough of them mean the model is wrong
+    static int sOutliers;
+    static unsigned int sRejected;
+    static unsigned int sResets;
+};
+
+}; //namespace qhwc
+
+#endif //HWC_VSYNC_H
@@ -105,6 +105,25 @@ public:
         result = reply.readInt32();
         return result;
     }
+
+    virtual status_t setFrameTrace(int enable) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IHWComposer::getInterfaceDescriptor());
+        data.writeInt32(enable);
+        status_t result = remote()->transact(SET_FRAME_TRACE, data, &reply);
+        result = reply.readInt32();
+        return result;
+    }
+
+    virtual status_t getFrameTrace(int format, String8 *trace) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IHWComposer::getInterfaceDescriptor());
+        data.writeInt32(format);
+        status_t result = remote()->transact(GET_FRAME_TRACE, data, &reply);
+        *trace = reply.readString8();
+        result = reply.readInt32();
+        return result;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(HWComposer, "android.display.IHWComposer");
@@ -165,6 +184,22 @@ status_t BnHWComposer::onTransact(
             reply->writeInt32(res);
             return NO_ERROR;
         } break;
+        case SET_FRAME_TRACE: {
+            CHECK_INTERFACE(IHWComposer, data, reply);
+            int enable = data.readInt32();
+            status_t res = setFrameTrace(enable);
+            reply->writeInt32(res);
+            return NO_ERROR;
+        } break;
+        case GET_FRAME_TRACE: {
+            CHECK_INTERFACE(IHWComposer, data, reply);
+            int format = data.readInt32();
+            String8 trace;
+            status_t res = getFrameTrace(format, &trace);
+            reply->writeString8(trace);
+            reply->writeInt32(res);
+            return NO_ERROR;
+        } break;
         default:
             return BBinder::onTransact(code, data, reply, flags);
     }
@@ -26,6 +26,7 @@
 
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
+#include <utils/String8.h>
 
 #include <binder/IInterface.h>
 
@@ -39,6 +40,8 @@ enum {
     GET_EXT_DISPLAY_TYPE,
     GET_EXT_DISPLAY_RESOLUTION_MODES,
     GET_EXT_DISPLAY_RESOLUTION_MODE_COUNT,
+    SET_FRAME_TRACE,
+    GET_FRAME_TRACE,
 };
 
 class IHWComposer : public android::IInterface
@@ -54,6 +57,11 @@ public:
     virtual android::status_t setHPDStatus(int enable) = 0;
     virtual android::status_t setResolutionMode(int resMode) = 0;
     virtual android::status_t setActionSafeDimension(int w, int h) = 0;
+
+    // Composition timeline, format is a qdutils TRACE_FORMAT_*
+    virtual android::status_t setFrameTrace(int enable) = 0;
+    virtual android::status_t getFrameTrace(int format,
+                                            android::String8 *trace) = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ * Not a Contribution, Apache license notifications and license are retained
+ * for attribution purposes only.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check that MDP composition does not touch the heap per frame.
+ *
+ * A sequence of layer lists, with layer counts, video, skip, rotated and
+ * downscaled layers changing from frame to frame, goes through
+ * MDPComp::isFeasible, configure and draw the way hwc prepare and set
+ * drive them. malloc, calloc and realloc are replaced by counting ones,
+ * so every allocation made while the sequence runs is counted. The
+ * sequence runs once to warm up the singletons first. Returns non zero
+ * if anything was allocated, or if the counters miss an allocation made
+ * on purpose.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mdp_version.h>
+#include "hwc_mdpcomp.h"
+#include "hwc_qbuf.h"
+#include "mdpcomp_fakes.h"
+
+using namespace qhwc;
+
+#define FB_WIDTH        480
+#define FB_HEIGHT       800
+#define MAX_LAYERS      6
+#define ROUNDS          1000
+
+static volatile bool sCounting;
+static volatile int sAllocs;
+//Keeps the probe allocations from being optimized out
+static void* volatile sProbe;
+
+//Interposed over the C library allocator, so the allocations made inside
+//libc and by operator new are counted as well
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    if(sCounting)
+        sAllocs++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    if(sCounting)
+        sAllocs++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if(sCounting)
+        sAllocs++;
+    return __libc_realloc(ptr, size);
+}
+}
+
+// Layers of the frames, from the bottom up
+enum {
+    UI = 0,     // plain RGB
+    UI_BLEND,   // blended downscale
+    VIDEO,      // YUV
+    SKIP,       // GPU only
+    ROT,        // RGB through the rotator
+};
+
+struct frame {
+    int count;
+    int layers[MAX_LAYERS];
+};
+
+static const frame sFrames[] = {
+    { 1, { UI } },
+    { 2, { UI, UI } },
+    { 2, { VIDEO, UI } },
+    { 3, { UI, VIDEO, UI_BLEND } },
+    { 3, { SKIP, VIDEO, UI } },
+    { 4, { UI, UI, VIDEO, UI } },
+    { 5, { UI, SKIP, UI, VIDEO, UI } },
+    { 2, { SKIP, SKIP } },
+    { 3, { UI, ROT, UI } },
+    { 3, { ROT, ROT, VIDEO } },
+    { 6, { UI, UI, UI, UI, UI, UI } },
+    { 4, { VIDEO, VIDEO, VIDEO, UI } },
+    { 1, { VIDEO } },
+};
+
+#define FRAME_COUNT (int)(sizeof(sFrames) / sizeof(sFrames[0]))
+
+static private_handle_t sUiHandle(-1, 4096, 0, BUFFER_TYPE_UI,
+                                  HAL_PIXEL_FORMAT_RGBA_8888, 200, 200);
+static private_handle_t sVideoHandle(-1, 4096, 0, BUFFER_TYPE_VIDEO,
+                                     HAL_PIXEL_FORMAT_YCbCr_420_SP, 200, 200);
+
+static void set_rect(hwc_rect_t& r, int l, int t, int w, int h)
+{
+    r.left = l;
+    r.top = t;
+    r.right = l + w;
+    r.bottom = t + h;
+}
+
+static void build_layer(hwc_layer_t* layer, int type, int index)
+{
+    memset(layer, 0, sizeof(*layer));
+    layer->compositionType = HWC_FRAMEBUFFER;
+    layer->blending = HWC_BLENDING_NONE;
+    layer->handle = &sUiHandle;
+    set_rect(layer->sourceCrop, 0, 0, 100, 100);
+    set_rect(layer->displayFrame, 20 * index, 20 * index, 100, 100);
+
+    switch(type) {
+        case UI_BLEND:
+            layer->blending = HWC_BLENDING_PREMULT;
+            set_rect(layer->sourceCrop, 0, 0, 200, 200);
+            break;
+        case VIDEO:
+            layer->handle = &sVideoHandle;
+            break;
+        case SKIP:
+            layer->flags |= HWC_SKIP_LAYER;
+            break;
+        case ROT:
+            layer->transform = HWC_TRANSFORM_ROT_90;
+            break;
+    }
+}
+
+// Composes every frame of the sequence once, returns the frames given to MDP
+static int run_sequence(hwc_context_t* ctx, hwc_layer_list_t* list)
+{
+    int mdpFrames = 0;
+    for(int f = 0; f < FRAME_COUNT; f++) {
+        list->numHwLayers = sFrames[f].count;
+        for(int i = 0; i < sFrames[f].count; i++)
+            build_layer(&list->hwLayers[i], sFrames[f].layers[i], i);
+
+        //prepare
+        if(MDPComp::isFeasible(ctx, list) &&
+                MDPComp::configure(&ctx->device, list))
+            mdpFrames++;
+
+        //set
+        MDPComp::draw(ctx, list);
+        ctx->qbuf->unlockAllPrevious();
+    }
+    return mdpFrames;
+}
+
+int main()
+{
+    hwc_context_t ctx;
+    int failures = 0;
+
+    fakes::setMDPVersion(qdutils::MDP_V4_2);
+    fakes::setProperty("debug.mdpcomp.maxlayer", "3");
+    fakes::initContext(&ctx, FB_WIDTH, FB_HEIGHT);
+    MDPComp::init(&ctx);
+
+    hwc_layer_list_t* list = (hwc_layer_list_t*)calloc(1,
+            sizeof(hwc_layer_list_t) + MAX_LAYERS * sizeof(hwc_layer_t));
+
+    //The counters have to see allocations, or the check below proves nothing
+    sCounting = true;
+    sAllocs = 0;
+    sProbe = malloc(16);
+    free(sProbe);
+    sProbe = new int;
+    sCounting = false;
+    delete (int*)sProbe;
+    if(sAllocs != 2) {
+        printf("allocation counters saw %d of 2 allocations\n", sAllocs);
+        failures++;
+    }
+
+    run_sequence(&ctx, list);
+
+    fakes::resetOverlayCalls();
+    sAllocs = 0;
+    sCounting = true;
+    int mdpFrames = 0;
+    for(int round = 0; round < ROUNDS; round++)
+        mdpFrames += run_sequence(&ctx, list);
+    sCounting = false;
+
+    printf("%d frames, %d composed by MDP, %d overlay calls, %d allocations\n",
+           ROUNDS * FRAME_COUNT, mdpFrames, fakes::overlayCalls(), sAllocs);
+    if(!mdpFrames || !fakes::overlayCalls()) {
+        printf("no frame went through the overlay\n");
+        failures++;
+    }
+    if(sAllocs)
+        failures++;
+
+    free(list);
+    fakes::destroyContext(&ctx);
+    return failures ? 1 : 0;
+}
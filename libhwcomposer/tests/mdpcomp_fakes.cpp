@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ * Not a Contribution, Apache license notifications and license are retained
+ * for attribution purposes only.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cutils/properties.h>
+#include <genlock.h>
+#include <mdp_version.h>
+#include <frame_trace.h>
+#include <overlay.h>
+#include <idle_invalidator.h>
+#include "hwc_qbuf.h"
+#include "hwc_external.h"
+#include "mdpcomp_fakes.h"
+
+ANDROID_SINGLETON_STATIC_INSTANCE(qdutils::MDPVersion);
+ANDROID_SINGLETON_STATIC_INSTANCE(qdutils::FrameTrace);
+
+#define MAX_FAKE_PROPS 8
+
+struct fake_prop {
+    const char* key;
+    char value[PROPERTY_VALUE_MAX];
+};
+
+static fake_prop sProps[MAX_FAKE_PROPS];
+static int sMDPVersion = qdutils::MDP_V4_2;
+static int sOverlayCalls;
+static int sFbWidth, sFbHeight;
+static ovutils::eOverlayState sOverlayState = ovutils::OV_CLOSED;
+
+namespace fakes {
+
+void setProperty(const char* key, const char* value) {
+    fake_prop* free_prop = NULL;
+    for(int i = 0; i < MAX_FAKE_PROPS; i++) {
+        if(sProps[i].key && !strcmp(sProps[i].key, key)) {
+            free_prop = &sProps[i];
+            break;
+        }
+        if(!sProps[i].key && !free_prop)
+            free_prop = &sProps[i];
+    }
+    if(!free_prop)
+        abort();
+    free_prop->key = value ? key : NULL;
+    if(value)
+        snprintf(free_prop->value, PROPERTY_VALUE_MAX, "%s", value);
+}
+
+void setMDPVersion(int version) {
+    sMDPVersion = version;
+}
+
+int overlayCalls() {
+    return sOverlayCalls;
+}
+
+void resetOverlayCalls() {
+    sOverlayCalls = 0;
+}
+
+void initContext(hwc_context_t* ctx, int fbWidth, int fbHeight) {
+    memset(ctx, 0, sizeof(*ctx));
+    sFbWidth = fbWidth;
+    sFbHeight = fbHeight;
+
+    framebuffer_device_t* fbDev =
+            (framebuffer_device_t*)calloc(1, sizeof(framebuffer_device_t));
+    const_cast<uint32_t&>(fbDev->width) = fbWidth;
+    const_cast<uint32_t&>(fbDev->height) = fbHeight;
+    ctx->mFbDev = fbDev;
+
+    ctx->mOverlay = overlay::Overlay::getInstance();
+    ctx->qbuf = new qhwc::QueuedBufferStore();
+    ctx->mExtDisplay = new qhwc::ExternalDisplay(ctx);
+}
+
+void destroyContext(hwc_context_t* ctx) {
+    delete ctx->mExtDisplay;
+    delete ctx->qbuf;
+    free(ctx->mFbDev);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+} // namespace fakes
+
+int property_get(const char* key, char* value, const char* default_value) {
+    for(int i = 0; i < MAX_FAKE_PROPS; i++) {
+        if(sProps[i].key && !strcmp(sProps[i].key, key)) {
+            return snprintf(value, PROPERTY_VALUE_MAX, "%s", sProps[i].value);
+        }
+    }
+    if(!default_value) {
+        value[0] = '\0';
+        return 0;
+    }
+    return snprintf(value, PROPERTY_VALUE_MAX, "%s", default_value);
+}
+
+nsecs_t systemTime(int) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (nsecs_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+genlock_status_t genlock_lock_buffer(native_handle_t*, genlock_lock_type_t,
+                                     int) {
+    return GENLOCK_NO_ERROR;
+}
+
+genlock_status_t genlock_unlock_buffer(native_handle_t*) {
+    return GENLOCK_NO_ERROR;
+}
+
+namespace qdutils {
+
+MDPVersion::MDPVersion() {
+    mMDPVersion = sMDPVersion;
+    mPanelType = 0;
+    mHasOverlay = true;
+}
+
+volatile bool FrameTrace::sEnabled = false;
+
+FrameTrace::FrameTrace() : mEvents(NULL), mHead(0), mFrame(0) {}
+
+FrameTrace::~FrameTrace() {}
+
+void FrameTrace::record(int, nsecs_t, nsecs_t, int) {}
+
+}; //namespace qdutils
+
+IdleInvalidator *IdleInvalidator::getInstance() {
+    return NULL;
+}
+
+int IdleInvalidator::init(InvalidatorHandler, void*, unsigned int) {
+    return -1;
+}
+
+void IdleInvalidator::markForSleep() {}
+
+namespace qhwc {
+
+void calculate_crop_rects(hwc_rect_t& crop, hwc_rect_t& dst,
+        const int fbWidth, const int fbHeight) {
+    //Only clips, the tests keep their layers on screen
+    if(dst.left < 0) dst.left = 0;
+    if(dst.top < 0) dst.top = 0;
+    if(dst.right > fbWidth) dst.right = fbWidth;
+    if(dst.bottom > fbHeight) dst.bottom = fbHeight;
+}
+
+ExternalDisplay::ExternalDisplay(hwc_context_t* ctx) : mFd(-1),
+        mCurrentMode(-1), mExternalDisplay(0), mResolutionMode(0),
+        mModeCount(0), mHwcContext(ctx) {}
+
+ExternalDisplay::~ExternalDisplay() {}
+
+int ExternalDisplay::getExternalDisplay() const {
+    return mExternalDisplay;
+}
+
+}; //namespace qhwc
+
+namespace overlay {
+
+namespace utils {
+int getExtType() {
+    return 0;
+}
+}
+
+Overlay::Overlay() : mOv(NULL) {}
+
+Overlay::~Overlay() {}
+
+Overlay* Overlay::getInstance() {
+    static Overlay sOverlay;
+    return &sOverlay;
+}
+
+bool Overlay::setSource(const utils::PipeArgs[utils::MAX_PIPES],
+        utils::eDest) {
+    sOverlayCalls++;
+    return true;
+}
+
+bool Overlay::setCrop(const utils::Dim&, utils::eDest) {
+    sOverlayCalls++;
+    return true;
+}
+
+bool Overlay::setTransform(const int, utils::eDest) {
+    sOverlayCalls++;
+    return true;
+}
+
+bool Overlay::setPosition(const utils::Dim&, utils::eDest) {
+    sOverlayCalls++;
+    return true;
+}
+
+bool Overlay::commit(utils::eDest) {
+    sOverlayCalls++;
+    return true;
+}
+
+bool Overlay::queueBuffer(int, uint32_t, utils::eDest) {
+    sOverlayCalls++;
+    return true;
+}
+
+void Overlay::setState(utils::eOverlayState s) {
+    sOverlayState = s;
+}
+
+utils::eOverlayState Overlay::getState() const {
+    return sOverlayState;
+}
+
+namespace utils {
+
+FrameBufferInfo::FrameBufferInfo() : mFBWidth(sFbWidth),
+        mFBHeight(sFbHeight), mBorderFillSupported(false) {}
+
+FrameBufferInfo* FrameBufferInfo::getInstance() {
+    static FrameBufferInfo sInfo;
+    return &sInfo;
+}
+
+int FrameBufferInfo::getWidth() const {
+    return mFBWidth;
+}
+
+int FrameBufferInfo::getHeight() const {
+    return mFBHeight;
+}
+
+}
+
+//Only referenced from the inline rotator setup of the overlay headers
+bool MdpRot::init() { return false; }
+bool MdpRot::close() { return true; }
+void MdpRot::setSource(const utils::Whf&) {}
+void MdpRot::setFlags(const utils::eMdpFlags&) {}
+void MdpRot::setTransform(const utils::eTransform&, const bool&) {}
+bool MdpRot::commit() { return false; }
+bool MdpRot::queueBuffer(int, uint32_t) { return false; }
+void MdpRot::dump() const {}
+
+} // namespace overlay
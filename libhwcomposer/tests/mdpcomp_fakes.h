@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ * Not a Contribution, Apache license notifications and license are retained
+ * for attribution purposes only.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HWC_MDPCOMP_FAKES_H
+#define HWC_MDPCOMP_FAKES_H
+
+#include <hwc_utils.h>
+
+/*
+ * Host stand-ins for what hwc_mdpcomp.cpp needs from the overlay, qdutils,
+ * genlock, cutils and the external display, so MDPComp can be run on the
+ * host. The overlay only counts the calls made to it.
+ */
+
+namespace fakes {
+
+// Value handed out by property_get for key, NULL to unset it
+void setProperty(const char* key, const char* value);
+
+// MDP version reported by qdutils::MDPVersion, set before first use
+void setMDPVersion(int version);
+
+// Calls made to the fake overlay since the last resetOverlayCalls
+int overlayCalls();
+void resetOverlayCalls();
+
+// hwc_context_t with a fake overlay, no external display and a
+// fbWidth x fbHeight primary
+void initContext(hwc_context_t* ctx, int fbWidth, int fbHeight);
+void destroyContext(hwc_context_t* ctx);
+
+} // namespace fakes
+
+#endif // HWC_MDPCOMP_FAKES_H
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2012, The Linux Foundation. All rights reserved.
+ * Not a Contribution, Apache license notifications and license are retained
+ * for attribution purposes only.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check of the MDP composition pipe solver against brute force.
+ *
+ * PipeMgr::solve is run on every list of up to 5 pipe capability sets and
+ * compared with trying every VG/RGB choice per layer: it has to find an
+ * assignment exactly when one exists, the requests have to replay on a
+ * fresh PipeMgr, and it has to use the fewest VG pipes possible.
+ *
+ * The FB/MDP split is checked through MDPComp::isFeasible on every list of
+ * up to 6 layers made of FB only, YUV, blended downscale, plain RGB,
+ * rotated and rotated partly off screen layers, for each
+ * debug.mdpcomp.maxlayer from 1 to 4. The expected split is the lowest
+ * one whose layers all fit the pipes and the rotator. configure has to
+ * mark the same layers for overlay.
+ *
+ * Prints the time per call and returns non zero on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <mdp_version.h>
+#include "hwc_mdpcomp.h"
+#include "mdpcomp_fakes.h"
+
+using namespace qhwc;
+
+#define MAX_SOLVE_LAYERS 5
+#define MAX_LIST_LAYERS  6
+#define FB_WIDTH         480
+#define FB_HEIGHT        800
+
+// Layer classes of the split check
+enum {
+    LAYER_FB = 0,   // skip layer, GPU only
+    LAYER_VG,       // YUV
+    LAYER_RGB,      // blended downscale, RGB pipes of MDP 4.2 only
+    LAYER_ANY,      // plain RGB, any pipe
+    LAYER_ROT,      // plain RGB through the rotator
+    LAYER_ROT_CLIP, // rotated and clipped by the screen, GPU only
+    LAYER_CLASSES,
+};
+
+static const int sClassCaps[LAYER_CLASSES] = {
+    0, PIPE_CAP_VG, PIPE_CAP_RGB, PIPE_CAP_VG | PIPE_CAP_RGB,
+    PIPE_CAP_VG | PIPE_CAP_RGB, 0,
+};
+
+static int sFreeVG;
+static int sFreeRGB;
+static int sFailures;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Free pipes of each type after a reset, as seen through req_for_pipe
+static void count_free_pipes()
+{
+    PipeMgr mgr;
+    sFreeVG = 0;
+    while(mgr.req_for_pipe(PIPE_REQ_VG) == PIPE_REQ_VG)
+        sFreeVG++;
+    mgr.reset();
+    sFreeRGB = 0;
+    while(mgr.req_for_pipe(PIPE_REQ_RGB) == PIPE_REQ_RGB)
+        sFreeRGB++;
+}
+
+// Fewest VG pipes over every assignment of the layers to pipe types the
+// caps allow, -1 if none fits the free pipes
+static int brute_force_min_vg(const int* caps, int count)
+{
+    int best = -1;
+    for(int mask = 0; mask < (1 << count); mask++) {
+        int vg = 0, rgb = 0;
+        bool ok = true;
+        for(int i = 0; i < count && ok; i++) {
+            int cap = (mask & (1 << i)) ? PIPE_CAP_VG : PIPE_CAP_RGB;
+            if(!(caps[i] & cap))
+                ok = false;
+            else if(cap == PIPE_CAP_VG)
+                vg++;
+            else
+                rgb++;
+        }
+        if(ok && vg <= sFreeVG && rgb <= sFreeRGB && (best < 0 || vg < best))
+            best = vg;
+    }
+    return best;
+}
+
+static void check_solve(const int* caps, int count)
+{
+    PipeMgr mgr;
+    int pipe_req[MAX_PIPES];
+    bool solved = mgr.solve(caps, count, pipe_req);
+    int expected = brute_force_min_vg(caps, count);
+
+    if(solved != (expected >= 0)) {
+        printf("solve: %d layers, caps", count);
+        for(int i = 0; i < count; i++)
+            printf(" %d", caps[i]);
+        printf(": returned %d, brute force %d\n", solved, expected >= 0);
+        sFailures++;
+        return;
+    }
+    if(!solved)
+        return;
+
+    //The requests must suit each layer and replay on a fresh PipeMgr
+    int vg = 0;
+    mgr.reset();
+    for(int i = 0; i < count; i++) {
+        int cap = (pipe_req[i] == PIPE_REQ_VG) ? PIPE_CAP_VG : PIPE_CAP_RGB;
+        if(!(caps[i] & cap) || mgr.req_for_pipe(pipe_req[i]) != pipe_req[i]) {
+            printf("solve: layer %d of %d, caps %d: bad request %d\n",
+                   i, count, caps[i], pipe_req[i]);
+            sFailures++;
+            return;
+        }
+        if(pipe_req[i] == PIPE_REQ_VG)
+            vg++;
+    }
+    if(vg != expected) {
+        printf("solve: %d layers use %d VG pipes, %d needed\n", count, vg,
+               expected);
+        sFailures++;
+    }
+}
+
+// Steps list to the next combination of count entries out of values,
+// false once every combination was seen
+static bool next_list(int* list, int count, int values)
+{
+    int i = 0;
+    while(i < count && ++list[i] == values)
+        list[i++] = 0;
+    return i < count;
+}
+
+static void check_all_solves()
+{
+    static const int capSet[] = {
+        0, PIPE_CAP_VG, PIPE_CAP_RGB, PIPE_CAP_VG | PIPE_CAP_RGB,
+    };
+    int lists = 0;
+    for(int count = 0; count <= MAX_SOLVE_LAYERS; count++) {
+        int idx[MAX_SOLVE_LAYERS] = { 0 };
+        do {
+            int caps[MAX_SOLVE_LAYERS];
+            for(int i = 0; i < count; i++)
+                caps[i] = capSet[idx[i]];
+            check_solve(caps, count);
+            lists++;
+        } while(next_list(idx, count, 4));
+    }
+
+    //Time the solve of a full, feasible frame
+    const int caps[] = { PIPE_CAP_VG, PIPE_CAP_VG | PIPE_CAP_RGB,
+                         PIPE_CAP_VG | PIPE_CAP_RGB };
+    const int rounds = 1000000;
+    int pipe_req[MAX_PIPES];
+    PipeMgr mgr;
+    int solved = 0;
+    double start = now_ns();
+    for(int i = 0; i < rounds; i++) {
+        mgr.reset();
+        solved += mgr.solve(caps, 3, pipe_req);
+    }
+    double elapsed = now_ns() - start;
+    printf("solve: %d lists checked, %.1f ns per frame (%d)\n", lists,
+           elapsed / rounds, solved == rounds);
+}
+
+// Expected FB layer count of a list, -1 if no layer can use MDP
+static int oracle_split(const int* classes, int count, int maxLayers)
+{
+    int max_mdp = (maxLayers < MAX_PIPES) ? maxLayers : MAX_PIPES;
+    for(int split = 0; split < count; split++) {
+        if(count - split > max_mdp)
+            continue;
+        int caps[MAX_LIST_LAYERS];
+        int rot = 0;
+        bool fetchable = true;
+        for(int i = split; i < count; i++) {
+            caps[i - split] = sClassCaps[classes[i]];
+            if(!caps[i - split])
+                fetchable = false;
+            if(classes[i] == LAYER_ROT)
+                rot++;
+        }
+        if(fetchable && rot <= MAX_ROT_LAYERS &&
+                brute_force_min_vg(caps, count - split) >= 0)
+            return split;
+    }
+    return -1;
+}
+
+static private_handle_t sUiHandle(-1, 4096, 0, BUFFER_TYPE_UI,
+                                  HAL_PIXEL_FORMAT_RGBA_8888, 200, 200);
+static private_handle_t sVideoHandle(-1, 4096, 0, BUFFER_TYPE_VIDEO,
+                                     HAL_PIXEL_FORMAT_YCbCr_420_SP, 200, 200);
+
+static void set_rect(hwc_rect_t& r, int l, int t, int w, int h)
+{
+    r.left = l;
+    r.top = t;
+    r.right = l + w;
+    r.bottom = t + h;
+}
+
+static void build_layer(hwc_layer_t* layer, int layerClass, int index)
+{
+    memset(layer, 0, sizeof(*layer));
+    layer->compositionType = HWC_FRAMEBUFFER;
+    layer->blending = HWC_BLENDING_NONE;
+    layer->handle = &sUiHandle;
+    set_rect(layer->sourceCrop, 0, 0, 100, 100);
+    set_rect(layer->displayFrame, 10 * index, 10 * index, 100, 100);
+
+    switch(layerClass) {
+        case LAYER_FB:
+            layer->flags |= HWC_SKIP_LAYER;
+            break;
+        case LAYER_VG:
+            layer->handle = &sVideoHandle;
+            break;
+        case LAYER_RGB:
+            layer->blending = HWC_BLENDING_PREMULT;
+            set_rect(layer->sourceCrop, 0, 0, 200, 200);
+            break;
+        case LAYER_ROT:
+            layer->transform = HWC_TRANSFORM_ROT_90;
+            break;
+        case LAYER_ROT_CLIP:
+            layer->transform = HWC_TRANSFORM_ROT_90;
+            set_rect(layer->displayFrame, -50, 10 * index, 100, 100);
+            break;
+    }
+}
+
+static hwc_layer_list_t* alloc_list(int count)
+{
+    return (hwc_layer_list_t*)calloc(1, sizeof(hwc_layer_list_t) +
+                                     count * sizeof(hwc_layer_t));
+}
+
+static double sFeasibleTime;
+static double sConfigureTime;
+
+static void check_split(hwc_context_t* ctx, hwc_layer_list_t* list,
+                        const int* classes, int count, int maxLayers)
+{
+    list->numHwLayers = count;
+    for(int i = 0; i < count; i++)
+        build_layer(&list->hwLayers[i], classes[i], i);
+
+    int expected = oracle_split(classes, count, maxLayers);
+
+    double start = now_ns();
+    bool feasible = MDPComp::isFeasible(ctx, list);
+    double mid = now_ns();
+    bool configured = MDPComp::configure(&ctx->device, list);
+    sConfigureTime += now_ns() - mid;
+    sFeasibleTime += mid - start;
+
+    int split = feasible ? MDPComp::getFBLayerCount() : -1;
+    bool marked = true;
+    for(int i = 0; configured && i < count; i++) {
+        bool overlay = (list->hwLayers[i].compositionType == HWC_OVERLAY);
+        if(overlay != (i >= split))
+            marked = false;
+    }
+
+    if(split != expected || configured != feasible || !marked) {
+        printf("split: maxlayer %d, classes", maxLayers);
+        for(int i = 0; i < count; i++)
+            printf(" %d", classes[i]);
+        printf(": split %d, expected %d, configure %d%s\n", split, expected,
+               configured, marked ? "" : " marked other layers");
+        sFailures++;
+    }
+}
+
+static void check_all_splits(hwc_context_t* ctx)
+{
+    hwc_layer_list_t* list = alloc_list(MAX_LIST_LAYERS);
+    int frames = 0;
+
+    for(int maxLayers = 1; maxLayers <= MAX_PIPES; maxLayers++) {
+        char value[PROPERTY_VALUE_MAX];
+        snprintf(value, sizeof(value), "%d", maxLayers);
+        fakes::setProperty("debug.mdpcomp.maxlayer", value);
+        MDPComp::init(ctx);
+
+        for(int count = 1; count <= MAX_LIST_LAYERS; count++) {
+            int classes[MAX_LIST_LAYERS] = { 0 };
+            do {
+                check_split(ctx, list, classes, count, maxLayers);
+                frames++;
+            } while(next_list(classes, count, LAYER_CLASSES));
+        }
+    }
+    free(list);
+    printf("split: %d frames checked, isFeasible %.1f ns, configure %.1f ns"
+           " per frame\n", frames, sFeasibleTime / frames,
+           sConfigureTime / frames);
+}
+
+int main()
+{
+    hwc_context_t ctx;
+
+    fakes::setMDPVersion(qdutils::MDP_V4_2);
+    fakes::initContext(&ctx, FB_WIDTH, FB_HEIGHT);
+
+    count_free_pipes();
+    printf("free pipes: %d VG, %d RGB\n", sFreeVG, sFreeRGB);
+
+    check_all_solves();
+    check_all_splits(&ctx);
+
+    fakes::destroyContext(&ctx);
+    printf("%d failures\n", sFailures);
+    return sFailures ? 1 : 0;
+}
@@ -117,7 +117,9 @@ inline bool OvMem::open(uint32_t numbufs,
         uint32_t bufSz, bool isSecure)
 {
     alloc_data data;
-    int allocFlags = GRALLOC_USAGE_PRIVATE_IOMMU_HEAP;
+    // Rotator output is written in full before it is queued to MDP
+    int allocFlags = GRALLOC_USAGE_PRIVATE_IOMMU_HEAP |
+                     GRALLOC_USAGE_PRIVATE_NO_ZERO_FILL;
     if(isSecure) {
         allocFlags |= GRALLOC_USAGE_PRIVATE_MM_HEAP;
         allocFlags |= GRALLOC_USAGE_PRIVATE_CP_BUFFER;
@@ -108,12 +108,20 @@ void MdpRot::doTransform() {
 
 bool MdpRot::commit() {
     doTransform();
+    //Restarting a session with the same info only costs an ioctl
+    if((getSessId() > 0) &&
+            (0 == ::memcmp(&mRotImgInfo, &mLkgo, sizeof(mRotImgInfo)))) {
+        ALOGE_IF(DEBUG_OVERLAY, "%s: session %d unchanged", __FUNCTION__,
+                getSessId());
+        return true;
+    }
     if(!overlay::mdp_wrapper::startRotator(mFd.getFD(), mRotImgInfo)) {
         ALOGE("MdpRot commit failed");
         dump();
         return false;
     }
     mRotDataInfo.session_id = mRotImgInfo.session_id;
+    mLkgo = mRotImgInfo;
     return true;
 }
 
@@ -183,6 +191,7 @@ bool MdpRot::remap(uint32_t numbufs) {
 
 void MdpRot::reset() {
     ovutils::memset0(mRotImgInfo);
+    ovutils::memset0(mLkgo);
     ovutils::memset0(mRotDataInfo);
     ovutils::memset0(mMem.curr().mRotOffset);
     ovutils::memset0(mMem.prev().mRotOffset);
@@ -242,6 +242,8 @@ private:
 
     /* rot info*/
     msm_rotator_img_info mRotImgInfo;
+    /* last started session, a commit with the same info is a no-op */
+    msm_rotator_img_info mLkgo;
     /* rot data */
     msm_rotator_data_info mRotDataInfo;
     /* Orientation */
@@ -366,6 +366,17 @@ struct PipeArgs {
         rotFlags(r) {
     }
 
+    //Whf::operator== leaves out the size, the rotator buffers depend on it
+    bool operator==(const PipeArgs& p) const {
+        return p.mdpFlags == mdpFlags && p.whf == whf &&
+                p.whf.size == whf.size && p.zorder == zorder &&
+                p.isFg == isFg && p.rotFlags == rotFlags;
+    }
+
+    bool operator!=(const PipeArgs& p) const {
+        return !operator==(p);
+    }
+
     eMdpFlags mdpFlags; // for mdp_overlay flags
     Whf whf;
     eZorder zorder; // stage number
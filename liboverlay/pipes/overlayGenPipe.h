@@ -110,13 +110,23 @@ private:
         OPEN
     };
     ePipeState pipeState;
+
+    /* Inputs of the setters since the last commit, and whether any of them
+     * differs from what was committed. An open pipe whose inputs did not
+     * change needs no commit, its MDP and rotator setup still hold. */
+    utils::PipeArgs mArgs;
+    utils::Dim mCrop;
+    utils::Dim mPosition;
+    utils::eTransform mOrient;
+    bool mDirty;
 };
 
 //------------------------Inlines and Templates ----------------------
 
 template <int PANEL>
 GenericPipe<PANEL>::GenericPipe() : mRot(0), mRotUsed(false),
-        pipeState(CLOSED) {
+        pipeState(CLOSED), mOrient(utils::OVERLAY_TRANSFORM_0),
+        mDirty(true) {
 }
 
 template <int PANEL>
@@ -147,6 +157,7 @@ bool GenericPipe<PANEL>::init(RotatorBase* rot)
     mRot = rot;
 
     mRotUsed = false;
+    mDirty = true;
 
     // NOTE:init() on the rot is called by OverlayImpl
     // Pipes only have to worry about using rot, and not init or close.
@@ -181,6 +192,11 @@ template <int PANEL>
 inline bool GenericPipe<PANEL>::setSource(
         const utils::PipeArgs& args)
 {
+    if(args != mArgs) {
+        mArgs = args;
+        mDirty = true;
+    }
+
     utils::PipeArgs newargs(args);
     utils::Whf whf(newargs.whf);
     //Extract HAL format from lower bytes. Deinterlace if interlaced.
@@ -199,6 +215,10 @@ inline bool GenericPipe<PANEL>::setSource(
 template <int PANEL>
 inline bool GenericPipe<PANEL>::setCrop(
         const overlay::utils::Dim& d) {
+    if(d != mCrop) {
+        mCrop = d;
+        mDirty = true;
+    }
     return mCtrlData.ctrl.setCrop(d);
 }
 
@@ -206,6 +226,11 @@ template <int PANEL>
 inline bool GenericPipe<PANEL>::setTransform(
         const utils::eTransform& orient)
 {
+    if(orient != mOrient) {
+        mOrient = orient;
+        mDirty = true;
+    }
+
     //Rotation could be enabled by user for zero-rot or the layer could have
     //some transform. Mark rotation enabled in either case.
     mRotUsed |= (orient != utils::OVERLAY_TRANSFORM_0);
@@ -217,12 +242,20 @@ inline bool GenericPipe<PANEL>::setTransform(
 template <int PANEL>
 inline bool GenericPipe<PANEL>::setPosition(const utils::Dim& d)
 {
+    if(d != mPosition) {
+        mPosition = d;
+        mDirty = true;
+    }
     return mCtrlData.ctrl.setPosition(d);
 }
 
 template <int PANEL>
 inline bool GenericPipe<PANEL>::commit() {
     bool ret = false;
+    //Same inputs as the last commit, go straight to queueBuffer
+    if(!mDirty && isOpen()) {
+        return true;
+    }
     //If wanting to use rotator, start it.
     if(mRotUsed) {
         if(!mRot->commit()) {
@@ -232,6 +265,7 @@ inline bool GenericPipe<PANEL>::commit() {
     }
     ret = mCtrlData.ctrl.commit();
     pipeState = ret ? OPEN : CLOSED;
+    mDirty = !ret;
     return ret;
 }
 
@@ -266,6 +300,11 @@ inline bool GenericPipe<PANEL>::queueBuffer(int fd, uint32_t offset) {
     return mCtrlData.data.queueBuffer(finalFd, finalOffset);
 }
 
+template <int PANEL>
+inline const utils::PipeArgs& GenericPipe<PANEL>::getArgs() const {
+    return mArgs;
+}
+
 template <int PANEL>
 inline int GenericPipe<PANEL>::getCtrlFd() const {
     return mCtrlData.ctrl.getFd();
@@ -322,6 +361,7 @@ inline bool GenericPipe<PANEL>::isOpen() const  {
 template <int PANEL>
 inline bool GenericPipe<PANEL>::setClosed() {
     pipeState = CLOSED;
+    mDirty = true;
     return true;
 }
 
@@ -12,7 +12,7 @@ LOCAL_CFLAGS                  := $(common_flags)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
 LOCAL_SRC_FILES               := profiler.cpp mdp_version.cpp comptype.cpp \
                                  soc_id.cpp idle_invalidator.cpp \
-                                 egl_handles.cpp cb_utils.cpp
+                                 egl_handles.cpp cb_utils.cpp frame_trace.cpp
 include $(BUILD_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
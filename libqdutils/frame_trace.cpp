@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "FrameTrace"
+#include <stdlib.h>
+#include <cutils/atomic.h>
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include "frame_trace.h"
+
+ANDROID_SINGLETON_STATIC_INSTANCE(qdutils::FrameTrace);
+
+namespace qdutils {
+
+static const char *sPhaseNames[TRACE_PHASE_MAX] = {
+    "prepare",
+    "strategy",
+    "set",
+    "video_draw",
+    "extonly_draw",
+    "copybit_draw",
+    "copybit_layer",
+    "copybit_finish",
+    "mdpcomp_draw",
+    "mdpcomp_layer",
+    "swap_buffers",
+    "wait_fb_post",
+    "uimirror_draw",
+    "ext_commit",
+    "wait_pan",
+};
+
+volatile bool FrameTrace::sEnabled = false;
+
+FrameTrace::FrameTrace() : mEvents(NULL), mHead(0), mFrame(0) {
+    char property[PROPERTY_VALUE_MAX];
+    if(property_get("debug.hwc.trace", property, NULL) > 0 &&
+       atoi(property) != 0) {
+        setEnabled(true);
+    }
+}
+
+FrameTrace::~FrameTrace() {
+    sEnabled = false;
+    free(mEvents);
+}
+
+void FrameTrace::setEnabled(bool enable) {
+    android::Mutex::Autolock lock(mLock);
+    if(enable && !mEvents) {
+        mEvents = (trace_event *)calloc(MAX_TRACE_EVENTS, sizeof(*mEvents));
+        if(!mEvents) {
+            ALOGE("%s: could not allocate the trace buffer", __FUNCTION__);
+            return;
+        }
+        //Publish the buffer before the trace points can see sEnabled
+        android_memory_barrier();
+    }
+    sEnabled = enable;
+    ALOGD("%s: frame tracing %s", __FUNCTION__, enable ? "on" : "off");
+}
+
+void FrameTrace::record(int phase, nsecs_t start, nsecs_t end, int layer) {
+    if(!mEvents)
+        return;
+    unsigned int slot = (unsigned int)android_atomic_inc(&mHead) %
+                        MAX_TRACE_EVENTS;
+    trace_event& ev = mEvents[slot];
+    ev.start = start;
+    ev.end = end;
+    ev.frame = mFrame;
+    ev.phase = phase;
+    ev.layer = layer;
+}
+
+void FrameTrace::dump(android::String8& buf, int format) {
+    android::Mutex::Autolock lock(mLock);
+    //Slots may be rewritten while we walk them, a dump taken during
+    //composition can show a few inconsistent events
+    unsigned int head = (unsigned int)mHead;
+    unsigned int count = head < MAX_TRACE_EVENTS ? head : MAX_TRACE_EVENTS;
+    bool chrome = (format == TRACE_FORMAT_CHROME);
+
+    if(chrome) {
+        buf.append("{\"traceEvents\":[");
+    } else {
+        buf.appendFormat("Frame trace: %s, %u events\n",
+                         sEnabled ? "on" : "off", count);
+        buf.append("  frame  phase            layer    start(us)   dur(us)\n");
+    }
+    if(!mEvents)
+        count = 0;
+
+    nsecs_t base = count ? mEvents[(head - count) % MAX_TRACE_EVENTS].start : 0;
+    for(unsigned int i = head - count; i != head; i++) {
+        const trace_event& ev = mEvents[i % MAX_TRACE_EVENTS];
+        if(ev.phase < 0 || ev.phase >= TRACE_PHASE_MAX)
+            continue;
+        long long start = (long long)(ev.start - base);
+        long long dur = (long long)(ev.end - ev.start);
+        if(chrome) {
+            buf.appendFormat("%s{\"name\":\"%s\",\"cat\":\"hwc\",\"ph\":\"X\","
+                    "\"pid\":0,\"tid\":0,\"ts\":%lld.%03lld,"
+                    "\"dur\":%lld.%03lld,\"args\":{\"frame\":%u,"
+                    "\"layer\":%d}}", (i == head - count) ? "" : ",",
+                    sPhaseNames[ev.phase],
+                    start / 1000, start % 1000, dur / 1000, dur % 1000,
+                    ev.frame, ev.layer);
+        } else {
+            buf.appendFormat("  %5u  %-15s  %5d  %11lld  %8lld\n", ev.frame,
+                    sPhaseNames[ev.phase], ev.layer, start / 1000,
+                    dur / 1000);
+        }
+    }
+    if(chrome)
+        buf.append("]}\n");
+}
+
+}; //namespace qdutils
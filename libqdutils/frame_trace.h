@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INCLUDE_FRAME_TRACE
+#define INCLUDE_FRAME_TRACE
+
+#include <stdint.h>
+#include <utils/Singleton.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/threads.h>
+
+/* Timeline of the composition phases of the last frames.
+ *
+ * Phases are recorded with begin/end timestamps into a fixed ring of events,
+ * so a dump shows the most recent MAX_TRACE_EVENTS of them. Recording is
+ * off by default; while off, a trace point costs one load and branch.
+ * Enable with debug.hwc.trace=1 or through the hwc service. */
+
+namespace qdutils {
+
+enum {
+    TRACE_PREPARE = 0,
+    TRACE_STRATEGY,
+    TRACE_SET,
+    TRACE_VIDEO_DRAW,
+    TRACE_EXTONLY_DRAW,
+    TRACE_COPYBIT_DRAW,
+    TRACE_COPYBIT_LAYER,
+    TRACE_COPYBIT_FINISH,
+    TRACE_MDPCOMP_DRAW,
+    TRACE_MDPCOMP_LAYER,
+    TRACE_SWAP_BUFFERS,
+    TRACE_WAIT_FB_POST,
+    TRACE_UIMIRROR_DRAW,
+    TRACE_EXT_COMMIT,
+    TRACE_WAIT_PAN,
+    TRACE_PHASE_MAX,
+};
+
+enum {
+    TRACE_FORMAT_TEXT = 0,
+    TRACE_FORMAT_CHROME,
+};
+
+class FrameTrace : public android::Singleton<FrameTrace> {
+public:
+    FrameTrace();
+    ~FrameTrace();
+
+    static bool isEnabled() { return sEnabled; }
+    void setEnabled(bool enable);
+    //Starts a new frame, the events recorded after belong to it
+    void nextFrame() { mFrame++; }
+    //Records phase from start to end, layer is -1 for frame wide phases
+    void record(int phase, nsecs_t start, nsecs_t end, int layer);
+    //Appends the recorded events, oldest first, in the given format
+    void dump(android::String8& buf, int format);
+
+private:
+    static const unsigned int MAX_TRACE_EVENTS = 2048;
+
+    struct trace_event {
+        nsecs_t start;
+        nsecs_t end;
+        uint32_t frame;
+        int16_t phase;
+        int16_t layer;
+    };
+
+    //Read on every trace point, kept out of the instance to skip
+    //the singleton lookup while tracing is off
+    static volatile bool sEnabled;
+    trace_event *mEvents;
+    volatile int32_t mHead;
+    uint32_t mFrame;
+    android::Mutex mLock;
+};
+
+//Records the enclosing scope as one event of a phase
+class TraceScope {
+public:
+    TraceScope(int phase, int layer = -1) : mPhase(phase), mLayer(layer),
+            mStart(0) {
+        if(FrameTrace::isEnabled())
+            mStart = systemTime();
+    }
+    ~TraceScope() {
+        if(mStart)
+            FrameTrace::getInstance().record(mPhase, mStart, systemTime(),
+                                             mLayer);
+    }
+private:
+    int mPhase;
+    int mLayer;
+    nsecs_t mStart;
+};
+
+}; //namespace qdutils
+
+#endif // INCLUDE_FRAME_TRACE